@@ -0,0 +1,964 @@
+/*
+ * bench_obj
+ *
+ * Generates OBJ files with a fixed seed and measures fast_obj_read on them.
+ * Every run of the same options writes the same bytes, so results can be
+ * compared between versions of fast_obj.h.  Prints a summary to stderr and
+ * the results as JSON to stdout (or --json).
+ *
+ * Build:
+ *   gcc -O2 bench_obj.c -o bench_obj -pthread
+ *
+ * Examples:
+ *   ./bench_obj --faces 1M --attrs v/vt/vn
+ *   ./bench_obj --faces 10M --degree 4 --negative --usemtl 1000 --groups 64
+ *   ./bench_obj --suite --faces 5M --json results.json
+ *   ./bench_obj --suite --input "Modelos 3d/teapot.obj" --runs 20
+ *   ./bench_obj --input model.obj --runs 10
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+
+/* Every allocation fast_obj makes goes through these */
+static void* bench_realloc(void* ptr, size_t bytes);
+static void  bench_free(void* ptr);
+
+#define FAST_OBJ_REALLOC        bench_realloc
+#define FAST_OBJ_FREE           bench_free
+#define FAST_OBJ_IMPLEMENTATION
+#include "fast_obj.h"
+
+
+#if defined(_MSC_VER)
+#define BENCH_ADD(_v, _n)       InterlockedExchangeAdd64((volatile LONG64*)(&(_v)), (LONG64)(_n))
+#else
+#define BENCH_ADD(_v, _n)       __sync_fetch_and_add(&(_v), (_n))
+#endif
+
+/* Vertices written before the faces that use them, the file is a run of
+   these blocks like exporters that write one object at a time */
+#define BLOCK_VERTICES          4096
+
+/* Bytes formatted before each write */
+#define WRITE_BUFFER_SIZE       (1 << 20)
+
+#define MAX_RUNS                64
+
+/* Real model measured after the generated files of --suite */
+#define SUITE_MODEL             "Modelos 3d/teapot.obj"
+
+
+typedef enum
+{
+    ATTRS_V,
+    ATTRS_V_VT,
+    ATTRS_V_VT_VN,
+    ATTRS_V_VN,
+
+} BenchAttrs;
+
+typedef struct
+{
+    uint64_t                    faces;
+    unsigned int                degree;
+    BenchAttrs                  attrs;
+    int                         negative;
+
+    /* Faces between usemtl lines (0 for none), and materials they cycle through */
+    uint64_t                    usemtl;
+    unsigned int                materials;
+
+    /* Number of g lines, spread evenly over the faces */
+    unsigned int                groups;
+
+    uint64_t                    seed;
+
+} BenchConfig;
+
+typedef struct
+{
+    /* Calls that allocate, calls that resize and calls that free */
+    volatile int64_t            allocs;
+    volatile int64_t            reallocs;
+    volatile int64_t            frees;
+
+    /* Bytes requested by allocating and resizing calls */
+    volatile int64_t            bytes;
+
+} BenchCounters;
+
+typedef struct
+{
+    FILE*                       file;
+    char*                       buffer;
+    size_t                      used;
+    uint64_t                    written;
+
+} BenchWriter;
+
+
+static BenchCounters counters;
+
+
+static
+void* bench_realloc(void* ptr, size_t bytes)
+{
+    if (ptr)
+        BENCH_ADD(counters.reallocs, 1);
+    else
+        BENCH_ADD(counters.allocs, 1);
+
+    BENCH_ADD(counters.bytes, (int64_t)(bytes));
+
+    return realloc(ptr, bytes);
+}
+
+
+static
+void bench_free(void* ptr)
+{
+    if (ptr)
+        BENCH_ADD(counters.frees, 1);
+
+    free(ptr);
+}
+
+
+static
+double bench_time(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)(counter.QuadPart) / (double)(frequency.QuadPart);
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)(t.tv_sec) + (double)(t.tv_nsec) * 1e-9;
+#endif
+}
+
+
+static
+int bench_peak_reset(void)
+{
+    /* Linux can reset the peak, so each config reports its own */
+#ifdef __linux__
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    int   ok;
+    if (!file)
+        return 0;
+    ok = fputs("5", file) >= 0;
+    return (fclose(file) == 0) && ok;
+#else
+    return 0;
+#endif
+}
+
+
+static
+uint64_t bench_peak_rss(void)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS info;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &info, sizeof(info)))
+        return 0;
+    return (uint64_t)(info.PeakWorkingSetSize);
+#else
+    struct rusage usage;
+#ifdef __linux__
+    /* VmHWM is the peak since the last reset, ru_maxrss ignores resets */
+    FILE*              file = fopen("/proc/self/status", "r");
+    char               line[256];
+    unsigned long long kb;
+    if (file)
+    {
+        while (fgets(line, sizeof(line), file))
+        {
+            if (sscanf(line, "VmHWM: %llu kB", &kb) == 1)
+            {
+                fclose(file);
+                return (uint64_t)(kb) * 1024;
+            }
+        }
+        fclose(file);
+    }
+#endif
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return (uint64_t)(usage.ru_maxrss);
+#else
+    return (uint64_t)(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+
+static
+uint64_t random_next(uint64_t* state)
+{
+    /* splitmix64, the same sequence on every platform */
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+
+static
+int writer_flush(BenchWriter* writer)
+{
+    if (writer->used && fwrite(writer->buffer, 1, writer->used, writer->file) != writer->used)
+        return 0;
+
+    writer->written += writer->used;
+    writer->used     = 0;
+
+    return 1;
+}
+
+
+static
+char* writer_reserve(BenchWriter* writer, size_t bytes)
+{
+    if (writer->used + bytes > WRITE_BUFFER_SIZE && !writer_flush(writer))
+        return 0;
+
+    return writer->buffer + writer->used;
+}
+
+
+static
+char* write_uint(char* p, uint64_t v)
+{
+    char   digits[20];
+    size_t n;
+
+
+    n = 0;
+    do
+    {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    }
+    while (v);
+
+    while (n)
+        *p++ = digits[--n];
+
+    return p;
+}
+
+
+static
+char* write_int(char* p, int64_t v)
+{
+    if (v < 0)
+    {
+        *p++ = '-';
+        return write_uint(p, (uint64_t)(-v));
+    }
+
+    return write_uint(p, (uint64_t)(v));
+}
+
+
+static
+char* write_fixed(char* p, int64_t micro)
+{
+    /* Six decimals, like %f */
+    uint64_t v;
+    int      ii;
+
+
+    if (micro < 0)
+    {
+        *p++  = '-';
+        micro = -micro;
+    }
+
+    v = (uint64_t)(micro);
+    p = write_uint(p, v / 1000000);
+    *p++ = '.';
+
+    v %= 1000000;
+    for (ii = 5; ii >= 0; ii--)
+    {
+        p[ii] = (char)('0' + v % 10);
+        v /= 10;
+    }
+
+    return p + 6;
+}
+
+
+static
+char* write_string(char* p, const char* s)
+{
+    while (*s)
+        *p++ = *s++;
+
+    return p;
+}
+
+
+static
+char* write_index(char* p, uint64_t index, uint64_t count, int negative)
+{
+    /* Negative indices count back from the last vertex written */
+    if (negative)
+        return write_int(p, (int64_t)(index) - (int64_t)(count) - 1);
+
+    return write_uint(p, index);
+}
+
+
+static
+int write_vertices(BenchWriter* writer, const BenchConfig* config, uint64_t count, uint64_t* state)
+{
+    char*        p;
+    uint64_t     ii;
+    unsigned int jj;
+    uint64_t     r;
+
+
+    for (ii = 0; ii < count; ii++)
+    {
+        /* v, vt and vn of about 120 bytes at most */
+        p = writer_reserve(writer, 160);
+        if (!p)
+            return 0;
+
+        r = random_next(state);
+
+        p = write_string(p, "v");
+        for (jj = 0; jj < 3; jj++)
+        {
+            *p++ = ' ';
+            p = write_fixed(p, (int64_t)((r >> (jj * 20)) & 0xfffff) - 0x80000);
+        }
+        *p++ = '\n';
+
+        if (config->attrs == ATTRS_V_VT || config->attrs == ATTRS_V_VT_VN)
+        {
+            p = write_string(p, "vt ");
+            p = write_fixed(p, (int64_t)((r >> 4) % 1000001));
+            *p++ = ' ';
+            p = write_fixed(p, (int64_t)((r >> 24) % 1000001));
+            *p++ = '\n';
+        }
+
+        if (config->attrs == ATTRS_V_VN || config->attrs == ATTRS_V_VT_VN)
+        {
+            /* Not unit length, fast_obj does not care */
+            p = write_string(p, "vn");
+            for (jj = 0; jj < 3; jj++)
+            {
+                *p++ = ' ';
+                p = write_fixed(p, (int64_t)((r >> (jj * 16 + 8)) & 0x1fffff) - 0x100000);
+            }
+            *p++ = '\n';
+        }
+
+        writer->used = (size_t)(p - writer->buffer);
+    }
+
+    return 1;
+}
+
+
+static
+int write_face(BenchWriter* writer, const BenchConfig* config, uint64_t first, uint64_t range, uint64_t count, uint64_t* state)
+{
+    char*        p;
+    unsigned int ii;
+    uint64_t     index;
+
+
+    p = writer_reserve(writer, 16 + (size_t)(config->degree) * 72);
+    if (!p)
+        return 0;
+
+    *p++ = 'f';
+    for (ii = 0; ii < config->degree; ii++)
+    {
+        index = first + random_next(state) % range;
+
+        *p++ = ' ';
+        p = write_index(p, index, count, config->negative);
+
+        switch (config->attrs)
+        {
+        case ATTRS_V:
+            break;
+
+        case ATTRS_V_VT:
+            *p++ = '/';
+            p = write_index(p, index, count, config->negative);
+            break;
+
+        case ATTRS_V_VT_VN:
+            *p++ = '/';
+            p = write_index(p, index, count, config->negative);
+            *p++ = '/';
+            p = write_index(p, index, count, config->negative);
+            break;
+
+        case ATTRS_V_VN:
+            *p++ = '/';
+            *p++ = '/';
+            p = write_index(p, index, count, config->negative);
+            break;
+        }
+    }
+    *p++ = '\n';
+
+    writer->used = (size_t)(p - writer->buffer);
+
+    return 1;
+}
+
+
+static
+int generate(const char* path, const BenchConfig* config, uint64_t* size)
+{
+    BenchWriter writer;
+    uint64_t    state;
+    uint64_t    vertices;
+    uint64_t    written;
+    uint64_t    face;
+    uint64_t    block_faces;
+    uint64_t    first;
+    uint64_t    range;
+    uint64_t    next_group;
+    unsigned int group;
+    char*       p;
+    int         ok;
+
+
+    writer.file = fopen(path, "wb");
+    if (!writer.file)
+        return 0;
+
+    writer.buffer  = (char*)(malloc(WRITE_BUFFER_SIZE));
+    writer.used    = 0;
+    writer.written = 0;
+    if (!writer.buffer)
+    {
+        fclose(writer.file);
+        return 0;
+    }
+
+    state = config->seed;
+
+    /* Closed triangle meshes have about half as many vertices as faces */
+    vertices = config->faces * config->degree / 6;
+    if (vertices < config->degree)
+        vertices = config->degree;
+
+    p = writer_reserve(&writer, 64);
+    p = write_string(p, "# bench_obj ");
+    p = write_uint(p, config->seed);
+    *p++ = '\n';
+    writer.used = (size_t)(p - writer.buffer);
+
+    ok         = 1;
+    written    = 0;
+    face       = 0;
+    group      = 0;
+    next_group = 0;
+    while (ok && face < config->faces)
+    {
+        /* A block of vertices, then the faces that use it */
+        ok = write_vertices(&writer, config, (vertices - written < BLOCK_VERTICES) ? vertices - written : BLOCK_VERTICES, &state);
+        written += (vertices - written < BLOCK_VERTICES) ? vertices - written : BLOCK_VERTICES;
+
+        block_faces = (written >= vertices) ? config->faces - face : BLOCK_VERTICES * 6 / config->degree;
+        if (block_faces > config->faces - face)
+            block_faces = config->faces - face;
+
+        /* Faces use this block and the one before it */
+        first = (written > 2 * BLOCK_VERTICES) ? written - 2 * BLOCK_VERTICES + 1 : 1;
+        range = written - first + 1;
+
+        for (; ok && block_faces; block_faces--, face++)
+        {
+            if (config->groups && face == next_group)
+            {
+                p = writer_reserve(&writer, 32);
+                ok = p != 0;
+                if (ok)
+                {
+                    p = write_string(p, "g group");
+                    p = write_uint(p, group);
+                    *p++ = '\n';
+                    writer.used = (size_t)(p - writer.buffer);
+                }
+
+                group++;
+                next_group = (group < config->groups) ? config->faces * group / config->groups : config->faces;
+            }
+
+            if (ok && config->usemtl && face % config->usemtl == 0)
+            {
+                p = writer_reserve(&writer, 32);
+                ok = p != 0;
+                if (ok)
+                {
+                    p = write_string(p, "usemtl material");
+                    p = write_uint(p, (face / config->usemtl) % config->materials);
+                    *p++ = '\n';
+                    writer.used = (size_t)(p - writer.buffer);
+                }
+            }
+
+            ok = ok && write_face(&writer, config, first, range, written, &state);
+        }
+    }
+
+    ok = ok && writer_flush(&writer);
+    ok = (fclose(writer.file) == 0) && ok;
+
+    free(writer.buffer);
+
+    *size = writer.written;
+
+    return ok;
+}
+
+
+static
+uint64_t parse_count(const char* s)
+{
+    char*    end;
+    uint64_t v;
+
+
+    /* 1M, 250k, 2G */
+    v = (uint64_t)(strtoull(s, &end, 10));
+    if (*end == 'k' || *end == 'K')
+        v *= 1000;
+    else if (*end == 'm' || *end == 'M')
+        v *= 1000000;
+    else if (*end == 'g' || *end == 'G')
+        v *= 1000000000;
+
+    return v;
+}
+
+
+static
+const char* attrs_name(BenchAttrs attrs)
+{
+    switch (attrs)
+    {
+    case ATTRS_V:       return "v";
+    case ATTRS_V_VT:    return "v/vt";
+    case ATTRS_V_VT_VN: return "v/vt/vn";
+    case ATTRS_V_VN:    return "v//vn";
+    }
+
+    return "?";
+}
+
+
+static
+int attrs_parse(const char* s, BenchAttrs* attrs)
+{
+    BenchAttrs ii;
+
+    for (ii = ATTRS_V; ii <= ATTRS_V_VN; ii = (BenchAttrs)(ii + 1))
+    {
+        if (strcmp(s, attrs_name(ii)) == 0)
+        {
+            *attrs = ii;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static
+int compare_double(const void* a, const void* b)
+{
+    double da = *(const double*)(a);
+    double db = *(const double*)(b);
+
+    return (da > db) - (da < db);
+}
+
+
+static
+int bench_file(FILE* json, const char* path, const BenchConfig* config, unsigned int runs, unsigned int threads, int first)
+{
+    fastObjReadOptions options;
+    fastObjMesh*       mesh;
+    BenchCounters      counts;
+    double             times[MAX_RUNS];
+    double             start;
+    double             median;
+    double             total;
+    uint64_t           peak_before;
+    uint64_t           peak;
+    uint64_t           size;
+    uint64_t           faces;
+    uint64_t           indices;
+    uint64_t           positions;
+    int64_t            modified;
+    unsigned int       ii;
+    int                reset;
+
+
+    if (!file_stat(path, &size, &modified))
+    {
+        fprintf(stderr, "bench_obj: can't stat %s\n", path);
+        return 0;
+    }
+
+    faces     = 0;
+    indices   = 0;
+    positions = 0;
+    memset(&counts, 0, sizeof(counts));
+
+    reset       = bench_peak_reset();
+    peak_before = bench_peak_rss();
+
+    for (ii = 0; ii < runs; ii++)
+    {
+        memset((void*)(&counters), 0, sizeof(counters));
+
+        /* fast_obj_read unless a thread count is asked for */
+        start = bench_time();
+        if (threads)
+        {
+            options = fast_obj_read_options_default();
+            options.thread_count = threads;
+            mesh = fast_obj_read_with_options(path, 0, 0, &options);
+        }
+        else
+        {
+            mesh = fast_obj_read(path);
+        }
+        times[ii] = bench_time() - start;
+
+        if (!mesh)
+        {
+            fprintf(stderr, "bench_obj: can't read %s\n", path);
+            return 0;
+        }
+
+        faces     = mesh->face_count;
+        indices   = mesh->index_count;
+        positions = mesh->position_count - 1;
+
+        fast_obj_destroy(mesh);
+
+        /* Every run allocates the same, keep the counts of one of them */
+        counts.allocs   = counters.allocs;
+        counts.reallocs = counters.reallocs;
+        counts.frees    = counters.frees;
+        counts.bytes    = counters.bytes;
+    }
+
+    peak = bench_peak_rss();
+
+    total = 0;
+    for (ii = 0; ii < runs; ii++)
+        total += times[ii];
+
+    qsort(times, runs, sizeof(double), compare_double);
+    median = (runs % 2) ? times[runs / 2] : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+
+    fprintf(stderr, "%-8s degree %u%s usemtl %-6llu groups %-5u  %8.1f MB  %7.1f ms  %7.1f MB/s  %6.2f Mfaces/s  %lld allocs\n",
+            config ? attrs_name(config->attrs) : "file",
+            config ? config->degree : 0,
+            (config && config->negative) ? " neg" : "    ",
+            config ? (unsigned long long)(config->usemtl) : 0ull,
+            config ? config->groups : 0,
+            (double)(size) / 1e6, median * 1e3,
+            (double)(size) / 1e6 / median, (double)(faces) / 1e6 / median,
+            (long long)(counts.allocs + counts.reallocs));
+
+    fprintf(json, "%s    {\n", first ? "" : ",\n");
+    fprintf(json, "      \"path\": \"");
+    for (; *path; path++)
+    {
+        if (*path == '"' || *path == '\\')
+            fputc('\\', json);
+        fputc(*path, json);
+    }
+    fprintf(json, "\",\n");
+
+    if (config)
+    {
+        fprintf(json, "      \"config\": { \"faces\": %llu, \"degree\": %u, \"attrs\": \"%s\", \"negative\": %s, \"usemtl\": %llu, \"materials\": %u, \"groups\": %u, \"seed\": %llu },\n",
+                (unsigned long long)(config->faces), config->degree, attrs_name(config->attrs), config->negative ? "true" : "false",
+                (unsigned long long)(config->usemtl), config->materials, config->groups, (unsigned long long)(config->seed));
+    }
+
+    fprintf(json, "      \"reader\": \"%s\",\n", threads ? "fast_obj_read_with_options" : "fast_obj_read");
+    fprintf(json, "      \"threads\": %u,\n", threads ? threads : 1);
+    fprintf(json, "      \"bytes\": %llu,\n", (unsigned long long)(size));
+    fprintf(json, "      \"faces\": %llu,\n", (unsigned long long)(faces));
+    fprintf(json, "      \"indices\": %llu,\n", (unsigned long long)(indices));
+    fprintf(json, "      \"positions\": %llu,\n", (unsigned long long)(positions));
+    fprintf(json, "      \"runs\": %u,\n", runs);
+    fprintf(json, "      \"seconds\": { \"min\": %.6f, \"median\": %.6f, \"mean\": %.6f, \"max\": %.6f },\n",
+            times[0], median, total / runs, times[runs - 1]);
+    fprintf(json, "      \"mb_per_second\": %.2f,\n", (double)(size) / 1e6 / median);
+    fprintf(json, "      \"faces_per_second\": %.0f,\n", (double)(faces) / median);
+    fprintf(json, "      \"allocations\": { \"allocs\": %lld, \"reallocs\": %lld, \"frees\": %lld, \"bytes\": %lld },\n",
+            (long long)(counts.allocs), (long long)(counts.reallocs), (long long)(counts.frees), (long long)(counts.bytes));
+
+    /* Without a reset the peak is the whole process', it only belongs to
+       this file when reading it raised it */
+    if (reset || peak > peak_before)
+        fprintf(json, "      \"peak_rss\": %llu\n", (unsigned long long)(peak));
+    else
+        fprintf(json, "      \"peak_rss\": null\n");
+    fprintf(json, "    }");
+
+    return 1;
+}
+
+
+static
+int bench_config(FILE* json, const char* path, const BenchConfig* config, unsigned int runs, unsigned int threads, int keep, int first)
+{
+    uint64_t size;
+    double   start;
+    int      ok;
+
+
+    start = bench_time();
+    if (!generate(path, config, &size))
+    {
+        fprintf(stderr, "bench_obj: can't write %s\n", path);
+        remove(path);
+        return 0;
+    }
+
+    fprintf(stderr, "generated %s, %.1f MB in %.2f s\n", path, (double)(size) / 1e6, bench_time() - start);
+
+    ok = bench_file(json, path, config, runs, threads, first);
+
+    if (!keep)
+        remove(path);
+
+    return ok;
+}
+
+
+static
+char* suite_path(const char* out, unsigned int index)
+{
+    const char* name;
+    const char* ext;
+    char*       path;
+
+
+    /* Suite files are numbered before the extension, out.obj as out.2.obj,
+       so --keep keeps all of them */
+    name = out;
+    for (ext = out; *ext; ext++)
+        if (*ext == '/' || *ext == '\\')
+            name = ext + 1;
+
+    ext = strrchr(name, '.');
+    if (!ext || ext == name)
+        ext = name + strlen(name);
+
+    path = (char*)(malloc(strlen(out) + 16));
+    if (path)
+        sprintf(path, "%.*s.%u%s", (int)(ext - out), out, index, ext);
+
+    return path;
+}
+
+
+static
+void usage(void)
+{
+    fprintf(stderr,
+        "usage: bench_obj [options]\n"
+        "  --faces N         faces to generate, with k/M/G suffixes (default 1M)\n"
+        "  --degree N        vertices per face (default 3)\n"
+        "  --attrs A         v, v/vt, v/vt/vn or v//vn (default v/vt/vn)\n"
+        "  --negative        relative (negative) indices\n"
+        "  --usemtl N        usemtl every N faces (default 0, none)\n"
+        "  --materials N     materials usemtl cycles through (default 16)\n"
+        "  --groups N        g lines spread over the faces (default 0)\n"
+        "  --seed N          generator seed (default 1)\n"
+        "  --suite           a fixed set of configurations at --faces, then\n"
+        "                    --input or " SUITE_MODEL " when it is there\n"
+        "  --input PATH      measure an existing file instead\n"
+        "  --out PATH        generated file (default bench_obj.tmp.obj)\n"
+        "  --keep            keep the generated files\n"
+        "  --runs N          reads of each file (default 5)\n"
+        "  --threads N       read with fast_obj_read_with_options and N threads\n"
+        "  --json PATH       write the JSON there instead of stdout\n");
+}
+
+
+int main(int argc, char** argv)
+{
+    BenchConfig  config;
+    BenchConfig  suite[6];
+    FILE*        json;
+    char*        path;
+    const char*  input;
+    const char*  out;
+    const char*  json_path;
+    uint64_t     size;
+    int64_t      modified;
+    unsigned int runs;
+    unsigned int threads;
+    unsigned int ii;
+    int          use_suite;
+    int          keep;
+    int          ok;
+
+
+    config.faces     = 1000000;
+    config.degree    = 3;
+    config.attrs     = ATTRS_V_VT_VN;
+    config.negative  = 0;
+    config.usemtl    = 0;
+    config.materials = 16;
+    config.groups    = 0;
+    config.seed      = 1;
+
+    input     = 0;
+    out       = "bench_obj.tmp.obj";
+    json_path = 0;
+    runs      = 5;
+    threads   = 0;
+    use_suite = 0;
+    keep      = 0;
+
+    for (ii = 1; ii < (unsigned int)(argc); ii++)
+    {
+        const char* arg   = argv[ii];
+        const char* value = (ii + 1 < (unsigned int)(argc)) ? argv[ii + 1] : 0;
+
+        if (strcmp(arg, "--negative") == 0)
+            config.negative = 1;
+        else if (strcmp(arg, "--suite") == 0)
+            use_suite = 1;
+        else if (strcmp(arg, "--keep") == 0)
+            keep = 1;
+        else if (!value)
+            break;
+        else if (strcmp(arg, "--faces") == 0)
+            config.faces = parse_count(value), ii++;
+        else if (strcmp(arg, "--degree") == 0)
+            config.degree = (unsigned int)(parse_count(value)), ii++;
+        else if (strcmp(arg, "--attrs") == 0 && attrs_parse(value, &config.attrs))
+            ii++;
+        else if (strcmp(arg, "--usemtl") == 0)
+            config.usemtl = parse_count(value), ii++;
+        else if (strcmp(arg, "--materials") == 0)
+            config.materials = (unsigned int)(parse_count(value)), ii++;
+        else if (strcmp(arg, "--groups") == 0)
+            config.groups = (unsigned int)(parse_count(value)), ii++;
+        else if (strcmp(arg, "--seed") == 0)
+            config.seed = parse_count(value), ii++;
+        else if (strcmp(arg, "--input") == 0)
+            input = value, ii++;
+        else if (strcmp(arg, "--out") == 0)
+            out = value, ii++;
+        else if (strcmp(arg, "--runs") == 0)
+            runs = (unsigned int)(parse_count(value)), ii++;
+        else if (strcmp(arg, "--threads") == 0)
+            threads = (unsigned int)(parse_count(value)), ii++;
+        else if (strcmp(arg, "--json") == 0)
+            json_path = value, ii++;
+        else
+            break;
+    }
+
+    if (ii < (unsigned int)(argc) || config.faces == 0 || config.degree < 3 || config.degree > 64 ||
+        config.materials == 0 || runs == 0 || runs > MAX_RUNS)
+    {
+        usage();
+        return 1;
+    }
+
+    json = json_path ? fopen(json_path, "w") : stdout;
+    if (!json)
+    {
+        fprintf(stderr, "bench_obj: can't write %s\n", json_path);
+        return 1;
+    }
+
+    fprintf(json, "{\n  \"fast_obj_version\": \"%d.%d\",\n  \"results\": [\n", FAST_OBJ_VERSION_MAJOR, FAST_OBJ_VERSION_MINOR);
+
+    if (use_suite)
+    {
+        /* Each attribute mix, then quads with relative indices, then a file
+           with many materials and groups */
+        for (ii = 0; ii < 6; ii++)
+            suite[ii] = config;
+
+        suite[0].attrs = ATTRS_V;
+        suite[1].attrs = ATTRS_V_VT;
+        suite[2].attrs = ATTRS_V_VT_VN;
+        suite[3].attrs = ATTRS_V_VN;
+
+        suite[4].degree   = 4;
+        suite[4].negative = 1;
+
+        suite[5].usemtl = 100;
+        suite[5].groups = 1000;
+
+        ok = 1;
+        for (ii = 0; ok && ii < 6; ii++)
+        {
+            path = suite_path(out, ii);
+            ok   = path && bench_config(json, path, &suite[ii], runs, threads, keep, ii == 0);
+            free(path);
+        }
+
+        /* and a real model, so parser changes can be checked on one */
+        if (ok && (input || file_stat(SUITE_MODEL, &size, &modified)))
+            ok = bench_file(json, input ? input : SUITE_MODEL, 0, runs, threads, 0);
+        else if (ok)
+            fprintf(stderr, "bench_obj: no %s, measured only generated files\n", SUITE_MODEL);
+    }
+    else if (input)
+    {
+        ok = bench_file(json, input, 0, runs, threads, 1);
+    }
+    else
+    {
+        ok = bench_config(json, out, &config, runs, threads, keep, 1);
+    }
+
+    fprintf(json, "\n  ]\n}\n");
+
+    if (json_path)
+        fclose(json);
+
+    return ok ? 0 : 1;
+}
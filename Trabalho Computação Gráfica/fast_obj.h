@@ -34,6 +34,16 @@
 #define FAST_OBJ_VERSION_MINOR  3
 #define FAST_OBJ_VERSION        ((FAST_OBJ_VERSION_MAJOR << 8) | FAST_OBJ_VERSION_MINOR)
 
+/* Load flags: attributes left out of the mesh, their lines are not parsed */
+#define FAST_OBJ_SKIP_TEXCOORDS (1 << 0)
+#define FAST_OBJ_SKIP_NORMALS   (1 << 1)
+#define FAST_OBJ_SKIP_COLORS    (1 << 2)
+#define FAST_OBJ_SKIP_LINES     (1 << 3)
+#define FAST_OBJ_SKIP_MATERIALS (1 << 4)
+
+/* Compact mesh flags: 2x8 bit normals instead of 2x16 bit */
+#define FAST_OBJ_COMPACT_NORMALS_8 (1 << 0)
+
 #include <stdlib.h>
 
 
@@ -111,6 +121,14 @@ typedef struct
     /* First index in fastObjMesh indices array */
     unsigned int                index_offset;
 
+    /* Number of face vertices (indices) */
+    unsigned int                index_count;
+
+    /* Bounding box of the positions used by the faces (zero unless read
+       with the group_bounds option) */
+    float                       bounds_min[3];
+    float                       bounds_max[3];
+
 } fastObjGroup;
 
 
@@ -159,6 +177,13 @@ typedef struct
     unsigned int                group_count;
     fastObjGroup*               groups;
 
+    /* Bounding box of the positions (zero when there are none) */
+    float                       bounds_min[3];
+    float                       bounds_max[3];
+
+    /* Blocks holding all of the mesh memory when read with the arena option */
+    struct fastObjArena*        arena;
+
 } fastObjMesh;
 
 typedef struct
@@ -169,14 +194,299 @@ typedef struct
     unsigned long               (*file_size)(void* file, void* user_data);
 } fastObjCallbacks;
 
+typedef struct
+{
+    /* Number of threads used to parse the file: 0 uses one per processor,
+       1 parses on the calling thread */
+    unsigned int                thread_count;
+
+    /* Non-zero counts the lines of the file in a first pass so the mesh
+       arrays are allocated once at their final size */
+    int                         presize;
+
+    /* Non-zero allocates the mesh from a few large blocks, so destroying it
+       is a handful of frees.  Implies presize */
+    int                         arena;
+
+    /* Non-zero keeps parsed .mtl files in a process-wide cache shared by all
+       reads with this option, a file is parsed again when its size or
+       modification time changes */
+    int                         mtl_cache;
+
+    /* Non-zero also finds the bounding box of each object and group */
+    int                         group_bounds;
+
+    /* FAST_OBJ_SKIP_* flags.  Indices of skipped texcoords/normals are 0,
+       faces all use material 0 without materials, and 'l' lines are dropped.
+       fast_obj_read_cached only uses a cache written with the same flags */
+    unsigned int                skip;
+
+    /* Called with the bytes parsed so far and the total (0 when file_size
+       is 0) about once per 64KB read.  Always called on the thread that
+       started the read, also when the file is parsed on several threads */
+    void                        (*progress)(unsigned long long done, unsigned long long total, void* user_data);
+
+    /* Checked after each progress report, non-zero stops the read, which
+       frees what was parsed and returns 0 */
+    int                         (*cancel)(void* user_data);
+
+    /* Passed to progress and cancel */
+    void*                       progress_data;
+
+} fastObjReadOptions;
+
+typedef struct
+{
+    /* v/vt/vn lines: index into the matching fastObjMesh array and the values
+       (rgb is 0 for positions without a color) */
+    void                        (*position)(unsigned int index, const float* xyz, const float* rgb, void* user_data);
+    void                        (*texcoord)(unsigned int index, const float* uv, void* user_data);
+    void                        (*normal)(unsigned int index, const float* xyz, void* user_data);
+
+    /* f/l lines, indices resolved the same way as fastObjMesh indices */
+    void                        (*face)(const fastObjIndex* indices, unsigned int count, unsigned int material, int line, void* user_data);
+
+    /* usemtl lines: index into fastObjMesh materials */
+    void                        (*material)(unsigned int index, const fastObjMaterial* material, void* user_data);
+
+    /* o/g lines */
+    void                        (*object)(const char* name, void* user_data);
+    void                        (*group)(const char* name, void* user_data);
+
+} fastObjParserCallbacks;
+
+/* Incremental parser fed with arbitrary pieces of a file */
+typedef struct fastObjParser    fastObjParser;
+
+typedef struct
+{
+    float                       position[3];
+    float                       texcoord[2];
+    float                       normal[3];
+
+} fastObjVertex;
+
+typedef struct
+{
+    /* Index in fastObjMesh materials */
+    unsigned int                material;
+
+    /* Part of the fastObjBuffer index buffer drawn with it */
+    unsigned int                index_offset;
+    unsigned int                index_count;
+
+} fastObjRange;
+
+/* Render-ready copy of a mesh: one vertex per unique p/t/n combination
+   and a triangle list, split into runs of faces with the same material */
+typedef struct
+{
+    unsigned int                vertex_count;
+    fastObjVertex*              vertices;
+
+    /* Triangle list, unsigned short when index_size is 2, otherwise unsigned int */
+    unsigned int                index_count;
+    unsigned int                index_size;
+    void*                       indices;
+
+    unsigned int                range_count;
+    fastObjRange*               ranges;
+
+    /* Face vertices the buffer was built from (vertex_count / corner_count is the dedup ratio) */
+    unsigned int                corner_count;
+
+} fastObjBuffer;
+
+typedef struct
+{
+    /* Byte range of a run of lines between o/g/usemtl statements (long runs are split) */
+    unsigned long long          offset;
+    unsigned long long          size;
+
+    /* Index in fastObjPartIndex names of the statement setting the current
+       object, group and material, 0 for none */
+    unsigned int                object;
+    unsigned int                group;
+    unsigned int                material;
+
+    /* Number of v/vt/vn lines before the part */
+    unsigned int                position_base;
+    unsigned int                texcoord_base;
+    unsigned int                normal_base;
+
+    /* Number of f/l lines in the part */
+    unsigned int                face_count;
+
+} fastObjPart;
+
+/* Where the objects and groups of a file are, to read only some of them */
+typedef struct
+{
+    unsigned int                part_count;
+    fastObjPart*                parts;
+
+    /* Names from o/g/usemtl statements in file order, after a dummy 0 */
+    unsigned int                name_count;
+    char**                      names;
+
+    /* mtllib statements */
+    unsigned int                library_count;
+    char**                      libraries;
+
+    /* Number of v/vt/vn lines in the file */
+    unsigned int                position_count;
+    unsigned int                texcoord_count;
+    unsigned int                normal_count;
+
+    /* Size and modification time of the file when it was indexed */
+    unsigned long long          file_size;
+    long long                   file_time;
+
+} fastObjPartIndex;
+
+/* Quantized copy of a mesh, read through the fast_obj_compact_* accessors.
+   Arrays keep the fastObjMesh layout and dummy first elements, integer
+   arrays are 0 (absent, all zero), 1, 2, 3 or 4 little endian bytes wide */
+typedef struct
+{
+    /* Positions as 3 unsigned shorts: offset + value * scale */
+    unsigned int                position_count;
+    unsigned short*             positions;
+    float                       position_offset[3];
+    float                       position_scale[3];
+
+    /* Texcoords as 2 half floats */
+    unsigned int                texcoord_count;
+    unsigned short*             texcoords;
+
+    /* Normals as 2 octahedral coordinates, normal_size bytes signed each */
+    unsigned int                normal_count;
+    unsigned int                normal_size;
+    void*                       normals;
+
+    /* Colors as 3 unsigned bytes */
+    unsigned int                color_count;
+    unsigned char*              colors;
+
+    /* Face data */
+    unsigned int                face_count;
+    unsigned int                face_vertex_size;
+    void*                       face_vertices;
+    unsigned int                face_material_size;
+    void*                       face_materials;
+    unsigned char*              face_lines;
+
+    /* Index data, texcoord/normal indices point at the position indices
+       when they are the same for every face vertex */
+    unsigned int                index_count;
+    unsigned int                position_index_size;
+    void*                       position_indices;
+    unsigned int                texcoord_index_size;
+    void*                       texcoord_indices;
+    unsigned int                normal_index_size;
+    void*                       normal_indices;
+
+    /* Copies of the mesh materials, textures, objects and groups */
+    unsigned int                material_count;
+    fastObjMaterial*            materials;
+    unsigned int                texture_count;
+    fastObjTexture*             textures;
+    unsigned int                object_count;
+    fastObjGroup*               objects;
+    unsigned int                group_count;
+    fastObjGroup*               groups;
+
+    float                       bounds_min[3];
+    float                       bounds_max[3];
+
+    /* Largest difference between a decoded value and the mesh: per component
+       for positions, texcoords and colors, and the distance between unit
+       vectors (about the angle in radians) for normals */
+    float                       position_error;
+    float                       texcoord_error;
+    float                       normal_error;
+    float                       color_error;
+
+    /* Bytes allocated for the arrays above */
+    size_t                      memory;
+
+} fastObjCompact;
+
+typedef struct
+{
+    /* Number of files read at the same time: 0 uses one per processor.  Only
+       that many meshes are ever partially built, which bounds peak memory */
+    unsigned int                thread_count;
+
+    /* Options for every file.  A thread_count of 0 here shares the processors
+       between the files being read at the same time */
+    fastObjReadOptions          options;
+
+    /* Non-zero reads through fast_obj_read_cached with cache_dir */
+    int                         cached;
+    const char*                 cache_dir;
+
+} fastObjBatchOptions;
+
+typedef struct
+{
+    /* Mesh read from the path at the same position, 0 if it failed */
+    fastObjMesh*                mesh;
+
+    /* Seconds from the start of the batch to the start of this read, and
+       seconds spent reading the file */
+    double                      start;
+    double                      seconds;
+
+} fastObjBatchResult;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 fastObjMesh*                    fast_obj_read(const char* path);
 fastObjMesh*                    fast_obj_read_with_callbacks(const char* path, const fastObjCallbacks* callbacks, void* user_data);
+fastObjMesh*                    fast_obj_read_with_options(const char* path, const fastObjCallbacks* callbacks, void* user_data, const fastObjReadOptions* options);
+fastObjMesh*                    fast_obj_read_mapped(const char* path);
+fastObjMesh*                    fast_obj_read_with_flags(const char* path, unsigned int flags);
+fastObjMesh*                    fast_obj_read_cached(const char* path, const char* cache_dir, const fastObjReadOptions* options);
+fastObjMesh*                    fast_obj_cache_read(const char* path, const char* cache_path);
+int                             fast_obj_cache_write(const fastObjMesh* mesh, const char* path, const char* cache_path);
+fastObjReadOptions              fast_obj_read_options_default(void);
+fastObjCallbacks                fast_obj_gzip_callbacks(void);
+void                            fast_obj_mtl_cache_clear(void);
 void                            fast_obj_destroy(fastObjMesh* mesh);
 
+fastObjParser*                  fast_obj_parser_create(const char* path, const fastObjParserCallbacks* callbacks, void* user_data);
+int                             fast_obj_parser_feed(fastObjParser* parser, const void* data, size_t bytes);
+int                             fast_obj_parser_finish(fastObjParser* parser);
+const fastObjMesh*              fast_obj_parser_mesh(const fastObjParser* parser);
+void                            fast_obj_parser_destroy(fastObjParser* parser);
+
+int                             fast_obj_triangulate(fastObjMesh* mesh, unsigned int thread_count);
+
+fastObjBuffer*                  fast_obj_buffer_create(const fastObjMesh* mesh, unsigned int thread_count);
+void                            fast_obj_buffer_destroy(fastObjBuffer* buffer);
+
+fastObjPartIndex*               fast_obj_part_index_create(const char* path);
+fastObjPartIndex*               fast_obj_part_index_read(const char* path, const char* index_path);
+int                             fast_obj_part_index_write(const fastObjPartIndex* index, const char* index_path);
+void                            fast_obj_part_index_destroy(fastObjPartIndex* index);
+fastObjMesh*                    fast_obj_read_parts(const char* path, const fastObjPartIndex* index, const char* const* names, unsigned int name_count);
+
+fastObjCompact*                 fast_obj_compact_create(const fastObjMesh* mesh, unsigned int flags, unsigned int thread_count);
+void                            fast_obj_compact_destroy(fastObjCompact* compact);
+void                            fast_obj_compact_position(const fastObjCompact* compact, unsigned int index, float* xyz);
+void                            fast_obj_compact_texcoord(const fastObjCompact* compact, unsigned int index, float* uv);
+void                            fast_obj_compact_normal(const fastObjCompact* compact, unsigned int index, float* xyz);
+void                            fast_obj_compact_color(const fastObjCompact* compact, unsigned int index, float* rgb);
+fastObjIndex                    fast_obj_compact_index(const fastObjCompact* compact, unsigned int corner);
+unsigned int                    fast_obj_compact_face_vertices(const fastObjCompact* compact, unsigned int face);
+unsigned int                    fast_obj_compact_face_material(const fastObjCompact* compact, unsigned int face);
+
+fastObjBatchOptions             fast_obj_batch_options_default(void);
+unsigned int                    fast_obj_read_batch(const char* const* paths, unsigned int count, const fastObjBatchOptions* options, fastObjBatchResult* results);
+
 #ifdef __cplusplus
 }
 #endif
@@ -188,6 +498,30 @@ void                            fast_obj_destroy(fastObjMesh* mesh);
 
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <float.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#ifndef FAST_OBJ_NO_THREADS
+#include <pthread.h>
+#endif
+#endif
+
+#if !defined(FAST_OBJ_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define FAST_OBJ_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 
 #ifndef FAST_OBJ_REALLOC
 #define FAST_OBJ_REALLOC        realloc
@@ -197,6 +531,24 @@ void                            fast_obj_destroy(fastObjMesh* mesh);
 #define FAST_OBJ_FREE           free
 #endif
 
+#if defined(__GNUC__)
+#define FAST_OBJ_NOINLINE       __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define FAST_OBJ_NOINLINE       __declspec(noinline)
+#else
+#define FAST_OBJ_NOINLINE
+#endif
+
+#if defined(FAST_OBJ_NO_THREADS)
+#define FAST_OBJ_THREAD_LOCAL
+#elif defined(_MSC_VER)
+#define FAST_OBJ_THREAD_LOCAL   __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define FAST_OBJ_THREAD_LOCAL   _Thread_local
+#else
+#define FAST_OBJ_THREAD_LOCAL   __thread
+#endif
+
 #ifdef _WIN32
 #define FAST_OBJ_SEPARATOR      '\\'
 #define FAST_OBJ_OTHER_SEP      '/'
@@ -209,8 +561,98 @@ void                            fast_obj_destroy(fastObjMesh* mesh);
 /* Size of buffer to read into */
 #define BUFFER_SIZE             65536
 
-/* Max supported power when parsing float */
-#define MAX_POWER               20
+/* Bytes past the final new line of a buffer that the parser may read */
+#define BUFFER_PADDING          8
+
+/* Decimal exponents outside this range round to zero or infinity as float */
+#define FLOAT_MIN_POWER         (-65)
+#define FLOAT_MAX_POWER         38
+
+/* Smallest part of a file handed to a parsing thread */
+#define MIN_CHUNK_SIZE          (1 << 20)
+
+/* Upper limit on parsing threads */
+#define MAX_THREADS             64
+
+/* Fewest faces given to each thread triangulating a mesh */
+#define MIN_TRIANGULATE_FACES   (1 << 16)
+
+/* Fewest face vertices given to each thread building a fastObjBuffer */
+#define MIN_BUFFER_CORNERS      (1 << 16)
+
+/* Version of the binary mesh cache format */
+#define CACHE_VERSION           4
+
+/* Version of the part index file format */
+#define PART_INDEX_VERSION      1
+
+/* Parts longer than this are split, so vertices are found by parsing a few
+   blocks of lines instead of a whole run of them */
+#define PART_BLOCK_SIZE         (1 << 20)
+
+/* Minimum number of elements for each thread encoding a compact mesh */
+#define MIN_COMPACT_ITEMS       (1 << 16)
+
+/* Compressed bytes read at a time from a gzip file */
+#define GZIP_INPUT_SIZE         65536
+
+/* Inflated bytes buffered ahead of the parser, a power of two that holds the
+   32KB deflate window and the longest match */
+#define GZIP_RING_SIZE          (1 << 20)
+
+/* Inflated bytes after which the decoder hands what it has to the parser */
+#define GZIP_PUBLISH_SIZE       65536
+
+/* Bits decoded by table lookup, longer Huffman codes are searched */
+#define GZIP_FAST_BITS          9
+
+/* Size of arena blocks, allocations above a quarter of this get their own */
+#define ARENA_BLOCK_SIZE        65536
+
+/* Alignment of arena allocations */
+#define ARENA_ALIGN             16
+
+
+typedef struct
+{
+    /* Library (mtllib) or material (usemtl) name */
+    char*                       name;
+
+    /* Non-zero for mtllib statements */
+    int                         library;
+
+} fastObjStatement;
+
+
+typedef struct
+{
+    /* Number of v/vt/vn lines */
+    fastObjUInt                 position_count;
+    fastObjUInt                 texcoord_count;
+    fastObjUInt                 normal_count;
+
+    /* Number of f/l lines and their vertices */
+    fastObjUInt                 face_count;
+    fastObjUInt                 index_count;
+
+} fastObjCounts;
+
+
+typedef struct
+{
+    /* Open addressing table of array index + 1, 0 for empty slots */
+    fastObjUInt*                slots;
+    fastObjUInt                 size;
+
+    /* Array elements added to the table so far */
+    fastObjUInt                 count;
+
+} fastObjNames;
+
+
+/* Progress of a read, defined with the thread helpers */
+typedef struct fastObjProgress  fastObjProgress;
+
 
 typedef struct
 {
@@ -230,1382 +672,8741 @@ typedef struct
     /* Base path for materials/textures */
     char*                       base;
 
+    /* Vertex counts preceding the mesh arrays (non-zero for chunks) */
+    fastObjUInt                 position_base;
+    fastObjUInt                 texcoord_base;
+    fastObjUInt                 normal_base;
+
+    /* Set when parsing a chunk of the file on a worker thread */
+    int                         chunked;
+
+    /* Set when arrays are sized from a counting pass before parsing */
+    int                         presize;
+
+    /* FAST_OBJ_SKIP_* flags */
+    unsigned int                skip;
+
+    /* Material statements recorded by chunks, resolved when merging */
+    fastObjStatement*           statements;
+
+    /* Materials and textures by name */
+    fastObjNames                material_names;
+    fastObjNames                texture_names;
+
+    /* Set when .mtl files come from the shared cache */
+    int                         mtl_cache;
+
+    /* Bounding box of the positions parsed so far (inverted while empty) */
+    float                       bounds_min[3];
+    float                       bounds_max[3];
+
+    /* Set to grow object/group bounding boxes as faces are parsed */
+    int                         group_bounds;
+
+    /* Set when faces use positions that are not parsed yet, the object/group
+       bounding boxes are then found from the indices once parsing is done */
+    int                         bounds_pending;
+
+    /* Push parser callbacks, faces are dropped once they are reported */
+    const fastObjParserCallbacks* handlers;
+    void*                       handler_data;
+
+    /* Progress shared by every thread parsing the file, 0 when not wanted,
+       and set on the one thread that calls the callbacks */
+    fastObjProgress*            progress;
+    int                         report;
+
 } fastObjData;
 
 
+typedef struct
+{
+    /* Part of the file to parse, ending in a new line */
+    const char*                 start;
+    const char*                 end;
+
+    /* Line counts for the chunk (faces only when pre-sizing) */
+    fastObjCounts               counts;
+
+    /* Chunk parse state and output */
+    fastObjData                 data;
+    fastObjMesh                 mesh;
+
+    /* Merged mesh and where the chunk output goes in it */
+    fastObjMesh*                target;
+    fastObjUInt                 position_offset;
+    fastObjUInt                 texcoord_offset;
+    fastObjUInt                 normal_offset;
+    fastObjUInt                 face_offset;
+    fastObjUInt                 index_offset;
+
+    /* Merged material index for each chunk material statement */
+    fastObjUInt*                materials;
+
+} fastObjChunk;
+
+
+typedef struct
+{
+    /* Mapped file contents */
+    const char*                 data;
+    size_t                      size;
+
+#ifdef _WIN32
+    HANDLE                      file;
+    HANDLE                      mapping;
+#endif
+
+} fastObjMapping;
+
+
 static const
-double POWER_10_POS[MAX_POWER] =
+double POWER_10_DOUBLE[23] =
 {
     1.0e0,  1.0e1,  1.0e2,  1.0e3,  1.0e4,  1.0e5,  1.0e6,  1.0e7,  1.0e8,  1.0e9,
     1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15, 1.0e16, 1.0e17, 1.0e18, 1.0e19,
+    1.0e20, 1.0e21, 1.0e22,
 };
 
+/* 128-bit truncated powers of five, scaled so the top bit is set, for
+   FLOAT_MIN_POWER to FLOAT_MAX_POWER (Eisel-Lemire conversion) */
 static const
-double POWER_10_NEG[MAX_POWER] =
+uint64_t POWER_5_128[FLOAT_MAX_POWER - FLOAT_MIN_POWER + 1][2] =
 {
-    1.0e0,   1.0e-1,  1.0e-2,  1.0e-3,  1.0e-4,  1.0e-5,  1.0e-6,  1.0e-7,  1.0e-8,  1.0e-9,
-    1.0e-10, 1.0e-11, 1.0e-12, 1.0e-13, 1.0e-14, 1.0e-15, 1.0e-16, 1.0e-17, 1.0e-18, 1.0e-19,
+    {0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL}, /* 1e-65 */
+    {0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL}, /* 1e-64 */
+    {0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL}, /* 1e-63 */
+    {0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL}, /* 1e-62 */
+    {0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL}, /* 1e-61 */
+    {0xcdb02555653131b6ULL, 0x3792f412cb06794dULL}, /* 1e-60 */
+    {0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL}, /* 1e-59 */
+    {0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL}, /* 1e-58 */
+    {0xc8de047564d20a8bULL, 0xf245825a5a445275ULL}, /* 1e-57 */
+    {0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL}, /* 1e-56 */
+    {0x9ced737bb6c4183dULL, 0x55464dd69685606bULL}, /* 1e-55 */
+    {0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL}, /* 1e-54 */
+    {0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL}, /* 1e-53 */
+    {0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL}, /* 1e-52 */
+    {0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL}, /* 1e-51 */
+    {0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL}, /* 1e-50 */
+    {0x95a8637627989aadULL, 0xdde7001379a44aa8ULL}, /* 1e-49 */
+    {0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL}, /* 1e-48 */
+    {0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL}, /* 1e-47 */
+    {0x9226712162ab070dULL, 0xcab3961304ca70e8ULL}, /* 1e-46 */
+    {0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL}, /* 1e-45 */
+    {0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL}, /* 1e-44 */
+    {0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL}, /* 1e-43 */
+    {0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL}, /* 1e-42 */
+    {0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL}, /* 1e-41 */
+    {0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL}, /* 1e-40 */
+    {0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL}, /* 1e-39 */
+    {0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL}, /* 1e-38 */
+    {0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL}, /* 1e-37 */
+    {0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL}, /* 1e-36 */
+    {0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL}, /* 1e-35 */
+    {0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL}, /* 1e-34 */
+    {0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL}, /* 1e-33 */
+    {0xcfb11ead453994baULL, 0x67de18eda5814af2ULL}, /* 1e-32 */
+    {0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL}, /* 1e-31 */
+    {0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL}, /* 1e-30 */
+    {0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL}, /* 1e-29 */
+    {0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL}, /* 1e-28 */
+    {0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL}, /* 1e-27 */
+    {0xc612062576589ddaULL, 0x95364afe032a819eULL}, /* 1e-26 */
+    {0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL}, /* 1e-25 */
+    {0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL}, /* 1e-24 */
+    {0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL}, /* 1e-23 */
+    {0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL}, /* 1e-22 */
+    {0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL}, /* 1e-21 */
+    {0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL}, /* 1e-20 */
+    {0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL}, /* 1e-19 */
+    {0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL}, /* 1e-18 */
+    {0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL}, /* 1e-17 */
+    {0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL}, /* 1e-16 */
+    {0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL}, /* 1e-15 */
+    {0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL}, /* 1e-14 */
+    {0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL}, /* 1e-13 */
+    {0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL}, /* 1e-12 */
+    {0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL}, /* 1e-11 */
+    {0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL}, /* 1e-10 */
+    {0x89705f4136b4a597ULL, 0x31680a88f8953031ULL}, /* 1e-9 */
+    {0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL}, /* 1e-8 */
+    {0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL}, /* 1e-7 */
+    {0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL}, /* 1e-6 */
+    {0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL}, /* 1e-5 */
+    {0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL}, /* 1e-4 */
+    {0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL}, /* 1e-3 */
+    {0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL}, /* 1e-2 */
+    {0xccccccccccccccccULL, 0xcccccccccccccccdULL}, /* 1e-1 */
+    {0x8000000000000000ULL, 0x0000000000000000ULL}, /* 1e0 */
+    {0xa000000000000000ULL, 0x0000000000000000ULL}, /* 1e1 */
+    {0xc800000000000000ULL, 0x0000000000000000ULL}, /* 1e2 */
+    {0xfa00000000000000ULL, 0x0000000000000000ULL}, /* 1e3 */
+    {0x9c40000000000000ULL, 0x0000000000000000ULL}, /* 1e4 */
+    {0xc350000000000000ULL, 0x0000000000000000ULL}, /* 1e5 */
+    {0xf424000000000000ULL, 0x0000000000000000ULL}, /* 1e6 */
+    {0x9896800000000000ULL, 0x0000000000000000ULL}, /* 1e7 */
+    {0xbebc200000000000ULL, 0x0000000000000000ULL}, /* 1e8 */
+    {0xee6b280000000000ULL, 0x0000000000000000ULL}, /* 1e9 */
+    {0x9502f90000000000ULL, 0x0000000000000000ULL}, /* 1e10 */
+    {0xba43b74000000000ULL, 0x0000000000000000ULL}, /* 1e11 */
+    {0xe8d4a51000000000ULL, 0x0000000000000000ULL}, /* 1e12 */
+    {0x9184e72a00000000ULL, 0x0000000000000000ULL}, /* 1e13 */
+    {0xb5e620f480000000ULL, 0x0000000000000000ULL}, /* 1e14 */
+    {0xe35fa931a0000000ULL, 0x0000000000000000ULL}, /* 1e15 */
+    {0x8e1bc9bf04000000ULL, 0x0000000000000000ULL}, /* 1e16 */
+    {0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL}, /* 1e17 */
+    {0xde0b6b3a76400000ULL, 0x0000000000000000ULL}, /* 1e18 */
+    {0x8ac7230489e80000ULL, 0x0000000000000000ULL}, /* 1e19 */
+    {0xad78ebc5ac620000ULL, 0x0000000000000000ULL}, /* 1e20 */
+    {0xd8d726b7177a8000ULL, 0x0000000000000000ULL}, /* 1e21 */
+    {0x878678326eac9000ULL, 0x0000000000000000ULL}, /* 1e22 */
+    {0xa968163f0a57b400ULL, 0x0000000000000000ULL}, /* 1e23 */
+    {0xd3c21bcecceda100ULL, 0x0000000000000000ULL}, /* 1e24 */
+    {0x84595161401484a0ULL, 0x0000000000000000ULL}, /* 1e25 */
+    {0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL}, /* 1e26 */
+    {0xcecb8f27f4200f3aULL, 0x0000000000000000ULL}, /* 1e27 */
+    {0x813f3978f8940984ULL, 0x4000000000000000ULL}, /* 1e28 */
+    {0xa18f07d736b90be5ULL, 0x5000000000000000ULL}, /* 1e29 */
+    {0xc9f2c9cd04674edeULL, 0xa400000000000000ULL}, /* 1e30 */
+    {0xfc6f7c4045812296ULL, 0x4d00000000000000ULL}, /* 1e31 */
+    {0x9dc5ada82b70b59dULL, 0xf020000000000000ULL}, /* 1e32 */
+    {0xc5371912364ce305ULL, 0x6c28000000000000ULL}, /* 1e33 */
+    {0xf684df56c3e01bc6ULL, 0xc732000000000000ULL}, /* 1e34 */
+    {0x9a130b963a6c115cULL, 0x3c7f400000000000ULL}, /* 1e35 */
+    {0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL}, /* 1e36 */
+    {0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL}, /* 1e37 */
+    {0x96769950b50d88f4ULL, 0x1314448000000000ULL}, /* 1e38 */
 };
 
 
-static void* memory_realloc(void* ptr, size_t bytes)
+typedef struct fastObjArenaBlock
 {
-    return FAST_OBJ_REALLOC(ptr, bytes);
-}
+    struct fastObjArenaBlock*   prev;
+    struct fastObjArenaBlock*   next;
 
+    /* Usable bytes and bytes handed out */
+    size_t                      size;
+    size_t                      used;
 
-static
-void memory_dealloc(void* ptr)
+    /* Offset of the most recent allocation, the only one that can change size in place */
+    size_t                      last;
+
+} fastObjArenaBlock;
+
+
+struct fastObjArena
 {
-    FAST_OBJ_FREE(ptr);
-}
+    /* Block for small allocations first, then the rest */
+    fastObjArenaBlock*          blocks;
 
+    /* Cache file whose contents are one of the blocks */
+    fastObjMapping              mapping;
+};
 
-#define array_clean(_arr)       ((_arr) ? memory_dealloc(_array_header(_arr)), 0 : 0)
-#define array_push(_arr, _val)  (_array_mgrow(_arr, 1) ? ((_arr)[_array_size(_arr)++] = (_val), _array_size(_arr) - 1) : 0)
-#define array_size(_arr)        ((_arr) ? _array_size(_arr) : 0)
-#define array_capacity(_arr)    ((_arr) ? _array_capacity(_arr) : 0)
-#define array_empty(_arr)       (array_size(_arr) == 0)
+typedef struct fastObjArena     fastObjArena;
 
-#define _array_header(_arr)     ((fastObjUInt*)(_arr)-2)
-#define _array_size(_arr)       (_array_header(_arr)[0])
-#define _array_capacity(_arr)   (_array_header(_arr)[1])
-#define _array_ngrow(_arr, _n)  ((_arr) == 0 || (_array_size(_arr) + (_n) >= _array_capacity(_arr)))
-#define _array_mgrow(_arr, _n)  (_array_ngrow(_arr, _n) ? (_array_grow(_arr, _n) != 0) : 1)
-#define _array_grow(_arr, _n)   (*((void**)&(_arr)) = array_realloc(_arr, _n, sizeof(*(_arr))))
 
+/* Arena used for allocations on this thread while a mesh is read */
+static FAST_OBJ_THREAD_LOCAL fastObjArena* current_arena;
 
-static void* array_realloc(void* ptr, fastObjUInt n, fastObjUInt b)
+
+#define ARENA_ROUND(_n)         (((_n) + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_HEADER            ARENA_ROUND(sizeof(fastObjArenaBlock))
+#define ARENA_NONE              ((size_t)(-1))
+
+/* Each allocation is preceded by ARENA_ALIGN bytes holding its size */
+#define _arena_data(_block)     ((char*)(_block) + ARENA_HEADER)
+#define _arena_size(_ptr)       (*(size_t*)((char*)(_ptr) - ARENA_ALIGN))
+
+
+static
+fastObjArena* arena_create(void)
 {
-    fastObjUInt sz = array_size(ptr);
-    fastObjUInt nsz = sz + n;
-    fastObjUInt cap = array_capacity(ptr);
-    fastObjUInt ncap = cap + cap / 2;
-    fastObjUInt* r;
+    fastObjArena* arena;
 
-    if (ncap < nsz)
-        ncap = nsz;
-    ncap = (ncap + 15) & ~15u;
 
-    r = (fastObjUInt*)(memory_realloc(ptr ? _array_header(ptr) : 0, (size_t)b * ncap + 2 * sizeof(fastObjUInt)));
-    if (!r)
+    arena = (fastObjArena*)(FAST_OBJ_REALLOC(0, sizeof(fastObjArena)));
+    if (!arena)
         return 0;
 
-    r[0] = sz;
-    r[1] = ncap;
+    arena->blocks = 0;
+    memset(&arena->mapping, 0, sizeof(fastObjMapping));
 
-    return (r + 2);
+    return arena;
 }
 
 
 static
-void* file_open(const char* path, void* user_data)
+void arena_destroy(fastObjArena* arena)
 {
-    (void)(user_data);
-    return fopen(path, "rb");
+    fastObjArenaBlock* block;
+    fastObjArenaBlock* next;
+
+
+    for (block = arena->blocks; block; block = next)
+    {
+        next = block->next;
+
+        /* The mapped block goes with the mapping */
+        if ((const char*)(block) < arena->mapping.data ||
+            (const char*)(block) >= arena->mapping.data + arena->mapping.size)
+            FAST_OBJ_FREE(block);
+    }
+
+    FAST_OBJ_FREE(arena);
 }
 
 
 static
-void file_close(void* file, void* user_data)
+fastObjArenaBlock* arena_find(fastObjArena* arena, const void* ptr)
 {
-    FILE* f;
-    (void)(user_data);
-    
-    f = (FILE*)(file);
-    fclose(f);
+    fastObjArenaBlock* block;
+    const char*        p = (const char*)(ptr);
+
+
+    for (block = arena->blocks; block; block = block->next)
+        if (p > _arena_data(block) && p < _arena_data(block) + block->used)
+            return block;
+
+    return 0;
 }
 
 
 static
-size_t file_read(void* file, void* dst, size_t bytes, void* user_data)
+void* arena_place(fastObjArenaBlock* block, size_t bytes)
 {
-    FILE* f;
-    (void)(user_data);
-    
-    f = (FILE*)(file);
-    return fread(dst, 1, bytes, f);
-}
+    char* p;
+
+
+    p = _arena_data(block) + block->used;
+
+    block->last  = block->used;
+    block->used += ARENA_ALIGN + ARENA_ROUND(bytes);
+
+    *(size_t*)(p) = bytes;
+
+    return p + ARENA_ALIGN;
+}
 
 
 static
-unsigned long file_size(void* file, void* user_data)
+void* arena_alloc(fastObjArena* arena, size_t bytes)
 {
-    FILE* f;
-    long p;
-    long n;
-    (void)(user_data);
+    fastObjArenaBlock* block;
+    fastObjArenaBlock* head;
+    size_t             need;
+    size_t             size;
 
-    f = (FILE*)(file);
 
-    p = ftell(f);
-    fseek(f, 0, SEEK_END);
-    n = ftell(f);
-    fseek(f, p, SEEK_SET);
+    need = ARENA_ALIGN + ARENA_ROUND(bytes);
+    head = arena->blocks;
 
-    if (n > 0)
-        return (unsigned long)(n);
-    else
+    if (head && need <= head->size - head->used)
+        return arena_place(head, bytes);
+
+
+    /* Large allocations get a block of their own behind the current one */
+    size = (need > ARENA_BLOCK_SIZE / 4) ? need : ARENA_BLOCK_SIZE;
+
+    block = (fastObjArenaBlock*)(FAST_OBJ_REALLOC(0, ARENA_HEADER + size));
+    if (!block)
         return 0;
+
+    block->size = size;
+    block->used = 0;
+    block->last = ARENA_NONE;
+
+    if (head && size != ARENA_BLOCK_SIZE)
+    {
+        block->prev = head;
+        block->next = head->next;
+        head->next  = block;
+    }
+    else
+    {
+        block->prev = 0;
+        block->next = head;
+        arena->blocks = block;
+    }
+
+    if (block->next)
+        block->next->prev = block;
+
+    return arena_place(block, bytes);
 }
 
 
 static
-char* string_copy(const char* s, const char* e)
+void* arena_realloc(fastObjArena* arena, fastObjArenaBlock* block, void* ptr, size_t bytes)
 {
-    size_t n;
-    char*  p;
-        
-    n = (size_t)(e - s);
-    p = (char*)(memory_realloc(0, n + 1));
-    if (p)
+    fastObjArenaBlock* moved;
+    void*              p;
+    size_t             old;
+
+
+    old = _arena_size(ptr);
+
+    if ((char*)(ptr) == _arena_data(block) + block->last + ARENA_ALIGN)
     {
-        memcpy(p, s, n);
-        p[n] = '\0';
+        /* Last allocation of a block can change size while there is room */
+        if (block->last + ARENA_ALIGN + ARENA_ROUND(bytes) <= block->size)
+        {
+            block->used = block->last + ARENA_ALIGN + ARENA_ROUND(bytes);
+            _arena_size(ptr) = bytes;
+            return ptr;
+        }
+
+        /* and a block holding a single allocation can be resized with it */
+        if (block->last == 0)
+        {
+            moved = (fastObjArenaBlock*)(FAST_OBJ_REALLOC(block, ARENA_HEADER + ARENA_ALIGN + ARENA_ROUND(bytes)));
+            if (!moved)
+                return 0;
+
+            if (moved->prev)
+                moved->prev->next = moved;
+            else
+                arena->blocks = moved;
+
+            if (moved->next)
+                moved->next->prev = moved;
+
+            moved->size = ARENA_ALIGN + ARENA_ROUND(bytes);
+            moved->used = moved->size;
+
+            p = _arena_data(moved) + ARENA_ALIGN;
+            _arena_size(p) = bytes;
+            return p;
+        }
     }
 
+
+    /* Otherwise copy, leaving the old space unused until the arena is freed */
+    p = arena_alloc(arena, bytes);
+    if (!p)
+        return 0;
+
+    memcpy(p, ptr, old < bytes ? old : bytes);
+
     return p;
 }
 
 
 static
-char* string_substr(const char* s, size_t a, size_t b)
+void arena_dealloc(fastObjArenaBlock* block, void* ptr)
 {
-    return string_copy(s + a, s + b);
+    /* Only the last allocation of a block is given back */
+    if ((char*)(ptr) == _arena_data(block) + block->last + ARENA_ALIGN)
+    {
+        block->used = block->last;
+        block->last = ARENA_NONE;
+    }
 }
 
 
-static
-char* string_concat(const char* a, const char* s, const char* e)
+static void* memory_realloc(void* ptr, size_t bytes)
 {
-    size_t an;
-    size_t sn;
-    char*  p;
-        
-    an = a ? strlen(a) : 0;
-    sn = (size_t)(e - s);
-    p = (char*)(memory_realloc(0, an + sn + 1));
-    if (p)
+    fastObjArenaBlock* block;
+
+
+    /* Pointers from outside the arena (e.g. worker thread output) stay on the heap */
+    if (current_arena)
     {
-        if (a)
-            memcpy(p, a, an);
-        memcpy(p + an, s, sn);
-        p[an + sn] = '\0';
+        if (!ptr)
+            return arena_alloc(current_arena, bytes);
+
+        block = arena_find(current_arena, ptr);
+        if (block)
+            return arena_realloc(current_arena, block, ptr, bytes);
     }
 
-    return p;
+    return FAST_OBJ_REALLOC(ptr, bytes);
 }
 
 
 static
-int string_equal(const char* a, const char* s, const char* e)
+void memory_dealloc(void* ptr)
 {
-    size_t an = strlen(a);
-    size_t sn = (size_t)(e - s);
+    fastObjArenaBlock* block;
 
-    return an == sn && memcmp(a, s, an) == 0;
-}
 
-
-static
-void string_fix_separators(char* s)
-{
-    while (*s)
+    if (current_arena && ptr)
     {
-        if (*s == FAST_OBJ_OTHER_SEP)
-            *s = FAST_OBJ_SEPARATOR;
-        s++;
+        block = arena_find(current_arena, ptr);
+        if (block)
+        {
+            arena_dealloc(block, ptr);
+            return;
+        }
     }
+
+    FAST_OBJ_FREE(ptr);
 }
 
 
-static
-int is_whitespace(char c)
+static void* scratch_realloc(void* ptr, size_t bytes)
 {
-    return (c == ' ' || c == '\t' || c == '\r');
+    /* Temporary buffers never come from the arena */
+    return FAST_OBJ_REALLOC(ptr, bytes);
 }
 
+
 static
-int is_newline(char c)
+void scratch_dealloc(void* ptr)
 {
-    return (c == '\n');
+    FAST_OBJ_FREE(ptr);
 }
 
 
-static
-int is_digit(char c)
+#define array_clean(_arr)       ((_arr) ? memory_dealloc(_array_header(_arr)), 0 : 0)
+#define array_push(_arr, _val)  (_array_mgrow(_arr, 1) ? ((_arr)[_array_size(_arr)++] = (_val), _array_size(_arr) - 1) : 0)
+#define array_size(_arr)        ((_arr) ? _array_size(_arr) : 0)
+#define array_capacity(_arr)    ((_arr) ? _array_capacity(_arr) : 0)
+#define array_empty(_arr)       (array_size(_arr) == 0)
+#define array_reserve(_arr, _n) _array_mgrow(_arr, _n)
+
+#define _array_header(_arr)     ((fastObjUInt*)(_arr)-2)
+#define _array_size(_arr)       (_array_header(_arr)[0])
+#define _array_capacity(_arr)   (_array_header(_arr)[1])
+#define _array_ngrow(_arr, _n)  ((_arr) == 0 || (_array_size(_arr) + (_n) > _array_capacity(_arr)))
+#define _array_mgrow(_arr, _n)  (_array_ngrow(_arr, _n) ? (_array_grow(_arr, _n) != 0) : 1)
+#define _array_grow(_arr, _n)   (*((void**)&(_arr)) = array_realloc(_arr, _n, sizeof(*(_arr))))
+
+
+static void* array_realloc(void* ptr, fastObjUInt n, fastObjUInt b)
 {
-    return (c >= '0' && c <= '9');
+    fastObjUInt sz = array_size(ptr);
+    fastObjUInt nsz = sz + n;
+    fastObjUInt cap = array_capacity(ptr);
+    fastObjUInt ncap = cap + cap / 2;
+    fastObjUInt* r;
+
+    if (ncap < nsz)
+        ncap = nsz;
+    ncap = (ncap + 15) & ~15u;
+
+    r = (fastObjUInt*)(memory_realloc(ptr ? _array_header(ptr) : 0, (size_t)b * ncap + 2 * sizeof(fastObjUInt)));
+    if (!r)
+        return 0;
+
+    r[0] = sz;
+    r[1] = ncap;
+
+    return (r + 2);
 }
 
 
-static
-int is_exponent(char c)
+#if defined(FAST_OBJ_NO_THREADS)
+typedef int                     fastObjThread;
+#elif defined(_WIN32)
+typedef HANDLE                  fastObjThread;
+#else
+typedef pthread_t               fastObjThread;
+#endif
+
+typedef struct
 {
-    return (c == 'e' || c == 'E');
-}
+    void                        (*func)(void* arg);
+    void*                       arg;
 
+} fastObjTask;
 
-static
-const char* skip_name(const char* ptr)
+#if defined(FAST_OBJ_NO_THREADS)
+typedef int                     fastObjMutex;
+#define FAST_OBJ_MUTEX_INIT     0
+#elif defined(_WIN32)
+typedef SRWLOCK                 fastObjMutex;
+#define FAST_OBJ_MUTEX_INIT     SRWLOCK_INIT
+#else
+typedef pthread_mutex_t         fastObjMutex;
+#define FAST_OBJ_MUTEX_INIT     PTHREAD_MUTEX_INITIALIZER
+#endif
+
+#if defined(FAST_OBJ_NO_THREADS)
+typedef int                     fastObjCondition;
+#elif defined(_WIN32)
+typedef CONDITION_VARIABLE      fastObjCondition;
+#else
+typedef pthread_cond_t          fastObjCondition;
+#endif
+
+struct fastObjProgress
 {
-    const char* s = ptr;
+    void                        (*progress)(unsigned long long done, unsigned long long total, void* user_data);
+    int                         (*cancel)(void* user_data);
+    void*                       user_data;
 
-    while (!is_newline(*ptr))
-        ptr++;
+    /* Bytes parsed by all threads, and the total they are reported against */
+    unsigned long long          done;
+    unsigned long long          total;
 
-    while (ptr > s && is_whitespace(*(ptr - 1)))
-        ptr--;
+    /* Set once cancel returns non-zero, parsing threads stop at their next block */
+    int                         cancelled;
 
-    return ptr;
-}
+    fastObjMutex                mutex;
+
+};
 
 
+#if !defined(FAST_OBJ_NO_THREADS) && defined(_WIN32)
 static
-const char* skip_whitespace(const char* ptr)
+DWORD WINAPI task_entry(LPVOID param)
 {
-    while (is_whitespace(*ptr))
-        ptr++;
-
-    return ptr;
+    fastObjTask* task = (fastObjTask*)(param);
+    task->func(task->arg);
+    return 0;
+}
+#elif !defined(FAST_OBJ_NO_THREADS)
+static
+void* task_entry(void* param)
+{
+    fastObjTask* task = (fastObjTask*)(param);
+    task->func(task->arg);
+    return 0;
 }
+#endif
 
 
 static
-const char* skip_line(const char* ptr)
+int thread_start(fastObjThread* thread, fastObjTask* task)
 {
-    while (!is_newline(*ptr++))
-        ;
-
-    return ptr;
+#if defined(FAST_OBJ_NO_THREADS)
+    (void)(thread);
+    (void)(task);
+    return 0;
+#elif defined(_WIN32)
+    *thread = CreateThread(0, 0, task_entry, task, 0, 0);
+    return *thread != 0;
+#else
+    return pthread_create(thread, 0, task_entry, task) == 0;
+#endif
 }
 
 
 static
-fastObjGroup object_default(void)
+void thread_join(fastObjThread* thread)
 {
-    fastObjGroup object;
+#if defined(FAST_OBJ_NO_THREADS)
+    (void)(thread);
+#elif defined(_WIN32)
+    WaitForSingleObject(*thread, INFINITE);
+    CloseHandle(*thread);
+#else
+    pthread_join(*thread, 0);
+#endif
+}
 
-    object.name         = 0;
-    object.face_count   = 0;
-    object.face_offset  = 0;
-    object.index_offset = 0;
 
-    return object;
+static
+void mutex_lock(fastObjMutex* mutex)
+{
+#if defined(FAST_OBJ_NO_THREADS)
+    (void)(mutex);
+#elif defined(_WIN32)
+    AcquireSRWLockExclusive(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
 }
 
 
 static
-void object_clean(fastObjGroup* object)
+void mutex_unlock(fastObjMutex* mutex)
 {
-    memory_dealloc(object->name);
+#if defined(FAST_OBJ_NO_THREADS)
+    (void)(mutex);
+#elif defined(_WIN32)
+    ReleaseSRWLockExclusive(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
 }
 
 
 static
-void flush_object(fastObjData* data)
+void mutex_init(fastObjMutex* mutex)
 {
-    /* Add object if not empty */
-    if (data->object.face_count > 0)
-        array_push(data->mesh->objects, data->object);
-    else
-        object_clean(&data->object);
-
-    /* Reset for more data */
-    data->object = object_default();
-    data->object.face_offset  = array_size(data->mesh->face_vertices);
-    data->object.index_offset = array_size(data->mesh->indices);
+#if defined(FAST_OBJ_NO_THREADS)
+    *mutex = 0;
+#elif defined(_WIN32)
+    InitializeSRWLock(mutex);
+#else
+    pthread_mutex_init(mutex, 0);
+#endif
 }
 
 
+static
+void mutex_destroy(fastObjMutex* mutex)
+{
+#if defined(FAST_OBJ_NO_THREADS) || defined(_WIN32)
+    (void)(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
 
 static
-fastObjGroup group_default(void)
+void condition_init(fastObjCondition* condition)
 {
-    fastObjGroup group;
+#if defined(FAST_OBJ_NO_THREADS)
+    *condition = 0;
+#elif defined(_WIN32)
+    InitializeConditionVariable(condition);
+#else
+    pthread_cond_init(condition, 0);
+#endif
+}
 
-    group.name         = 0;
-    group.face_count   = 0;
-    group.face_offset  = 0;
-    group.index_offset = 0;
 
-    return group;
+static
+void condition_destroy(fastObjCondition* condition)
+{
+#if defined(FAST_OBJ_NO_THREADS) || defined(_WIN32)
+    (void)(condition);
+#else
+    pthread_cond_destroy(condition);
+#endif
 }
 
 
 static
-void group_clean(fastObjGroup* group)
+void condition_wait(fastObjCondition* condition, fastObjMutex* mutex)
 {
-    memory_dealloc(group->name);
+#if defined(FAST_OBJ_NO_THREADS)
+    (void)(condition);
+    (void)(mutex);
+#elif defined(_WIN32)
+    SleepConditionVariableSRW(condition, mutex, INFINITE, 0);
+#else
+    pthread_cond_wait(condition, mutex);
+#endif
 }
 
 
 static
-void flush_group(fastObjData* data)
+void condition_broadcast(fastObjCondition* condition)
 {
-    /* Add group if not empty */
-    if (data->group.face_count > 0)
-        array_push(data->mesh->groups, data->group);
-    else
-        group_clean(&data->group);
+#if defined(FAST_OBJ_NO_THREADS)
+    (void)(condition);
+#elif defined(_WIN32)
+    WakeAllConditionVariable(condition);
+#else
+    pthread_cond_broadcast(condition);
+#endif
+}
 
-    /* Reset for more data */
-    data->group = group_default();
-    data->group.face_offset  = array_size(data->mesh->face_vertices);
-    data->group.index_offset = array_size(data->mesh->indices);
+
+static
+unsigned int thread_count_default(void)
+{
+#if defined(FAST_OBJ_NO_THREADS)
+    return 1;
+#elif defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (unsigned int)(info.dwNumberOfProcessors);
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned int)(n) : 1;
+#else
+    return 1;
+#endif
 }
 
 
 static
-const char* parse_int(const char* ptr, int* val)
+void run_tasks(void (*func)(void*), void* args, size_t stride, unsigned int count)
 {
-    int sign;
-    int num;
+    fastObjTask   tasks[MAX_THREADS];
+    fastObjThread threads[MAX_THREADS];
+    int           started[MAX_THREADS];
+    unsigned int  ii;
 
 
-    if (*ptr == '-')
+    /* Task 0 runs on the calling thread, tasks that fail to start run there too */
+    for (ii = 1; ii < count; ii++)
     {
-        sign = -1;
-        ptr++;
+        tasks[ii].func = func;
+        tasks[ii].arg  = (char*)(args) + ii * stride;
+        started[ii]    = thread_start(&threads[ii], &tasks[ii]);
     }
-    else
+
+    if (count > 0)
+        func(args);
+
+    for (ii = 1; ii < count; ii++)
     {
-        sign = +1;
+        if (started[ii])
+            thread_join(&threads[ii]);
+        else
+            func(tasks[ii].arg);
     }
+}
 
-    num = 0;
-    while (is_digit(*ptr))
-        num = 10 * num + (*ptr++ - '0');
 
-    *val = sign * num;
+static
+void* file_open(const char* path, void* user_data)
+{
+    (void)(user_data);
+    return fopen(path, "rb");
+}
 
-    return ptr;
+
+static
+void file_close(void* file, void* user_data)
+{
+    FILE* f;
+    (void)(user_data);
+    
+    f = (FILE*)(file);
+    fclose(f);
 }
 
 
 static
-const char* parse_float(const char* ptr, float* val)
+size_t file_read(void* file, void* dst, size_t bytes, void* user_data)
 {
-    double        sign;
-    double        num;
-    double        fra;
-    double        div;
-    unsigned int  eval;
-    const double* powers;
+    FILE* f;
+    (void)(user_data);
+    
+    f = (FILE*)(file);
+    return fread(dst, 1, bytes, f);
+}
 
 
-    ptr = skip_whitespace(ptr);
+static
+unsigned long file_size(void* file, void* user_data)
+{
+    FILE* f;
+    long p;
+    long n;
+    (void)(user_data);
 
-    switch (*ptr)
-    {
-    case '+':
-        sign = 1.0;
-        ptr++;
-        break;
+    f = (FILE*)(file);
 
-    case '-':
-        sign = -1.0;
-        ptr++;
-        break;
+    p = ftell(f);
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, p, SEEK_SET);
 
-    default:
-        sign = 1.0;
-        break;
-    }
+    if (n > 0)
+        return (unsigned long)(n);
+    else
+        return 0;
+}
 
 
-    num = 0.0;
-    while (is_digit(*ptr))
-        num = 10.0 * num + (double)(*ptr++ - '0');
+static
+int file_map(fastObjMapping* map, const char* path, int copy)
+{
+    /* Copy mappings can be written to, changed pages are private to the process */
+#ifdef _WIN32
+    LARGE_INTEGER size;
 
-    if (*ptr == '.')
-        ptr++;
 
-    fra = 0.0;
-    div = 1.0;
+    map->data    = 0;
+    map->size    = 0;
+    map->mapping = 0;
 
-    while (is_digit(*ptr))
+    map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (map->file == INVALID_HANDLE_VALUE)
+        return 0;
+
+    if (!GetFileSizeEx(map->file, &size) || (LONGLONG)((SIZE_T)(size.QuadPart)) != size.QuadPart)
     {
-        fra  = 10.0 * fra + (double)(*ptr++ - '0');
-        div *= 10.0;
+        CloseHandle(map->file);
+        return 0;
     }
 
-    num += fra / div;
+    /* Empty files can't be mapped, but are still valid */
+    map->size = (size_t)(size.QuadPart);
+    if (map->size == 0)
+        return 1;
 
-    if (is_exponent(*ptr))
+    map->mapping = CreateFileMappingA(map->file, 0, copy ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, 0);
+    if (map->mapping)
+        map->data = (const char*)(MapViewOfFile(map->mapping, copy ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+
+    if (!map->data)
     {
-        ptr++;
+        if (map->mapping)
+            CloseHandle(map->mapping);
+        CloseHandle(map->file);
+        return 0;
+    }
 
-        switch (*ptr)
-        {
-        case '+':
-            powers = POWER_10_POS;
-            ptr++;
-            break;
+    return 1;
+#else
+    struct stat st;
+    void*       p;
+    int         fd;
 
-        case '-':
-            powers = POWER_10_NEG;
-            ptr++;
-            break;
 
-        default:
-            powers = POWER_10_POS;
-            break;
-        }
+    map->data = 0;
+    map->size = 0;
 
-        eval = 0;
-        while (is_digit(*ptr))
-            eval = 10 * eval + (*ptr++ - '0');
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (off_t)((size_t)(st.st_size)) != st.st_size)
+    {
+        close(fd);
+        return 0;
+    }
 
-        num *= (eval >= MAX_POWER) ? 0.0 : powers[eval];
+    /* Empty files can't be mapped, but are still valid */
+    map->size = (size_t)(st.st_size);
+    if (map->size == 0)
+    {
+        close(fd);
+        return 1;
     }
 
-    *val = (float)(sign * num);
+    /* The mapping stays valid after the descriptor is closed */
+    p = mmap(0, map->size, copy ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
 
-    return ptr;
+    if (p == MAP_FAILED)
+        return 0;
+
+#ifdef MADV_SEQUENTIAL
+    if (!copy)
+        madvise(p, map->size, MADV_SEQUENTIAL);
+#endif
+
+    map->data = (const char*)(p);
+
+    return 1;
+#endif
 }
 
 
 static
-const char* parse_vertex(fastObjData* data, const char* ptr)
+void file_unmap(fastObjMapping* map)
 {
-    unsigned int ii;
-    float        v;
+#ifdef _WIN32
+    if (map->data)
+        UnmapViewOfFile(map->data);
+    if (map->mapping)
+        CloseHandle(map->mapping);
+    CloseHandle(map->file);
+#else
+    if (map->data)
+        munmap((void*)(map->data), map->size);
+#endif
+}
 
 
-    for (ii = 0; ii < 3; ii++)
-    {
-        ptr = parse_float(ptr, &v);
-        array_push(data->mesh->positions, v);
-    }
+static
+int file_stat(const char* path, uint64_t* size, int64_t* time)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
 
 
-    ptr = skip_whitespace(ptr);
-    if (!is_newline(*ptr))
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info))
+        return 0;
+
+    *size = ((uint64_t)(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    *time = (int64_t)(((uint64_t)(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime);
+
+    return 1;
+#else
+    struct stat st;
+
+
+    if (stat(path, &st) != 0)
+        return 0;
+
+    *size = (uint64_t)(st.st_size);
+
+    /* Nanoseconds where the platform has them (st_mtime is then a macro for the seconds) */
+#if defined(__APPLE__)
+    *time = (int64_t)(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#elif defined(st_mtime)
+    *time = (int64_t)(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+    *time = (int64_t)(st.st_mtime);
+#endif
+
+    return 1;
+#endif
+}
+
+
+typedef struct
+{
+    /* (length << GZIP_FAST_BITS) | symbol for codes of up to GZIP_FAST_BITS,
+       indexed by the next bits of input, 0 for longer codes */
+    uint16_t                    fast[1 << GZIP_FAST_BITS];
+
+    /* Canonical code tables for the longer codes, max_code is shifted up to 16 bits */
+    uint16_t                    first_code[16];
+    uint16_t                    first_symbol[16];
+    uint32_t                    max_code[17];
+    uint8_t                     size[288];
+    uint16_t                    value[288];
+
+} fastObjHuffman;
+
+typedef struct
+{
+    FILE*                       file;
+
+    /* Non-zero when the file starts with the gzip magic, otherwise reads
+       return the file as it is */
+    int                         compressed;
+
+    /* Inflated size from the last gzip trailer, which is only a hint: it is
+       the size of the last member alone and is taken modulo 2^32 */
+    unsigned long               size;
+
+    /* Compressed input, the first block is read when the file is opened */
+    unsigned char               input[GZIP_INPUT_SIZE];
+    size_t                      input_position;
+    size_t                      input_size;
+
+    /* Bit buffer, and the number of bytes past the end of input put in it */
+    uint64_t                    bits;
+    unsigned int                bit_count;
+    unsigned int                overrun;
+
+    fastObjHuffman              length;
+    fastObjHuffman              distance;
+    fastObjHuffman              lengths;
+
+    /* Inflated output.  The decoder writes at produced and never gets more
+       than the ring size ahead of consumed.  available is the part of the
+       output the decoder has handed over to the reader */
+    unsigned char*              ring;
+    size_t                      ring_size;
+    uint64_t                    produced;
+    uint64_t                    limit;
+    uint64_t                    available;
+    uint64_t                    consumed;
+
+    /* CRC-32 of the current member, over the output up to crc_position */
+    uint32_t                    crc;
+    uint64_t                    crc_position;
+    uint32_t                    crc_table[8][256];
+
+    /* Set by the decoder when it is done, failed also when the data was bad */
+    int                         finished;
+    int                         failed;
+
+    /* Set by the reader to stop the decoder early */
+    int                         stop;
+
+    /* Non-zero when the decoder runs on the thread opening the file and the
+       ring grows to hold the whole file instead */
+    int                         grow;
+
+    fastObjMutex                mutex;
+    fastObjCondition            condition;
+    fastObjThread               thread;
+    fastObjTask                 task;
+
+} fastObjGzip;
+
+
+static const uint16_t gzip_length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t gzip_length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t gzip_distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t gzip_distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static const uint8_t gzip_length_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+
+static
+int gzip_magic(const void* data, size_t size)
+{
+    const unsigned char* p = (const unsigned char*)(data);
+
+    return size >= 2 && p[0] == 0x1f && p[1] == 0x8b;
+}
+
+
+static
+void gzip_fill(fastObjGzip* gzip)
+{
+    unsigned int c;
+
+
+    /* Past the end of input the buffer is topped up with zeros, which only
+       a damaged stream gets as far as decoding */
+    while (gzip->bit_count <= 56)
     {
-        /* Fill the colors array until it matches the size of the positions array */
-        for (ii = array_size(data->mesh->colors); ii < array_size(data->mesh->positions) - 3; ++ii)
+        if (gzip->input_position == gzip->input_size)
         {
-            array_push(data->mesh->colors, 1.0f);
+            gzip->input_position = 0;
+            gzip->input_size     = fread(gzip->input, 1, GZIP_INPUT_SIZE, gzip->file);
         }
 
-        for (ii = 0; ii < 3; ++ii)
+        if (gzip->input_position < gzip->input_size)
         {
-            ptr = parse_float(ptr, &v);
-            array_push(data->mesh->colors, v);
+            c = gzip->input[gzip->input_position++];
+        }
+        else
+        {
+            c = 0;
+            if (++gzip->overrun > 16)
+                gzip->failed = 1;
         }
-    }
 
-    return ptr;
+        gzip->bits      |= (uint64_t)(c) << gzip->bit_count;
+        gzip->bit_count += 8;
+    }
 }
 
 
 static
-const char* parse_texcoord(fastObjData* data, const char* ptr)
+uint32_t gzip_bits(fastObjGzip* gzip, unsigned int n)
 {
-    unsigned int ii;
-    float        v;
+    uint32_t v;
 
 
-    for (ii = 0; ii < 2; ii++)
-    {
-        ptr = parse_float(ptr, &v);
-        array_push(data->mesh->texcoords, v);
-    }
+    if (gzip->bit_count < n)
+        gzip_fill(gzip);
 
-    return ptr;
+    v = (uint32_t)(gzip->bits & (((uint64_t)(1) << n) - 1));
+
+    gzip->bits      >>= n;
+    gzip->bit_count  -= n;
+
+    return v;
 }
 
 
 static
-const char* parse_normal(fastObjData* data, const char* ptr)
+int gzip_at_end(fastObjGzip* gzip)
+{
+    /* Bytes in the bit buffer that came from the file */
+    gzip_fill(gzip);
+    return gzip->bit_count / 8 <= gzip->overrun;
+}
+
+
+static
+unsigned int bit_reverse(unsigned int v, unsigned int n)
 {
+    unsigned int r;
     unsigned int ii;
-    float        v;
 
 
-    for (ii = 0; ii < 3; ii++)
+    r = 0;
+    for (ii = 0; ii < n; ii++)
     {
-        ptr = parse_float(ptr, &v);
-        array_push(data->mesh->normals, v);
+        r = (r << 1) | (v & 1);
+        v >>= 1;
     }
 
-    return ptr;
+    return r;
 }
 
 
 static
-const char* parse_face(fastObjData* data, const char* ptr, unsigned char line)
+int huffman_build(fastObjHuffman* huffman, const uint8_t* sizes, unsigned int count)
 {
-    unsigned int count;
-    fastObjIndex vn;
-    int          v;
-    int          t;
-    int          n;
-
+    unsigned int counts[17];
+    unsigned int next_code[16];
+    unsigned int code;
+    unsigned int symbol;
+    unsigned int ii;
+    unsigned int jj;
+    unsigned int s;
 
-    ptr = skip_whitespace(ptr);
 
-    count = 0;
-    while (!is_newline(*ptr))
-    {
-        v = 0;
-        t = 0;
-        n = 0;
+    memset(counts, 0, sizeof(counts));
+    memset(huffman->fast, 0, sizeof(huffman->fast));
 
-        ptr = parse_int(ptr, &v);
-        if (*ptr == '/')
-        {
-            ptr++;
-            if (*ptr != '/')
-                ptr = parse_int(ptr, &t);
+    for (ii = 0; ii < count; ii++)
+        counts[sizes[ii]]++;
 
-            if (*ptr == '/')
-            {
-                ptr++;
-                ptr = parse_int(ptr, &n);
-            }
-        }
+    counts[0] = 0;
+    for (ii = 1; ii < 16; ii++)
+        if (counts[ii] > (1u << ii))
+            return 0;
 
-        if (v < 0)
-            vn.p = (array_size(data->mesh->positions) / 3) - (fastObjUInt)(-v);
-        else if (v > 0)
-            vn.p = (fastObjUInt)(v);
-        else
-            return ptr; /* Skip lines with no valid vertex index */
 
-        if (t < 0)
-            vn.t = (array_size(data->mesh->texcoords) / 2) - (fastObjUInt)(-t);
-        else if (t > 0)
-            vn.t = (fastObjUInt)(t);
-        else
-            vn.t = 0;
+    /* Canonical codes: each length starts after the codes of shorter lengths */
+    code   = 0;
+    symbol = 0;
+    for (ii = 1; ii < 16; ii++)
+    {
+        next_code[ii]             = code;
+        huffman->first_code[ii]   = (uint16_t)(code);
+        huffman->first_symbol[ii] = (uint16_t)(symbol);
 
-        if (n < 0)
-            vn.n = (array_size(data->mesh->normals) / 3) - (fastObjUInt)(-n);
-        else if (n > 0)
-            vn.n = (fastObjUInt)(n);
-        else
-            vn.n = 0;
+        code += counts[ii];
+        if (counts[ii] && code - 1 >= (1u << ii))
+            return 0;
 
-        array_push(data->mesh->indices, vn);
-        count++;
+        huffman->max_code[ii] = code << (16 - ii);
 
-        ptr = skip_whitespace(ptr);
+        code   <<= 1;
+        symbol  += counts[ii];
     }
 
-    array_push(data->mesh->face_vertices, count);
-    array_push(data->mesh->face_materials, data->material);
+    huffman->max_code[16] = 0x10000;
 
-    if (line || data->mesh->face_lines)
+    for (ii = 0; ii < count; ii++)
     {
-        /* when line info exists, ensure it uses aligned indexing with other face data */
-        size_t skipped = array_size(data->mesh->face_vertices) - array_size(data->mesh->face_lines);
-        while (--skipped > 0)
-            array_push(data->mesh->face_lines, 0);
+        s = sizes[ii];
+        if (s == 0)
+            continue;
 
-        array_push(data->mesh->face_lines, line);
-    }
+        symbol = next_code[s] - huffman->first_code[s] + huffman->first_symbol[s];
 
-    data->group.face_count++;
-    data->object.face_count++;
+        huffman->size[symbol]  = (uint8_t)(s);
+        huffman->value[symbol] = (uint16_t)(ii);
 
-    return ptr;
+        /* Deflate sends codes starting from the top bit */
+        if (s <= GZIP_FAST_BITS)
+            for (jj = bit_reverse(next_code[s], s); jj < (1u << GZIP_FAST_BITS); jj += 1u << s)
+                huffman->fast[jj] = (uint16_t)((s << GZIP_FAST_BITS) | ii);
+
+        next_code[s]++;
+    }
+
+    return 1;
 }
 
 
 static
-const char* parse_object(fastObjData* data, const char* ptr)
+int huffman_decode(fastObjGzip* gzip, const fastObjHuffman* huffman)
 {
-    const char* s;
-    const char* e;
+    unsigned int b;
+    unsigned int k;
+    unsigned int s;
 
 
-    ptr = skip_whitespace(ptr);
+    if (gzip->bit_count < 16)
+        gzip_fill(gzip);
 
-    s = ptr;
-    ptr = skip_name(ptr);
-    e = ptr;
+    b = huffman->fast[gzip->bits & ((1 << GZIP_FAST_BITS) - 1)];
+    if (b)
+    {
+        s = b >> GZIP_FAST_BITS;
+        gzip->bits      >>= s;
+        gzip->bit_count  -= s;
+        return (int)(b & ((1 << GZIP_FAST_BITS) - 1));
+    }
 
-    flush_object(data);
-    data->object.name = string_copy(s, e);
 
-    return ptr;
+    /* Longer codes are compared against the last code of each length */
+    k = bit_reverse((unsigned int)(gzip->bits & 0xffff), 16);
+    for (s = GZIP_FAST_BITS + 1; k >= huffman->max_code[s]; s++)
+        ;
+
+    if (s >= 16)
+        return -1;
+
+    b = (k >> (16 - s)) - huffman->first_code[s] + huffman->first_symbol[s];
+    if (b >= 288 || huffman->size[b] != s)
+        return -1;
+
+    gzip->bits      >>= s;
+    gzip->bit_count  -= s;
+
+    return huffman->value[b];
 }
 
 
 static
-const char* parse_group(fastObjData* data, const char* ptr)
+void gzip_publish(fastObjGzip* gzip)
 {
-    const char* s;
-    const char* e;
+    mutex_lock(&gzip->mutex);
+    gzip->available = gzip->produced;
+    condition_broadcast(&gzip->condition);
+    mutex_unlock(&gzip->mutex);
+}
 
 
-    ptr = skip_whitespace(ptr);
+static
+void gzip_crc_table(fastObjGzip* gzip)
+{
+    uint32_t c;
+    int      i;
+    int      j;
 
-    s = ptr;
-    ptr = skip_name(ptr);
-    e = ptr;
 
-    flush_group(data);
-    data->group.name = string_copy(s, e);
+    for (i = 0; i < 256; i++)
+    {
+        c = (uint32_t)(i);
+        for (j = 0; j < 8; j++)
+            c = (c >> 1) ^ ((c & 1) ? 0xedb88320u : 0);
 
-    return ptr;
+        gzip->crc_table[0][i] = c;
+    }
+
+    /* Tables for eight bytes at a time */
+    for (i = 0; i < 256; i++)
+        for (j = 1; j < 8; j++)
+            gzip->crc_table[j][i] = (gzip->crc_table[j - 1][i] >> 8) ^ gzip->crc_table[0][gzip->crc_table[j - 1][i] & 0xff];
 }
 
 
 static
-fastObjTexture map_default(void)
+uint32_t gzip_crc_update(fastObjGzip* gzip, uint32_t crc, const unsigned char* p, size_t n)
 {
-    fastObjTexture map;
+    uint32_t (*t)[256] = gzip->crc_table;
+    uint32_t c;
 
-    map.name = 0;
-    map.path = 0;
 
-    return map;
+    c = ~crc;
+
+    while (n >= 8)
+    {
+        c ^= (uint32_t)(p[0]) | ((uint32_t)(p[1]) << 8) | ((uint32_t)(p[2]) << 16) | ((uint32_t)(p[3]) << 24);
+        c  = t[7][c & 0xff] ^ t[6][(c >> 8) & 0xff] ^ t[5][(c >> 16) & 0xff] ^ t[4][c >> 24] ^
+             t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+
+        p += 8;
+        n -= 8;
+    }
+
+    while (n--)
+        c = t[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+
+    return ~c;
 }
 
 
 static
-fastObjMaterial mtl_default(void)
+void gzip_crc(fastObjGzip* gzip)
 {
-    fastObjMaterial mtl;
-
-    mtl.name = 0;
-
-    mtl.Ka[0] = 0.0;
-    mtl.Ka[1] = 0.0;
-    mtl.Ka[2] = 0.0;
-    mtl.Kd[0] = 1.0;
-    mtl.Kd[1] = 1.0;
-    mtl.Kd[2] = 1.0;
-    mtl.Ks[0] = 0.0;
-    mtl.Ks[1] = 0.0;
-    mtl.Ks[2] = 0.0;
-    mtl.Ke[0] = 0.0;
-    mtl.Ke[1] = 0.0;
-    mtl.Ke[2] = 0.0;
-    mtl.Kt[0] = 0.0;
-    mtl.Kt[1] = 0.0;
-    mtl.Kt[2] = 0.0;
-    mtl.Ns    = 1.0;
-    mtl.Ni    = 1.0;
-    mtl.Tf[0] = 1.0;
-    mtl.Tf[1] = 1.0;
-    mtl.Tf[2] = 1.0;
-    mtl.d     = 1.0;
-    mtl.illum = 1;
+    size_t offset;
+    size_t n;
 
-    mtl.fallback = 0;
 
-    mtl.map_Ka   = 0;
-    mtl.map_Kd   = 0;
-    mtl.map_Ks   = 0;
-    mtl.map_Ke   = 0;
-    mtl.map_Kt   = 0;
-    mtl.map_Ns   = 0;
-    mtl.map_Ni   = 0;
-    mtl.map_d    = 0;
-    mtl.map_bump = 0;
+    /* Checksum the new output while it is still in the ring */
+    while (gzip->crc_position < gzip->produced)
+    {
+        offset = (size_t)(gzip->crc_position & (gzip->ring_size - 1));
+        n      = gzip->ring_size - offset;
+        if (n > gzip->produced - gzip->crc_position)
+            n = (size_t)(gzip->produced - gzip->crc_position);
 
-    return mtl;
+        gzip->crc           = gzip_crc_update(gzip, gzip->crc, gzip->ring + offset, n);
+        gzip->crc_position += n;
+    }
 }
 
 
 static
-const char* parse_usemtl(fastObjData* data, const char* ptr)
+int gzip_reserve(fastObjGzip* gzip, size_t n)
 {
-    const char*      s;
-    const char*      e;
-    unsigned int     idx;
-    fastObjMaterial* mtl;
+    unsigned char* ring;
 
 
-    ptr = skip_whitespace(ptr);
+    if (gzip->produced + n <= gzip->limit)
+        return 1;
 
-    /* Parse the material name */
-    s = ptr;
-    ptr = skip_name(ptr);
-    e = ptr;
+    /* Output past crc_position is not overwritten before the next time
+       the limit moves, which is always through here */
+    gzip_crc(gzip);
 
-    /* Find an existing material with the same name */
-    idx = 0;
-    while (idx < array_size(data->mesh->materials))
+    /* Without a thread to read it, the whole output is kept */
+    if (gzip->grow)
     {
-        mtl = &data->mesh->materials[idx];
-        if (mtl->name && string_equal(mtl->name, s, e))
-            break;
+        while (gzip->produced + n > gzip->ring_size)
+        {
+            ring = (unsigned char*)(scratch_realloc(gzip->ring, gzip->ring_size * 2));
+            if (!ring)
+                return 0;
 
-        idx++;
-    }
+            gzip->ring       = ring;
+            gzip->ring_size *= 2;
+        }
 
-    /* If doesn't exist, create a default one with this name
-       Note: this case happens when OBJ doesn't have its MTL */
-    if (idx == array_size(data->mesh->materials))
-    {
-        fastObjMaterial new_mtl = mtl_default();
-        new_mtl.name = string_copy(s, e);
-        new_mtl.fallback = 1;
-        array_push(data->mesh->materials, new_mtl);
+        gzip->limit = gzip->ring_size;
+        return 1;
     }
 
-    data->material = idx;
 
-    return ptr;
-}
+    /* Hand over what is there and wait for the reader to make room */
+    mutex_lock(&gzip->mutex);
 
+    gzip->available = gzip->produced;
+    condition_broadcast(&gzip->condition);
 
-static
-void map_clean(fastObjTexture* map)
-{
-    memory_dealloc(map->name);
-    memory_dealloc(map->path);
-}
+    while (!gzip->stop && gzip->consumed + gzip->ring_size < gzip->produced + n)
+        condition_wait(&gzip->condition, &gzip->mutex);
 
+    gzip->limit = gzip->consumed + gzip->ring_size;
 
-static
-void mtl_clean(fastObjMaterial* mtl)
-{
-    memory_dealloc(mtl->name);
+    mutex_unlock(&gzip->mutex);
+
+    return !gzip->stop;
 }
 
 
 static
-const char* read_mtl_int(const char* p, int* v)
+int gzip_tables(fastObjGzip* gzip, int dynamic)
 {
-    return parse_int(p, v);
-}
+    uint8_t      sizes[288 + 32];
+    uint8_t      fill;
+    unsigned int literal_count;
+    unsigned int distance_count;
+    unsigned int length_count;
+    unsigned int ii;
+    unsigned int n;
+    int          c;
 
 
-static
-const char* read_mtl_single(const char* p, float* v)
-{
-    return parse_float(p, v);
-}
+    if (!dynamic)
+    {
+        /* Fixed codes from the deflate specification */
+        for (ii = 0; ii < 144; ii++)
+            sizes[ii] = 8;
+        for (; ii < 256; ii++)
+            sizes[ii] = 9;
+        for (; ii < 280; ii++)
+            sizes[ii] = 7;
+        for (; ii < 288; ii++)
+            sizes[ii] = 8;
+        for (ii = 0; ii < 32; ii++)
+            sizes[288 + ii] = 5;
+
+        return huffman_build(&gzip->length, sizes, 288) &&
+               huffman_build(&gzip->distance, sizes + 288, 32);
+    }
 
+    literal_count  = gzip_bits(gzip, 5) + 257;
+    distance_count = gzip_bits(gzip, 5) + 1;
+    length_count   = gzip_bits(gzip, 4) + 4;
 
-static
-const char* read_mtl_triple(const char* p, float v[3])
-{
-    p = read_mtl_single(p, &v[0]);
-    p = read_mtl_single(p, &v[1]);
-    p = read_mtl_single(p, &v[2]);
 
-    return p;
+    /* Code lengths are themselves Huffman coded */
+    memset(sizes, 0, 19);
+    for (ii = 0; ii < length_count; ii++)
+        sizes[gzip_length_order[ii]] = (uint8_t)(gzip_bits(gzip, 3));
+
+    if (!huffman_build(&gzip->lengths, sizes, 19))
+        return 0;
+
+    n = 0;
+    while (n < literal_count + distance_count)
+    {
+        c = huffman_decode(gzip, &gzip->lengths);
+        if (c < 0 || c > 18)
+            return 0;
+
+        if (c < 16)
+        {
+            sizes[n++] = (uint8_t)(c);
+            continue;
+        }
+
+        /* Runs of the previous length or of zeros */
+        fill = 0;
+        if (c == 16)
+        {
+            if (n == 0)
+                return 0;
+
+            fill = sizes[n - 1];
+            c    = (int)(gzip_bits(gzip, 2)) + 3;
+        }
+        else if (c == 17)
+        {
+            c = (int)(gzip_bits(gzip, 3)) + 3;
+        }
+        else
+        {
+            c = (int)(gzip_bits(gzip, 7)) + 11;
+        }
+
+        if ((unsigned int)(c) > literal_count + distance_count - n)
+            return 0;
+
+        memset(sizes + n, fill, (size_t)(c));
+        n += (unsigned int)(c);
+    }
+
+    return huffman_build(&gzip->length, sizes, literal_count) &&
+           huffman_build(&gzip->distance, sizes + literal_count, distance_count);
 }
 
 
 static
-const char* read_map(fastObjData* data, const char* ptr, unsigned int* idx)
+int gzip_block(fastObjGzip* gzip)
 {
-    const char*     s;
-    const char*     e;
-    fastObjTexture* map;
+    unsigned char* ring = gzip->ring;
+    uint64_t       mask = gzip->ring_size - 1;
+    uint64_t       p;
+    unsigned int   length;
+    unsigned int   distance;
+    int            c;
 
 
-    ptr = skip_whitespace(ptr);
+    for (;;)
+    {
+        /* Room for the longest match, and the ring may have grown */
+        if (!gzip_reserve(gzip, 258))
+            return 0;
 
-    /* Don't support options at present */
-    if (*ptr == '-')
-        return ptr;
+        ring = gzip->ring;
+        mask = gzip->ring_size - 1;
 
+        if (gzip->produced - gzip->available >= GZIP_PUBLISH_SIZE && !gzip->grow)
+            gzip_publish(gzip);
 
-    /* Read name */
-    s = ptr;
-    ptr = skip_name(ptr);
-    e = ptr;
+        c = huffman_decode(gzip, &gzip->length);
+        if (c < 0 || gzip->failed)
+            return 0;
 
-    /* Try to find an existing texture map with the same name */
-    *idx = 1; /* skip dummy at index 0 */
-    while (*idx < array_size(data->mesh->textures))
-    {
-        map = &data->mesh->textures[*idx];
-        if (map->name && string_equal(map->name, s, e))
-            break;
+        if (c < 256)
+        {
+            ring[gzip->produced++ & mask] = (unsigned char)(c);
+            continue;
+        }
 
-        (*idx)++;
-    }
+        if (c == 256)
+            return 1;
 
-    /* Add it to the texture array if it didn't already exist */
-    if (*idx == array_size(data->mesh->textures))
-    {
-        fastObjTexture new_map = map_default();
-        new_map.name = string_copy(s, e);
-        new_map.path = string_concat(data->base, s, e);
-        string_fix_separators(new_map.path);
-        array_push(data->mesh->textures, new_map);
-    }
+        c -= 257;
+        if (c >= 29)
+            return 0;
 
-    return e;
+        length = gzip_length_base[c] + gzip_bits(gzip, gzip_length_extra[c]);
+
+        c = huffman_decode(gzip, &gzip->distance);
+        if (c < 0 || c >= 30)
+            return 0;
+
+        distance = gzip_distance_base[c] + gzip_bits(gzip, gzip_distance_extra[c]);
+        if (distance > gzip->produced)
+            return 0;
+
+
+        /* Matches may overlap their own output, so copy forwards a byte at a time */
+        p = gzip->produced;
+        while (length--)
+        {
+            ring[p & mask] = ring[(p - distance) & mask];
+            p++;
+        }
+
+        gzip->produced = p;
+    }
 }
 
 
 static
-int read_mtllib(fastObjData* data, void* file, const fastObjCallbacks* callbacks, void* user_data)
+int gzip_member(fastObjGzip* gzip)
 {
-    unsigned long   n;
-    const char*     s;
-    char*           contents;
-    size_t          l;
-    const char*     p;
-    const char*     e;
-    int             found_d;
-    fastObjMaterial mtl;
-
+    uint64_t     start;
+    unsigned int flags;
+    unsigned int length;
+    unsigned int final;
+    unsigned int type;
+    uint32_t     crc;
+    uint32_t     size;
 
-    /* Read entire file */
-    n = callbacks->file_size(file, user_data);
 
-    contents = (char*)(memory_realloc(0, n + 1));
-    if (!contents)
+    /* Header: magic, method 8 (deflate), flags, time, extra flags and system */
+    if (gzip_bits(gzip, 8) != 0x1f || gzip_bits(gzip, 8) != 0x8b || gzip_bits(gzip, 8) != 8)
         return 0;
 
-    l = callbacks->file_read(file, contents, n, user_data);
-    contents[l] = '\n';
+    flags = gzip_bits(gzip, 8);
+    gzip_bits(gzip, 32);
+    gzip_bits(gzip, 16);
 
-    mtl = mtl_default();
+    if (flags & 4)
+    {
+        length = gzip_bits(gzip, 16);
+        while (length-- && !gzip->failed)
+            gzip_bits(gzip, 8);
+    }
 
-    found_d = 0;
+    if (flags & 8)
+        while (gzip_bits(gzip, 8) != 0 && !gzip->failed)
+            ;
 
-    p = contents;
-    e = contents + l;
-    while (p < e)
+    if (flags & 16)
+        while (gzip_bits(gzip, 8) != 0 && !gzip->failed)
+            ;
+
+    if (flags & 2)
+        gzip_bits(gzip, 16);
+
+
+    start              = gzip->produced;
+    gzip->crc          = 0;
+    gzip->crc_position = start;
+    do
     {
-        p = skip_whitespace(p);
+        final = gzip_bits(gzip, 1);
+        type  = gzip_bits(gzip, 2);
 
-        switch (*p)
+        if (type == 0)
         {
-        case 'n':
-            p++;
-            if (p[0] == 'e' &&
-                p[1] == 'w' &&
-                p[2] == 'm' &&
-                p[3] == 't' &&
-                p[4] == 'l' &&
-                is_whitespace(p[5]))
+            /* Stored block, from the next byte boundary */
+            gzip_bits(gzip, gzip->bit_count & 7);
+
+            length = gzip_bits(gzip, 16);
+            if ((length ^ 0xffff) != gzip_bits(gzip, 16))
+                return 0;
+
+            while (length--)
             {
-                /* Push previous material (if there is one) */
-                if (mtl.name)
-                {
-                    array_push(data->mesh->materials, mtl);
-                    mtl = mtl_default();
-                }
+                if (!gzip_reserve(gzip, 1))
+                    return 0;
 
+                gzip->ring[gzip->produced & (gzip->ring_size - 1)] = (unsigned char)(gzip_bits(gzip, 8));
+                gzip->produced++;
+            }
+        }
+        else if (type == 3 || !gzip_tables(gzip, type == 2) || !gzip_block(gzip))
+        {
+            return 0;
+        }
 
-                /* Read name */
-                p += 5;
+        if (gzip->failed || gzip->bit_count < 8 * gzip->overrun)
+            return 0;
+    }
+    while (!final);
 
-                while (is_whitespace(*p))
-                    p++;
 
-                s = p;
-                p = skip_name(p);
+    /* Trailer: CRC-32 and the size modulo 2^32 */
+    gzip_bits(gzip, gzip->bit_count & 7);
+    crc  = gzip_bits(gzip, 32);
+    size = gzip_bits(gzip, 32);
 
-                mtl.name = string_copy(s, p);
-            }
-            break;
+    gzip_crc(gzip);
 
-        case 'K':
-            if (p[1] == 'a')
-                p = read_mtl_triple(p + 2, mtl.Ka);
-            else if (p[1] == 'd')
-                p = read_mtl_triple(p + 2, mtl.Kd);
-            else if (p[1] == 's')
-                p = read_mtl_triple(p + 2, mtl.Ks);
-            else if (p[1] == 'e')
-                p = read_mtl_triple(p + 2, mtl.Ke);
-            else if (p[1] == 't')
-                p = read_mtl_triple(p + 2, mtl.Kt);
-            break;
+    return !gzip->failed && gzip->bit_count >= 8 * gzip->overrun &&
+           crc == gzip->crc && size == (uint32_t)(gzip->produced - start);
+}
 
-        case 'N':
-            if (p[1] == 's')
-                p = read_mtl_single(p + 2, &mtl.Ns);
-            else if (p[1] == 'i')
-                p = read_mtl_single(p + 2, &mtl.Ni);
-            break;
 
-        case 'T':
-            if (p[1] == 'r')
+static
+void gzip_decode(void* arg)
+{
+    fastObjGzip* gzip = (fastObjGzip*)(arg);
+    int          ok;
+
+
+    /* A file may be several gzip members one after another */
+    do
+        ok = gzip_member(gzip);
+    while (ok && !gzip_at_end(gzip));
+
+    mutex_lock(&gzip->mutex);
+
+    gzip->available = gzip->produced;
+    gzip->finished  = 1;
+    gzip->failed    = !ok;
+    condition_broadcast(&gzip->condition);
+
+    mutex_unlock(&gzip->mutex);
+}
+
+
+static
+void* gzip_open(const char* path, void* user_data)
+{
+    fastObjGzip*   gzip;
+    FILE*          f;
+    char*          name;
+    unsigned char  trailer[4];
+    size_t         n;
+
+
+    (void)(user_data);
+
+    /* A missing file may exist compressed, foo.mtl as foo.mtl.gz */
+    f = fopen(path, "rb");
+    if (!f)
+    {
+        n    = strlen(path);
+        name = (char*)(scratch_realloc(0, n + 4));
+        if (!name)
+            return 0;
+
+        memcpy(name, path, n);
+        memcpy(name + n, ".gz", 4);
+
+        f = fopen(name, "rb");
+        scratch_dealloc(name);
+
+        if (!f)
+            return 0;
+    }
+
+    gzip = (fastObjGzip*)(scratch_realloc(0, sizeof(fastObjGzip)));
+    if (!gzip)
+    {
+        fclose(f);
+        return 0;
+    }
+
+    memset(gzip, 0, sizeof(fastObjGzip));
+
+    gzip->file       = f;
+    gzip->input_size = fread(gzip->input, 1, GZIP_INPUT_SIZE, f);
+    gzip->compressed = gzip_magic(gzip->input, gzip->input_size);
+
+    if (!gzip->compressed)
+        return gzip;
+
+
+    /* The inflated size is only known from the trailer at the end of the file,
+       and only for the last member */
+    if (fseek(f, -4, SEEK_END) == 0 && fread(trailer, 1, 4, f) == 4)
+        gzip->size = (unsigned long)(trailer[0]) | ((unsigned long)(trailer[1]) << 8) |
+                     ((unsigned long)(trailer[2]) << 16) | ((unsigned long)(trailer[3]) << 24);
+
+    if (fseek(f, (long)(gzip->input_size), SEEK_SET) != 0)
+    {
+        fclose(f);
+        scratch_dealloc(gzip);
+        return 0;
+    }
+
+    gzip->ring_size = GZIP_RING_SIZE;
+    gzip->ring      = (unsigned char*)(scratch_realloc(0, gzip->ring_size));
+    if (!gzip->ring)
+    {
+        fclose(f);
+        scratch_dealloc(gzip);
+        return 0;
+    }
+
+    gzip->limit = gzip->ring_size;
+
+    gzip_crc_table(gzip);
+
+    mutex_init(&gzip->mutex);
+    condition_init(&gzip->condition);
+
+
+    /* Inflate on a second thread while the parser reads, or all of it now */
+    gzip->task.func = gzip_decode;
+    gzip->task.arg  = gzip;
+
+    if (!thread_start(&gzip->thread, &gzip->task))
+    {
+        gzip->grow = 1;
+        gzip_decode(gzip);
+        gzip->grow = 2;
+    }
+
+    return gzip;
+}
+
+
+static
+void gzip_close(void* file, void* user_data)
+{
+    fastObjGzip* gzip = (fastObjGzip*)(file);
+
+
+    (void)(user_data);
+
+    if (gzip->compressed)
+    {
+        /* Stop the decoder if the reader gave up early */
+        if (gzip->grow == 0)
+        {
+            mutex_lock(&gzip->mutex);
+            gzip->stop = 1;
+            condition_broadcast(&gzip->condition);
+            mutex_unlock(&gzip->mutex);
+
+            thread_join(&gzip->thread);
+        }
+
+        condition_destroy(&gzip->condition);
+        mutex_destroy(&gzip->mutex);
+        scratch_dealloc(gzip->ring);
+    }
+
+    fclose(gzip->file);
+    scratch_dealloc(gzip);
+}
+
+
+static
+size_t gzip_read(void* file, void* dst, size_t bytes, void* user_data)
+{
+    fastObjGzip* gzip = (fastObjGzip*)(file);
+    char*        out  = (char*)(dst);
+    uint64_t     available;
+    size_t       copied;
+    size_t       offset;
+    size_t       n;
+    size_t       m;
+
+
+    (void)(user_data);
+
+    if (!gzip->compressed)
+    {
+        /* The block read to look for the magic comes first */
+        n = gzip->input_size - gzip->input_position;
+        if (n > bytes)
+            n = bytes;
+
+        memcpy(out, gzip->input + gzip->input_position, n);
+        gzip->input_position += n;
+
+        return n + ((n < bytes) ? fread(out + n, 1, bytes - n, gzip->file) : 0);
+    }
+
+
+    /* Reads are filled completely until the end, the parser takes a short
+       read as the end of the file */
+    copied = 0;
+    while (copied < bytes)
+    {
+        mutex_lock(&gzip->mutex);
+
+        while (gzip->available == gzip->consumed && !gzip->finished)
+            condition_wait(&gzip->condition, &gzip->mutex);
+
+        available = gzip->available;
+
+        mutex_unlock(&gzip->mutex);
+
+        if (available == gzip->consumed)
+            break;
+
+        n = bytes - copied;
+        if (n > available - gzip->consumed)
+            n = (size_t)(available - gzip->consumed);
+
+
+        /* The output may wrap around the end of the ring */
+        offset = (size_t)(gzip->consumed & (gzip->ring_size - 1));
+        m      = gzip->ring_size - offset;
+        if (m > n)
+            m = n;
+
+        memcpy(out + copied, gzip->ring + offset, m);
+        memcpy(out + copied + m, gzip->ring, n - m);
+
+        mutex_lock(&gzip->mutex);
+        gzip->consumed += n;
+        condition_broadcast(&gzip->condition);
+        mutex_unlock(&gzip->mutex);
+
+        copied += n;
+    }
+
+    return copied;
+}
+
+
+static
+unsigned long gzip_size(void* file, void* user_data)
+{
+    fastObjGzip* gzip = (fastObjGzip*)(file);
+
+    /* Readers take this as a hint and read on to the end of the file */
+    if (!gzip->compressed)
+        return file_size(gzip->file, user_data);
+
+    return gzip->size;
+}
+
+
+static
+int gzip_failed(void* file)
+{
+    fastObjGzip* gzip = (fastObjGzip*)(file);
+    int          failed;
+
+
+    /* Only known once a read came back short, the decoder is finished then */
+    if (!gzip->compressed)
+        return 0;
+
+    mutex_lock(&gzip->mutex);
+    failed = !gzip->finished || gzip->failed;
+    mutex_unlock(&gzip->mutex);
+
+    return failed;
+}
+
+
+fastObjCallbacks fast_obj_gzip_callbacks(void)
+{
+    fastObjCallbacks callbacks;
+
+    callbacks.file_open  = gzip_open;
+    callbacks.file_close = gzip_close;
+    callbacks.file_read  = gzip_read;
+    callbacks.file_size  = gzip_size;
+
+    return callbacks;
+}
+
+
+static
+char* string_copy(const char* s, const char* e)
+{
+    size_t n;
+    char*  p;
+        
+    n = (size_t)(e - s);
+    p = (char*)(memory_realloc(0, n + 1));
+    if (p)
+    {
+        memcpy(p, s, n);
+        p[n] = '\0';
+    }
+
+    return p;
+}
+
+
+static
+char* string_substr(const char* s, size_t a, size_t b)
+{
+    return string_copy(s + a, s + b);
+}
+
+
+static
+char* string_concat(const char* a, const char* s, const char* e)
+{
+    size_t an;
+    size_t sn;
+    char*  p;
+        
+    an = a ? strlen(a) : 0;
+    sn = (size_t)(e - s);
+    p = (char*)(memory_realloc(0, an + sn + 1));
+    if (p)
+    {
+        if (a)
+            memcpy(p, a, an);
+        memcpy(p + an, s, sn);
+        p[an + sn] = '\0';
+    }
+
+    return p;
+}
+
+
+static
+int string_equal(const char* a, const char* s, const char* e)
+{
+    size_t an = strlen(a);
+    size_t sn = (size_t)(e - s);
+
+    return an == sn && memcmp(a, s, an) == 0;
+}
+
+
+static
+void string_fix_separators(char* s)
+{
+    while (*s)
+    {
+        if (*s == FAST_OBJ_OTHER_SEP)
+            *s = FAST_OBJ_SEPARATOR;
+        s++;
+    }
+}
+
+
+static
+int is_whitespace(char c)
+{
+    return (c == ' ' || c == '\t' || c == '\r');
+}
+
+static
+int is_newline(char c)
+{
+    return (c == '\n');
+}
+
+
+static
+int is_digit(char c)
+{
+    return (c >= '0' && c <= '9');
+}
+
+
+static
+int is_exponent(char c)
+{
+    return (c == 'e' || c == 'E');
+}
+
+
+static
+const char* skip_whitespace(const char* ptr)
+{
+    while (is_whitespace(*ptr))
+        ptr++;
+
+    return ptr;
+}
+
+
+static
+const char* part_name(const char* ptr, const char* end, const char** e)
+{
+    /* Same as skip_whitespace/skip_name, but stays inside the line */
+    while (ptr < end && is_whitespace(*ptr))
+        ptr++;
+
+    while (end > ptr && is_whitespace(end[-1]))
+        end--;
+
+    *e = end;
+
+    return ptr;
+}
+
+
+#ifdef FAST_OBJ_SSE2
+static
+unsigned int bit_first(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return (unsigned int)(idx);
+#else
+    return (unsigned int)(__builtin_ctz(mask));
+#endif
+}
+
+
+static
+unsigned int bit_last(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse(&idx, mask);
+    return (unsigned int)(idx);
+#else
+    return 31u - (unsigned int)(__builtin_clz(mask));
+#endif
+}
+
+
+static
+unsigned int bit_count(unsigned int mask)
+{
+#ifdef _MSC_VER
+    mask = mask - ((mask >> 1) & 0x55555555u);
+    mask = (mask & 0x33333333u) + ((mask >> 2) & 0x33333333u);
+    return (((mask + (mask >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+#else
+    return (unsigned int)(__builtin_popcount(mask));
+#endif
+}
+#endif
+
+
+static
+const char* find_newline(const char* ptr, const char* end)
+{
+#ifdef FAST_OBJ_SSE2
+    const __m128i nl = _mm_set1_epi8('\n');
+    int           mask;
+
+
+    /* Compare 16 bytes at a time while a whole block is in range */
+    while (end - ptr >= 16)
+    {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(ptr)), nl));
+        if (mask)
+            return ptr + bit_first((unsigned int)(mask));
+
+        ptr += 16;
+    }
+#endif
+
+    while (ptr < end && !is_newline(*ptr))
+        ptr++;
+
+    return ptr;
+}
+
+
+static
+const char* skip_name(const char* ptr, const char* end)
+{
+    const char* s = ptr;
+
+    /* Names run to the end of the line, less trailing whitespace */
+    ptr = find_newline(ptr, end);
+
+    while (ptr > s && is_whitespace(*(ptr - 1)))
+        ptr--;
+
+    return ptr;
+}
+
+
+static
+const char* find_last_newline(const char* start, const char* end)
+{
+#ifdef FAST_OBJ_SSE2
+    const __m128i nl = _mm_set1_epi8('\n');
+    int           mask;
+
+
+    while (end - start >= 16)
+    {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(end - 16)), nl));
+        if (mask)
+            return end - 16 + bit_last((unsigned int)(mask));
+
+        end -= 16;
+    }
+#endif
+
+    while (end > start)
+    {
+        end--;
+        if (is_newline(*end))
+            return end;
+    }
+
+    return 0;
+}
+
+
+static
+fastObjUInt count_tokens(const char* ptr, const char* end)
+{
+    fastObjUInt  count;
+    unsigned int space;
+
+
+    count = 0;
+    space = 1;
+
+#ifdef FAST_OBJ_SSE2
+    {
+        const __m128i sp  = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i cr  = _mm_set1_epi8('\r');
+        __m128i       c;
+        unsigned int  mask;
+
+
+        /* A token starts at each non-whitespace byte that follows whitespace */
+        while (end - ptr >= 16)
+        {
+            c = _mm_loadu_si128((const __m128i*)(ptr));
+            mask = (unsigned int)(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, sp), _mm_cmpeq_epi8(c, tab)), _mm_cmpeq_epi8(c, cr))));
+
+            count += bit_count(~mask & ((mask << 1) | space) & 0xFFFF);
+            space  = (mask >> 15) & 1;
+
+            ptr += 16;
+        }
+    }
+#endif
+
+    while (ptr < end)
+    {
+        if (is_whitespace(*ptr))
+        {
+            space = 1;
+        }
+        else
+        {
+            count += space;
+            space  = 0;
+        }
+
+        ptr++;
+    }
+
+    return count;
+}
+
+
+static
+const char* skip_line(const char* ptr, const char* end)
+{
+    /* Most lines are parsed up to their new line already */
+    if (!is_newline(*ptr))
+        ptr = find_newline(ptr, end);
+
+    return (ptr < end) ? ptr + 1 : end;
+}
+
+
+static
+void bounds_reset(float* bounds_min, float* bounds_max)
+{
+    bounds_min[0] = bounds_min[1] = bounds_min[2] = +FLT_MAX;
+    bounds_max[0] = bounds_max[1] = bounds_max[2] = -FLT_MAX;
+}
+
+
+static
+void bounds_add(float* bounds_min, float* bounds_max, const float* p)
+{
+    unsigned int ii;
+
+    for (ii = 0; ii < 3; ii++)
+    {
+        if (p[ii] < bounds_min[ii])
+            bounds_min[ii] = p[ii];
+        if (p[ii] > bounds_max[ii])
+            bounds_max[ii] = p[ii];
+    }
+}
+
+
+static
+fastObjGroup object_default(void)
+{
+    fastObjGroup object;
+
+    object.name         = 0;
+    object.face_count   = 0;
+    object.face_offset  = 0;
+    object.index_offset = 0;
+    object.index_count  = 0;
+    bounds_reset(object.bounds_min, object.bounds_max);
+
+    return object;
+}
+
+
+static
+void object_clean(fastObjGroup* object)
+{
+    memory_dealloc(object->name);
+}
+
+
+static
+void flush_object(fastObjData* data)
+{
+    /* Add object if not empty (chunks keep all of them for merging, push parsers none) */
+    if ((data->object.face_count > 0 && !data->handlers) || data->chunked)
+        array_push(data->mesh->objects, data->object);
+    else
+        object_clean(&data->object);
+
+    /* Reset for more data */
+    data->object = object_default();
+    data->object.face_offset  = array_size(data->mesh->face_vertices);
+    data->object.index_offset = array_size(data->mesh->indices);
+}
+
+
+
+static
+fastObjGroup group_default(void)
+{
+    fastObjGroup group;
+
+    group.name         = 0;
+    group.face_count   = 0;
+    group.face_offset  = 0;
+    group.index_offset = 0;
+    group.index_count  = 0;
+    bounds_reset(group.bounds_min, group.bounds_max);
+
+    return group;
+}
+
+
+static
+void group_clean(fastObjGroup* group)
+{
+    memory_dealloc(group->name);
+}
+
+
+static
+void flush_group(fastObjData* data)
+{
+    /* Add group if not empty (chunks keep all of them for merging, push parsers none) */
+    if ((data->group.face_count > 0 && !data->handlers) || data->chunked)
+        array_push(data->mesh->groups, data->group);
+    else
+        group_clean(&data->group);
+
+    /* Reset for more data */
+    data->group = group_default();
+    data->group.face_offset  = array_size(data->mesh->face_vertices);
+    data->group.index_offset = array_size(data->mesh->indices);
+}
+
+
+static
+const char* parse_int(const char* ptr, int* val)
+{
+    int sign;
+    int num;
+
+
+    if (*ptr == '-')
+    {
+        sign = -1;
+        ptr++;
+    }
+    else
+    {
+        sign = +1;
+    }
+
+    num = 0;
+    while (is_digit(*ptr))
+        num = 10 * num + (*ptr++ - '0');
+
+    *val = sign * num;
+
+    return ptr;
+}
+
+
+static
+int leading_zeros(uint64_t v)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long idx;
+    _BitScanReverse64(&idx, v);
+    return 63 - (int)(idx);
+#elif defined(__GNUC__)
+    return __builtin_clzll(v);
+#else
+    int n = 0;
+    while (!(v & 0x8000000000000000ULL))
+    {
+        v <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+
+static
+uint64_t multiply_128(uint64_t a, uint64_t b, uint64_t* lo)
+{
+#if defined(__SIZEOF_INT128__)
+    __extension__ unsigned __int128 r = (unsigned __int128)(a) * b;
+    *lo = (uint64_t)(r);
+    return (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t hi;
+    *lo = _umul128(a, b, &hi);
+    return hi;
+#else
+    uint64_t a0 = a & 0xFFFFFFFF, a1 = a >> 32;
+    uint64_t b0 = b & 0xFFFFFFFF, b1 = b >> 32;
+    uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    uint64_t mid = (p00 >> 32) + (p01 & 0xFFFFFFFF) + (p10 & 0xFFFFFFFF);
+    *lo = (mid << 32) | (p00 & 0xFFFFFFFF);
+    return p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+#endif
+}
+
+
+static
+uint32_t float_bits(uint64_t w, long q)
+{
+    const uint64_t precision = 0xFFFFFFFFFFFFFFFFULL >> 26;
+    uint64_t       hi;
+    uint64_t       lo;
+    uint64_t       hi2;
+    uint64_t       lo2;
+    uint64_t       mantissa;
+    long           power2;
+    int            lz;
+    int            upper;
+    int            shift;
+
+
+    /* Eisel-Lemire: w * 10^q as the bits of a positive float, correctly rounded */
+    if (w == 0 || q < FLOAT_MIN_POWER)
+        return 0;
+
+    if (q > FLOAT_MAX_POWER)
+        return 0xFFu << 23;
+
+    lz = leading_zeros(w);
+    w <<= lz;
+
+    hi = multiply_128(w, POWER_5_128[q - FLOAT_MIN_POWER][0], &lo);
+    if ((hi & precision) == precision)
+    {
+        hi2 = multiply_128(w, POWER_5_128[q - FLOAT_MIN_POWER][1], &lo2);
+        lo += hi2;
+        if (hi2 > lo)
+            hi++;
+    }
+
+    upper    = (int)(hi >> 63);
+    shift    = upper + 64 - 23 - 3;
+    mantissa = hi >> shift;
+    power2   = (((152170 + 65536) * q) >> 16) + 63 + upper - lz + 127;
+
+    if (power2 <= 0)
+    {
+        /* Subnormal */
+        if (-power2 + 1 >= 64)
+            return 0;
+
+        mantissa >>= -power2 + 1;
+        mantissa  += mantissa & 1;
+        mantissa >>= 1;
+        power2     = (mantissa < (1u << 23)) ? 0 : 1;
+
+        return (uint32_t)(mantissa) | ((uint32_t)(power2) << 23);
+    }
+
+    /* Exactly halfway: round to even */
+    if (lo <= 1 && q >= -17 && q <= 10 && (mantissa & 3) == 1 && (mantissa << shift) == hi)
+        mantissa &= ~(uint64_t)(1);
+
+    mantissa  += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (2u << 23))
+    {
+        mantissa = 1u << 23;
+        power2++;
+    }
+
+    if (power2 >= 0xFF)
+        return 0xFFu << 23;
+
+    return ((uint32_t)(mantissa) & ~(1u << 23)) | ((uint32_t)(power2) << 23);
+}
+
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define FAST_OBJ_SWAR
+#endif
+
+#ifdef FAST_OBJ_SWAR
+static
+uint64_t swar_non_digits(uint64_t v)
+{
+    /* High bit set in each byte of v that isn't an ASCII digit (exact up to the first one) */
+    return ((v + 0x4646464646464646ULL) | (v - 0x3030303030303030ULL)) & 0x8080808080808080ULL;
+}
+
+
+static
+uint32_t swar_value(uint64_t v, unsigned int n)
+{
+    /* Value of the first n (1-8) ASCII digits in v: shifting them to the top
+       makes the missing digits leading zeros, then digits combine pairwise */
+    v -= 0x3030303030303030ULL;
+    v <<= 8 * (8 - n);
+    v  = (v * 10) + (v >> 8);
+    v  = (((v & 0x000000FF000000FFULL) * 0x000F424000000064ULL) +
+          (((v >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32;
+
+    return (uint32_t)(v);
+}
+#endif
+
+
+static
+const char* parse_digits(const char* ptr, uint64_t* val)
+{
+#ifdef FAST_OBJ_SWAR
+    uint64_t v;
+
+
+    /* 8 digits per step while there are that many */
+    for (;;)
+    {
+        memcpy(&v, ptr, sizeof(v));
+        if (swar_non_digits(v))
+            break;
+
+        *val = *val * 100000000 + swar_value(v, 8);
+        ptr += 8;
+    }
+#endif
+
+    while (is_digit(*ptr))
+        *val = 10 * *val + (uint64_t)(*ptr++ - '0');
+
+    return ptr;
+}
+
+
+static FAST_OBJ_NOINLINE
+const char* parse_float_exact(const char* ptr, float* val)
+{
+    const char* start;
+    const char* digits;
+    const char* point;
+    const char* fraction;
+    const char* fraction_end;
+    const char* p;
+    uint64_t    w;
+    long        count;
+    long        exp;
+    long        q;
+    int         negative;
+    int         exp_negative;
+    int         truncated;
+    uint32_t    bits;
+
+
+    start = ptr;
+
+    negative = (*ptr == '-');
+    if (*ptr == '+' || *ptr == '-')
+        ptr++;
+
+
+    /* Significand digits, accumulated as one integer */
+    w = 0;
+    digits = ptr;
+    ptr = parse_digits(ptr, &w);
+    point = ptr;
+
+    fraction = ptr;
+    if (*ptr == '.')
+    {
+        ptr++;
+        fraction = ptr;
+        ptr = parse_digits(ptr, &w);
+    }
+    fraction_end = ptr;
+
+    count = (long)(point - digits) + (long)(fraction_end - fraction);
+    if (count == 0)
+    {
+        *val = 0.0f;
+        return ptr;
+    }
+
+
+    /* Exponent, saturated well outside the float range */
+    exp = 0;
+    if (is_exponent(*ptr))
+    {
+        ptr++;
+
+        exp_negative = (*ptr == '-');
+        if (*ptr == '+' || *ptr == '-')
+            ptr++;
+
+        while (is_digit(*ptr))
+        {
+            if (exp < 0x10000)
+                exp = 10 * exp + (*ptr - '0');
+            ptr++;
+        }
+
+        if (exp_negative)
+            exp = -exp;
+    }
+
+    q = exp - (long)(fraction_end - fraction);
+
+
+    /* More than 19 significant digits: keep the first 19 */
+    truncated = 0;
+    if (count > 19)
+    {
+        for (p = digits; *p == '0' || *p == '.'; p++)
+            if (*p == '0')
+                count--;
+
+        if (count > 19)
+        {
+            truncated = 1;
+
+            w = 0;
+            for (p = digits; p < point && w < 1000000000000000000ULL; p++)
+                w = 10 * w + (uint64_t)(*p - '0');
+
+            if (w >= 1000000000000000000ULL)
+            {
+                q = exp + (long)(point - p);
+            }
+            else
+            {
+                for (p = fraction; p < fraction_end && w < 1000000000000000000ULL; p++)
+                    w = 10 * w + (uint64_t)(*p - '0');
+
+                q = exp - (long)(p - fraction);
+            }
+        }
+    }
+
+    bits = float_bits(w, q);
+
+    /* Truncated digits can only be ignored if they can't change the result */
+    if (truncated && bits != float_bits(w + 1, q))
+    {
+        *val = strtof(start, 0);
+        return ptr;
+    }
+
+    if (negative)
+        bits |= 0x80000000u;
+
+    memcpy(val, &bits, sizeof(bits));
+
+    return ptr;
+}
+
+
+static
+const char* parse_float(const char* ptr, float* val)
+{
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    const char* start;
+    const char* digits;
+    uint64_t    w;
+    uint64_t    bits;
+    uint32_t    sign;
+    size_t      count;
+    size_t      fraction;
+    double      d;
+    float       r;
+
+
+    ptr = skip_whitespace(ptr);
+    start = ptr;
+
+    sign = (*ptr == '-') ? 0x80000000u : 0;
+    if (*ptr == '+' || *ptr == '-')
+        ptr++;
+
+    /* Fast path for up to 15 digits and no exponent, which covers nearly every
+       OBJ number.  Overflow of w only happens on inputs that fail the test below */
+    w = 0;
+    digits = ptr;
+    while (is_digit(*ptr))
+        w = 10 * w + (uint64_t)(*ptr++ - '0');
+
+    count = (size_t)(ptr - digits);
+
+    fraction = 0;
+    if (*ptr == '.')
+    {
+        ptr++;
+
+        digits = ptr;
+        while (is_digit(*ptr))
+            w = 10 * w + (uint64_t)(*ptr++ - '0');
+
+        fraction = (size_t)(ptr - digits);
+        count += fraction;
+    }
+
+    if (count - 1 < 15 && !is_exponent(*ptr))
+    {
+        /* Clinger: w and 10^fraction are exact doubles, so the division rounds
+           correctly.  Rounding that to float is only wrong when it hit a midpoint */
+        d = (double)((int64_t)(w)) / POWER_10_DOUBLE[fraction];
+        memcpy(&bits, &d, sizeof(bits));
+
+        if ((bits & 0x1FFFFFFF) != 0x10000000)
+        {
+            r = (float)(d);
+            memcpy(&bits, &r, sizeof(r));
+            sign |= (uint32_t)(bits);
+            memcpy(val, &sign, sizeof(sign));
+
+            return ptr;
+        }
+    }
+
+    /* Everything else goes through the exact conversion */
+    return parse_float_exact(start, val);
+#else
+    return parse_float_exact(skip_whitespace(ptr), val);
+#endif
+}
+
+
+static
+const char* parse_vertex(fastObjData* data, const char* ptr)
+{
+    unsigned int ii;
+    float        v;
+    const float* color;
+
+
+    for (ii = 0; ii < 3; ii++)
+    {
+        ptr = parse_float(ptr, &v);
+        array_push(data->mesh->positions, v);
+    }
+
+    bounds_add(data->bounds_min, data->bounds_max, data->mesh->positions + array_size(data->mesh->positions) - 3);
+
+
+    color = 0;
+
+    ptr = skip_whitespace(ptr);
+    if (!is_newline(*ptr) && !(data->skip & FAST_OBJ_SKIP_COLORS))
+    {
+        /* Pre-sized colors follow the reserved positions */
+        if (data->presize && !data->mesh->colors)
+            (void)(array_reserve(data->mesh->colors, array_capacity(data->mesh->positions)));
+
+        /* Fill the colors array until it matches the size of the positions array */
+        for (ii = array_size(data->mesh->colors); ii < array_size(data->mesh->positions) - 3; ++ii)
+        {
+            array_push(data->mesh->colors, 1.0f);
+        }
+
+        for (ii = 0; ii < 3; ++ii)
+        {
+            ptr = parse_float(ptr, &v);
+            array_push(data->mesh->colors, v);
+        }
+
+        color = data->mesh->colors + array_size(data->mesh->colors) - 3;
+    }
+
+    if (data->handlers && data->handlers->position)
+        data->handlers->position(array_size(data->mesh->positions) / 3 - 1,
+                                 data->mesh->positions + array_size(data->mesh->positions) - 3,
+                                 color, data->handler_data);
+
+    return ptr;
+}
+
+
+static
+const char* parse_texcoord(fastObjData* data, const char* ptr)
+{
+    unsigned int ii;
+    float        v;
+
+
+    for (ii = 0; ii < 2; ii++)
+    {
+        ptr = parse_float(ptr, &v);
+        array_push(data->mesh->texcoords, v);
+    }
+
+    if (data->handlers && data->handlers->texcoord)
+        data->handlers->texcoord(array_size(data->mesh->texcoords) / 2 - 1,
+                                 data->mesh->texcoords + array_size(data->mesh->texcoords) - 2,
+                                 data->handler_data);
+
+    return ptr;
+}
+
+
+static
+const char* parse_normal(fastObjData* data, const char* ptr)
+{
+    unsigned int ii;
+    float        v;
+
+
+    for (ii = 0; ii < 3; ii++)
+    {
+        ptr = parse_float(ptr, &v);
+        array_push(data->mesh->normals, v);
+    }
+
+    if (data->handlers && data->handlers->normal)
+        data->handlers->normal(array_size(data->mesh->normals) / 3 - 1,
+                               data->mesh->normals + array_size(data->mesh->normals) - 3,
+                               data->handler_data);
+
+    return ptr;
+}
+
+
+static
+void emit_face(fastObjData* data, unsigned int count, unsigned char line)
+{
+    fastObjMesh* m = data->mesh;
+
+
+    if (data->handlers->face)
+        data->handlers->face(m->indices + array_size(m->indices) - count, count, data->material, line, data->handler_data);
+
+    /* Only vertex data is kept, so memory doesn't grow with the face count */
+    _array_size(m->indices)        = 0;
+    _array_size(m->face_vertices)  = 0;
+    _array_size(m->face_materials) = 0;
+
+    if (m->face_lines)
+        _array_size(m->face_lines) = 0;
+}
+
+
+static
+const char* parse_face(fastObjData* data, const char* ptr, unsigned char line)
+{
+    unsigned int count;
+    fastObjIndex vn;
+    const float* p;
+    int          v;
+    int          t;
+    int          n;
+
+
+    ptr = skip_whitespace(ptr);
+
+    count = 0;
+    while (!is_newline(*ptr))
+    {
+        v = 0;
+        t = 0;
+        n = 0;
+
+        ptr = parse_int(ptr, &v);
+        if (*ptr == '/')
+        {
+            ptr++;
+            if (*ptr != '/')
+                ptr = parse_int(ptr, &t);
+
+            if (*ptr == '/')
+            {
+                ptr++;
+                ptr = parse_int(ptr, &n);
+            }
+        }
+
+        /* Skipped attributes are never referenced */
+        if (data->skip & FAST_OBJ_SKIP_TEXCOORDS)
+            t = 0;
+        if (data->skip & FAST_OBJ_SKIP_NORMALS)
+            n = 0;
+
+        if (v < 0)
+            vn.p = data->position_base + (array_size(data->mesh->positions) / 3) - (fastObjUInt)(-v);
+        else if (v > 0)
+            vn.p = (fastObjUInt)(v);
+        else
+            return ptr; /* Skip lines with no valid vertex index */
+
+        if (t < 0)
+            vn.t = data->texcoord_base + (array_size(data->mesh->texcoords) / 2) - (fastObjUInt)(-t);
+        else if (t > 0)
+            vn.t = (fastObjUInt)(t);
+        else
+            vn.t = 0;
+
+        if (n < 0)
+            vn.n = data->normal_base + (array_size(data->mesh->normals) / 3) - (fastObjUInt)(-n);
+        else if (n > 0)
+            vn.n = (fastObjUInt)(n);
+        else
+            vn.n = 0;
+
+        /* Boxes grow with positions already parsed, later ones are left for after parsing */
+        if (data->group_bounds)
+        {
+            if (vn.p < array_size(data->mesh->positions) / 3)
+            {
+                p = data->mesh->positions + 3 * vn.p;
+                bounds_add(data->group.bounds_min, data->group.bounds_max, p);
+                bounds_add(data->object.bounds_min, data->object.bounds_max, p);
+            }
+            else
+            {
+                data->bounds_pending = 1;
+            }
+        }
+
+        array_push(data->mesh->indices, vn);
+        count++;
+
+        ptr = skip_whitespace(ptr);
+    }
+
+    array_push(data->mesh->face_vertices, count);
+    array_push(data->mesh->face_materials, data->material);
+
+    if (line || data->mesh->face_lines)
+    {
+        /* when line info exists, ensure it uses aligned indexing with other face data */
+        size_t skipped;
+
+        if (data->presize && !data->mesh->face_lines)
+            (void)(array_reserve(data->mesh->face_lines, array_capacity(data->mesh->face_vertices)));
+
+        skipped = array_size(data->mesh->face_vertices) - array_size(data->mesh->face_lines);
+        while (--skipped > 0)
+            array_push(data->mesh->face_lines, 0);
+
+        array_push(data->mesh->face_lines, line);
+    }
+
+    data->group.face_count++;
+    data->object.face_count++;
+    data->group.index_count  += count;
+    data->object.index_count += count;
+
+    if (data->handlers)
+        emit_face(data, count, line);
+
+    return ptr;
+}
+
+
+static
+const char* parse_object(fastObjData* data, const char* ptr, const char* end)
+{
+    const char* s;
+    const char* e;
+
+
+    ptr = skip_whitespace(ptr);
+
+    s = ptr;
+    ptr = skip_name(ptr, end);
+    e = ptr;
+
+    flush_object(data);
+    data->object.name = string_copy(s, e);
+
+    if (data->handlers && data->handlers->object)
+        data->handlers->object(data->object.name, data->handler_data);
+
+    return ptr;
+}
+
+
+static
+const char* parse_group(fastObjData* data, const char* ptr, const char* end)
+{
+    const char* s;
+    const char* e;
+
+
+    ptr = skip_whitespace(ptr);
+
+    s = ptr;
+    ptr = skip_name(ptr, end);
+    e = ptr;
+
+    flush_group(data);
+    data->group.name = string_copy(s, e);
+
+    if (data->handlers && data->handlers->group)
+        data->handlers->group(data->group.name, data->handler_data);
+
+    return ptr;
+}
+
+
+static
+fastObjTexture map_default(void)
+{
+    fastObjTexture map;
+
+    map.name = 0;
+    map.path = 0;
+
+    return map;
+}
+
+
+static
+fastObjMaterial mtl_default(void)
+{
+    fastObjMaterial mtl;
+
+    mtl.name = 0;
+
+    mtl.Ka[0] = 0.0;
+    mtl.Ka[1] = 0.0;
+    mtl.Ka[2] = 0.0;
+    mtl.Kd[0] = 1.0;
+    mtl.Kd[1] = 1.0;
+    mtl.Kd[2] = 1.0;
+    mtl.Ks[0] = 0.0;
+    mtl.Ks[1] = 0.0;
+    mtl.Ks[2] = 0.0;
+    mtl.Ke[0] = 0.0;
+    mtl.Ke[1] = 0.0;
+    mtl.Ke[2] = 0.0;
+    mtl.Kt[0] = 0.0;
+    mtl.Kt[1] = 0.0;
+    mtl.Kt[2] = 0.0;
+    mtl.Ns    = 1.0;
+    mtl.Ni    = 1.0;
+    mtl.Tf[0] = 1.0;
+    mtl.Tf[1] = 1.0;
+    mtl.Tf[2] = 1.0;
+    mtl.d     = 1.0;
+    mtl.illum = 1;
+
+    mtl.fallback = 0;
+
+    mtl.map_Ka   = 0;
+    mtl.map_Kd   = 0;
+    mtl.map_Ks   = 0;
+    mtl.map_Ke   = 0;
+    mtl.map_Kt   = 0;
+    mtl.map_Ns   = 0;
+    mtl.map_Ni   = 0;
+    mtl.map_d    = 0;
+    mtl.map_bump = 0;
+
+    return mtl;
+}
+
+
+static
+fastObjUInt record_statement(fastObjData* data, const char* s, const char* e, int library)
+{
+    fastObjStatement statement;
+
+
+    statement.name    = string_copy(s, e);
+    statement.library = library;
+    array_push(data->statements, statement);
+
+    /* Chunk faces refer to materials by statement number, 0 being the material
+       in use at the start of the chunk */
+    return array_size(data->statements);
+}
+
+
+static
+uint32_t hash_name(const char* s, const char* e)
+{
+    uint32_t h;
+
+
+    /* FNV-1a */
+    h = 2166136261u;
+    while (s < e)
+        h = (h ^ (unsigned char)(*s++)) * 16777619u;
+
+    return h;
+}
+
+
+static
+const char* names_item(const void* items, size_t stride, fastObjUInt idx)
+{
+    /* Materials and textures both start with their name */
+    return *(char* const*)((const char*)(items) + idx * stride);
+}
+
+
+static
+fastObjUInt names_lookup(const fastObjNames* names, const void* items, size_t stride, const char* s, const char* e, uint32_t h)
+{
+    fastObjUInt slot;
+    fastObjUInt entry;
+
+
+    if (names->size == 0)
+        return (fastObjUInt)(-1);
+
+    slot = h & (names->size - 1);
+    while ((entry = names->slots[slot]) != 0)
+    {
+        if (string_equal(names_item(items, stride, entry - 1), s, e))
+            return entry - 1;
+
+        slot = (slot + 1) & (names->size - 1);
+    }
+
+    return (fastObjUInt)(-1);
+}
+
+
+static
+int names_update(fastObjNames* names, const void* items, size_t stride, fastObjUInt count)
+{
+    fastObjUInt* slots;
+    fastObjUInt  size;
+    fastObjUInt  slot;
+    fastObjUInt  ii;
+    const char*  name;
+    uint32_t     h;
+
+
+    /* Keep the table at most half full, rebuilding it when it grows */
+    if (2 * count > names->size)
+    {
+        size = names->size ? names->size : 64;
+        while (2 * count > size)
+            size *= 2;
+
+        slots = (fastObjUInt*)(scratch_realloc(names->slots, size * sizeof(fastObjUInt)));
+        if (!slots)
+            return 0;
+
+        memset(slots, 0, size * sizeof(fastObjUInt));
+
+        names->slots = slots;
+        names->size  = size;
+        names->count = 0;
+    }
+
+    /* Add elements pushed since the last lookup, keeping the first of any
+       repeated name like a linear search would */
+    for (ii = names->count; ii < count; ii++)
+    {
+        name = names_item(items, stride, ii);
+        if (!name)
+            continue;
+
+        h = hash_name(name, name + strlen(name));
+        if (names_lookup(names, items, stride, name, name + strlen(name), h) != (fastObjUInt)(-1))
+            continue;
+
+        slot = h & (names->size - 1);
+        while (names->slots[slot])
+            slot = (slot + 1) & (names->size - 1);
+
+        names->slots[slot] = ii + 1;
+    }
+
+    names->count = count;
+
+    return 1;
+}
+
+
+static
+fastObjUInt names_find(fastObjNames* names, const void* items, size_t stride, fastObjUInt count, const char* s, const char* e)
+{
+    fastObjUInt idx;
+
+
+    /* Returns count when the name is not found */
+    if (names_update(names, items, stride, count))
+    {
+        idx = names_lookup(names, items, stride, s, e, hash_name(s, e));
+        return (idx == (fastObjUInt)(-1)) ? count : idx;
+    }
+
+    /* Out of memory for the table */
+    for (idx = 0; idx < count; idx++)
+        if (names_item(items, stride, idx) && string_equal(names_item(items, stride, idx), s, e))
+            break;
+
+    return idx;
+}
+
+
+static
+void names_clean(fastObjNames* names)
+{
+    scratch_dealloc(names->slots);
+
+    names->slots = 0;
+    names->size  = 0;
+    names->count = 0;
+}
+
+
+static
+void use_material(fastObjData* data, const char* s, const char* e)
+{
+    unsigned int idx;
+
+
+    /* Find an existing material with the same name */
+    idx = names_find(&data->material_names, data->mesh->materials, sizeof(fastObjMaterial),
+                     array_size(data->mesh->materials), s, e);
+
+    /* If doesn't exist, create a default one with this name
+       Note: this case happens when OBJ doesn't have its MTL */
+    if (idx == array_size(data->mesh->materials))
+    {
+        fastObjMaterial new_mtl = mtl_default();
+        new_mtl.name = string_copy(s, e);
+        new_mtl.fallback = 1;
+        array_push(data->mesh->materials, new_mtl);
+    }
+
+    data->material = idx;
+
+    if (data->handlers && data->handlers->material)
+        data->handlers->material(idx, &data->mesh->materials[idx], data->handler_data);
+}
+
+
+static
+const char* parse_usemtl(fastObjData* data, const char* ptr, const char* end)
+{
+    const char* s;
+    const char* e;
+
+
+    ptr = skip_whitespace(ptr);
+
+    /* Parse the material name */
+    s = ptr;
+    ptr = skip_name(ptr, end);
+    e = ptr;
+
+    if (data->chunked)
+        data->material = record_statement(data, s, e, 0);
+    else
+        use_material(data, s, e);
+
+    return ptr;
+}
+
+
+static
+void map_clean(fastObjTexture* map)
+{
+    memory_dealloc(map->name);
+    memory_dealloc(map->path);
+}
+
+
+static
+void mtl_clean(fastObjMaterial* mtl)
+{
+    memory_dealloc(mtl->name);
+}
+
+
+static
+const char* read_mtl_int(const char* p, int* v)
+{
+    return parse_int(p, v);
+}
+
+
+static
+const char* read_mtl_single(const char* p, float* v)
+{
+    return parse_float(p, v);
+}
+
+
+static
+const char* read_mtl_triple(const char* p, float v[3])
+{
+    p = read_mtl_single(p, &v[0]);
+    p = read_mtl_single(p, &v[1]);
+    p = read_mtl_single(p, &v[2]);
+
+    return p;
+}
+
+
+static
+unsigned int add_map(fastObjData* data, const char* s, const char* e)
+{
+    unsigned int idx;
+
+
+    /* Try to find an existing texture map with the same name (the dummy at index 0 has none) */
+    idx = names_find(&data->texture_names, data->mesh->textures, sizeof(fastObjTexture),
+                     array_size(data->mesh->textures), s, e);
+
+    /* Add it to the texture array if it didn't already exist */
+    if (idx == array_size(data->mesh->textures))
+    {
+        fastObjTexture new_map = map_default();
+        new_map.name = string_copy(s, e);
+        new_map.path = string_concat(data->base, s, e);
+        string_fix_separators(new_map.path);
+        array_push(data->mesh->textures, new_map);
+    }
+
+    return idx;
+}
+
+
+static
+const char* read_map(fastObjData* data, const char* ptr, const char* end, unsigned int* idx)
+{
+    const char*     s;
+    const char*     e;
+
+
+    ptr = skip_whitespace(ptr);
+
+    /* Don't support options at present */
+    if (*ptr == '-')
+        return ptr;
+
+
+    /* Read name */
+    s = ptr;
+    ptr = skip_name(ptr, end);
+    e = ptr;
+
+    *idx = add_map(data, s, e);
+
+    return e;
+}
+
+
+static
+char* read_file(void* file, const fastObjCallbacks* callbacks, void* user_data, size_t* size)
+{
+    size_t n;
+    size_t l;
+    size_t r;
+    char*  contents;
+    char*  grown;
+
+
+    /* Read entire file.  The size is only a hint, a gzip file knows just the
+       size of its last member, so read on until a read comes back empty */
+    n = (size_t)(callbacks->file_size(file, user_data));
+
+    contents = (char*)(scratch_realloc(0, n + 1 + BUFFER_PADDING));
+    if (!contents)
+        return 0;
+
+    l = 0;
+    for (;;)
+    {
+        r = callbacks->file_read(file, contents + l, n + 1 - l, user_data);
+        if (r == 0)
+            break;
+        l += r;
+
+        /* One byte more than the hint means there is more to come */
+        if (l > n)
+        {
+            n     = n * 2 + BUFFER_SIZE;
+            grown = (char*)(scratch_realloc(contents, n + 1 + BUFFER_PADDING));
+            if (!grown)
+            {
+                scratch_dealloc(contents);
+                return 0;
+            }
+
+            contents = grown;
+        }
+    }
+
+    /* A damaged gzip file ends early, which would look like a shorter file */
+    if (callbacks->file_read == gzip_read && gzip_failed(file))
+    {
+        scratch_dealloc(contents);
+        return 0;
+    }
+
+    *size = l;
+
+    return contents;
+}
+
+
+static
+int read_mtllib(fastObjData* data, void* file, const fastObjCallbacks* callbacks, void* user_data)
+{
+    const char*     s;
+    char*           contents;
+    size_t          l;
+    const char*     p;
+    const char*     e;
+    int             found_d;
+    fastObjMaterial mtl;
+
+
+    contents = read_file(file, callbacks, user_data, &l);
+    if (!contents)
+        return 0;
+
+    contents[l] = '\n';
+    memset(contents + l + 1, 0, BUFFER_PADDING);
+
+    mtl = mtl_default();
+
+    found_d = 0;
+
+    p = contents;
+    e = contents + l;
+    while (p < e)
+    {
+        p = skip_whitespace(p);
+
+        switch (*p)
+        {
+        case 'n':
+            p++;
+            if (p[0] == 'e' &&
+                p[1] == 'w' &&
+                p[2] == 'm' &&
+                p[3] == 't' &&
+                p[4] == 'l' &&
+                is_whitespace(p[5]))
+            {
+                /* Push previous material (if there is one) */
+                if (mtl.name)
+                {
+                    array_push(data->mesh->materials, mtl);
+                    mtl = mtl_default();
+                }
+
+
+                /* Read name */
+                p += 5;
+
+                while (is_whitespace(*p))
+                    p++;
+
+                s = p;
+                p = skip_name(p, e);
+
+                mtl.name = string_copy(s, p);
+            }
+            break;
+
+        case 'K':
+            if (p[1] == 'a')
+                p = read_mtl_triple(p + 2, mtl.Ka);
+            else if (p[1] == 'd')
+                p = read_mtl_triple(p + 2, mtl.Kd);
+            else if (p[1] == 's')
+                p = read_mtl_triple(p + 2, mtl.Ks);
+            else if (p[1] == 'e')
+                p = read_mtl_triple(p + 2, mtl.Ke);
+            else if (p[1] == 't')
+                p = read_mtl_triple(p + 2, mtl.Kt);
+            break;
+
+        case 'N':
+            if (p[1] == 's')
+                p = read_mtl_single(p + 2, &mtl.Ns);
+            else if (p[1] == 'i')
+                p = read_mtl_single(p + 2, &mtl.Ni);
+            break;
+
+        case 'T':
+            if (p[1] == 'r')
+            {
+                float Tr;
+                p = read_mtl_single(p + 2, &Tr);
+                if (!found_d)
+                {
+                    /* Ignore Tr if we've already read d */
+                    mtl.d = 1.0f - Tr;
+                }
+            }
+            else if (p[1] == 'f')
+                p = read_mtl_triple(p + 2, mtl.Tf);
+            break;
+
+        case 'd':
+            if (is_whitespace(p[1]))
+            {
+                p = read_mtl_single(p + 1, &mtl.d);
+                found_d = 1;
+            }
+            break;
+
+        case 'i':
+            p++;
+            if (p[0] == 'l' &&
+                p[1] == 'l' &&
+                p[2] == 'u' &&
+                p[3] == 'm' &&
+                is_whitespace(p[4]))
+            {
+                p = read_mtl_int(p + 4, &mtl.illum);
+            }
+            break;
+
+        case 'm':
+            p++;
+            if (p[0] == 'a' &&
+                p[1] == 'p' &&
+                p[2] == '_')
+            {
+                p += 3;
+                if (*p == 'K')
+                {
+                    p++;
+                    if (is_whitespace(p[1]))
+                    {
+                        if (*p == 'a')
+                            p = read_map(data, p + 1, e, &mtl.map_Ka);
+                        else if (*p == 'd')
+                            p = read_map(data, p + 1, e, &mtl.map_Kd);
+                        else if (*p == 's')
+                            p = read_map(data, p + 1, e, &mtl.map_Ks);
+                        else if (*p == 'e')
+                            p = read_map(data, p + 1, e, &mtl.map_Ke);
+                        else if (*p == 't')
+                            p = read_map(data, p + 1, e, &mtl.map_Kt);
+                    }
+                }
+                else if (*p == 'N')
+                {
+                    p++;
+                    if (is_whitespace(p[1]))
+                    {
+                        if (*p == 's')
+                            p = read_map(data, p + 1, e, &mtl.map_Ns);
+                        else if (*p == 'i')
+                            p = read_map(data, p + 1, e, &mtl.map_Ni);
+                    }
+                }
+                else if (*p == 'd')
+                {
+                    p++;
+                    if (is_whitespace(*p))
+                        p = read_map(data, p, e, &mtl.map_d);
+                }
+                else if ((p[0] == 'b' || p[0] == 'B') &&
+                         p[1] == 'u' &&
+                         p[2] == 'm' &&
+                         p[3] == 'p' &&
+                         is_whitespace(p[4]))
+                {
+                    p = read_map(data, p + 4, e, &mtl.map_bump);
+                }
+            }
+            break;
+
+        case '#':
+            break;
+        }
+
+        p = skip_line(p, e + 1);
+    }
+
+    /* Push final material */
+    if (mtl.name)
+        array_push(data->mesh->materials, mtl);
+
+    scratch_dealloc(contents);
+
+    return 1;
+}
+
+
+typedef struct fastObjLibrary
+{
+    struct fastObjLibrary*      next;
+
+    /* Resolved path of the .mtl file and its size/modification time when read */
+    char*                       path;
+    uint64_t                    size;
+    int64_t                     time;
+
+    /* Materials, and textures with no base path, as read_mtllib made them */
+    fastObjMesh*                mesh;
+
+    /* Loads using the library, and whether it is still in the cache */
+    unsigned int                refs;
+    int                         listed;
+
+} fastObjLibrary;
+
+
+/* Process-wide cache of .mtl files */
+static fastObjLibrary*          libraries;
+static fastObjMutex             libraries_mutex = FAST_OBJ_MUTEX_INIT;
+
+
+static
+void library_free(fastObjLibrary* library)
+{
+    fastObjArena* arena;
+
+
+    /* Cached libraries never live in a mesh arena */
+    arena = current_arena;
+    current_arena = 0;
+
+    if (library->mesh)
+        fast_obj_destroy(library->mesh);
+
+    memory_dealloc(library->path);
+    memory_dealloc(library);
+
+    current_arena = arena;
+}
+
+
+static
+void library_release(fastObjLibrary* library)
+{
+    int unused;
+
+
+    mutex_lock(&libraries_mutex);
+    library->refs--;
+    unused = !library->listed && library->refs == 0;
+    mutex_unlock(&libraries_mutex);
+
+    if (unused)
+        library_free(library);
+}
+
+
+static
+fastObjLibrary* library_find(const char* path, uint64_t size, int64_t time)
+{
+    fastObjLibrary* library;
+
+
+    /* Called with the mutex held */
+    for (library = libraries; library; library = library->next)
+    {
+        if (library->size == size && library->time == time && strcmp(library->path, path) == 0)
+        {
+            library->refs++;
+            return library;
+        }
+    }
+
+    return 0;
+}
+
+
+static
+fastObjLibrary* library_read(const char* path, uint64_t size, int64_t time, const fastObjCallbacks* callbacks, void* user_data)
+{
+    fastObjLibrary* library;
+    fastObjArena*   arena;
+    fastObjData     data;
+    void*           file;
+    int             ok;
+
+
+    arena = current_arena;
+    current_arena = 0;
+
+    library = (fastObjLibrary*)(memory_realloc(0, sizeof(fastObjLibrary)));
+    if (library)
+    {
+        library->next   = 0;
+        library->path   = string_copy(path, path + strlen(path));
+        library->size   = size;
+        library->time   = time;
+        library->mesh   = (fastObjMesh*)(memory_realloc(0, sizeof(fastObjMesh)));
+        library->refs   = 1;
+        library->listed = 0;
+    }
+
+    ok = library && library->path && library->mesh;
+    if (ok)
+    {
+        /* Only the material and texture arrays are used, with the dummy texture */
+        memset(library->mesh, 0, sizeof(fastObjMesh));
+        array_push(library->mesh->textures, map_default());
+
+        ok = !array_empty(library->mesh->textures);
+    }
+
+    /* Texture paths are left relative, each load adds its own base */
+    file = ok ? callbacks->file_open(path, user_data) : 0;
+    if (file)
+    {
+        memset(&data, 0, sizeof(data));
+        data.mesh = library->mesh;
+
+        ok = read_mtllib(&data, file, callbacks, user_data);
+
+        library->mesh->material_count = array_size(library->mesh->materials);
+        library->mesh->texture_count  = array_size(library->mesh->textures);
+
+        names_clean(&data.material_names);
+        names_clean(&data.texture_names);
+
+        callbacks->file_close(file, user_data);
+    }
+
+    current_arena = arena;
+
+    if (library && (!ok || !file))
+    {
+        library_free(library);
+        return 0;
+    }
+
+    return library;
+}
+
+
+static
+int library_apply(fastObjData* data, const fastObjMesh* library)
+{
+    fastObjMaterial mtl;
+    unsigned int*   maps;
+    unsigned int    ii;
+
+
+    /* Library texture index to mesh texture index, adding new ones as read_map would */
+    maps = (unsigned int*)(scratch_realloc(0, array_size(library->textures) * sizeof(unsigned int) + 1));
+    if (!maps)
+        return 0;
+
+    (void)(array_reserve(data->mesh->materials, array_size(library->materials)));
+
+    maps[0] = 0;
+    for (ii = 1; ii < array_size(library->textures); ii++)
+        maps[ii] = add_map(data, library->textures[ii].name, library->textures[ii].name + strlen(library->textures[ii].name));
+
+    for (ii = 0; ii < array_size(library->materials); ii++)
+    {
+        mtl = library->materials[ii];
+
+        mtl.name     = string_copy(mtl.name, mtl.name + strlen(mtl.name));
+        mtl.map_Ka   = maps[mtl.map_Ka];
+        mtl.map_Kd   = maps[mtl.map_Kd];
+        mtl.map_Ks   = maps[mtl.map_Ks];
+        mtl.map_Ke   = maps[mtl.map_Ke];
+        mtl.map_Kt   = maps[mtl.map_Kt];
+        mtl.map_Ns   = maps[mtl.map_Ns];
+        mtl.map_Ni   = maps[mtl.map_Ni];
+        mtl.map_d    = maps[mtl.map_d];
+        mtl.map_bump = maps[mtl.map_bump];
+
+        array_push(data->mesh->materials, mtl);
+    }
+
+    scratch_dealloc(maps);
+
+    return 1;
+}
+
+
+static
+int library_load(fastObjData* data, const char* path, const fastObjCallbacks* callbacks, void* user_data)
+{
+    fastObjLibrary*  library;
+    fastObjLibrary*  found;
+    fastObjLibrary*  stale;
+    fastObjLibrary** link;
+    uint64_t         size;
+    int64_t          time;
+    int              ok;
+
+
+    if (!file_stat(path, &size, &time))
+        return 0;
+
+    mutex_lock(&libraries_mutex);
+    library = library_find(path, size, time);
+    mutex_unlock(&libraries_mutex);
+
+    /* Parse outside the lock, a library read by two loads at once keeps the first */
+    if (!library)
+    {
+        library = library_read(path, size, time, callbacks, user_data);
+        if (!library)
+            return 0;
+
+        mutex_lock(&libraries_mutex);
+
+        found = library_find(path, size, time);
+        stale = 0;
+
+        if (!found)
+        {
+            /* Unlink an older version of the same file, freed now if nothing uses it */
+            for (link = &libraries; *link; link = &(*link)->next)
+            {
+                if (strcmp((*link)->path, path) == 0)
+                {
+                    stale = *link;
+                    *link = stale->next;
+                    stale->listed = 0;
+
+                    if (stale->refs > 0)
+                        stale = 0;
+
+                    break;
+                }
+            }
+
+            library->listed = 1;
+            library->next   = libraries;
+            libraries       = library;
+        }
+
+        mutex_unlock(&libraries_mutex);
+
+        /* Another load cached the same file first */
+        if (found)
+        {
+            library_free(library);
+            library = found;
+        }
+
+        if (stale)
+            library_free(stale);
+    }
+
+    ok = library_apply(data, library->mesh);
+    library_release(library);
+
+    return ok;
+}
+
+
+void fast_obj_mtl_cache_clear(void)
+{
+    fastObjLibrary* library;
+    fastObjLibrary* next;
+    fastObjLibrary* unused;
+
+
+    /* Libraries still being applied are freed when their last load is done */
+    unused = 0;
+
+    mutex_lock(&libraries_mutex);
+
+    for (library = libraries; library; library = next)
+    {
+        next = library->next;
+        library->listed = 0;
+
+        if (library->refs == 0)
+        {
+            library->next = unused;
+            unused = library;
+        }
+    }
+
+    libraries = 0;
+
+    mutex_unlock(&libraries_mutex);
+
+    for (library = unused; library; library = next)
+    {
+        next = library->next;
+        library_free(library);
+    }
+}
+
+
+static
+void load_mtllib(fastObjData* data, const char* s, const char* e, const fastObjCallbacks* callbacks, void* user_data)
+{
+    char* lib;
+    void* file;
+
+
+    lib = string_concat(data->base, s, e);
+    if (lib)
+    {
+        string_fix_separators(lib);
+
+        file = (data->mtl_cache && library_load(data, lib, callbacks, user_data)) ? 0 : callbacks->file_open(lib, user_data);
+        if (file)
+        {
+            read_mtllib(data, file, callbacks, user_data);
+            callbacks->file_close(file, user_data);
+        }
+
+        memory_dealloc(lib);
+    }
+}
+
+
+static
+const char* parse_mtllib(fastObjData* data, const char* ptr, const char* end, const fastObjCallbacks* callbacks, void* user_data)
+{
+    const char* s;
+    const char* e;
+
+
+    ptr = skip_whitespace(ptr);
+
+    s = ptr;
+    ptr = skip_name(ptr, end);
+    e = ptr;
+
+    if (data->chunked)
+        record_statement(data, s, e, 1);
+    else
+        load_mtllib(data, s, e, callbacks, user_data);
+
+    return ptr;
+}
+
+
+static
+void parse_buffer(fastObjData* data, const char* ptr, const char* end, const fastObjCallbacks* callbacks, void* user_data)
+{
+    const char* p;
+    
+    
+    p = ptr;
+    while (p != end)
+    {
+        p = skip_whitespace(p);
+
+        switch (*p)
+        {
+        case 'v':
+            p++;
+
+            switch (*p++)
+            {
+            case ' ':
+            case '\t':
+                p = parse_vertex(data, p);
+                break;
+
+            case 't':
+                if (!(data->skip & FAST_OBJ_SKIP_TEXCOORDS))
+                    p = parse_texcoord(data, p);
+                break;
+
+            case 'n':
+                if (!(data->skip & FAST_OBJ_SKIP_NORMALS))
+                    p = parse_normal(data, p);
+                break;
+
+            default:
+                p--; /* roll p++ back in case *p was a newline */
+            }
+            break;
+
+        case 'f':
+            p++;
+
+            switch (*p++)
+            {
+            case ' ':
+            case '\t':
+                p = parse_face(data, p, 0);
+                break;
+
+            default:
+                p--; /* roll p++ back in case *p was a newline */
+            }
+            break;
+
+        case 'l':
+            p++;
+
+            switch (*p++)
+            {
+            case ' ':
+            case '\t':
+                if (!(data->skip & FAST_OBJ_SKIP_LINES))
+                    p = parse_face(data, p, 1);
+                break;
+
+            default:
+                p--; /* roll p++ back in case *p was a newline */
+            }
+            break;
+
+        case 'o':
+            p++;
+
+            switch (*p++)
+            {
+            case ' ':
+            case '\t':
+                p = parse_object(data, p, end);
+                break;
+
+            default:
+                p--; /* roll p++ back in case *p was a newline */
+            }
+            break;
+
+        case 'g':
+            p++;
+
+            switch (*p++)
+            {
+            case ' ':
+            case '\t':
+                p = parse_group(data, p, end);
+                break;
+
+            default:
+                p--; /* roll p++ back in case *p was a newline */
+            }
+            break;
+
+        case 'm':
+            p++;
+            if (p[0] == 't' &&
+                p[1] == 'l' &&
+                p[2] == 'l' &&
+                p[3] == 'i' &&
+                p[4] == 'b' &&
+                is_whitespace(p[5]) &&
+                !(data->skip & FAST_OBJ_SKIP_MATERIALS))
+                p = parse_mtllib(data, p + 5, end, callbacks, user_data);
+            break;
+
+        case 'u':
+            p++;
+            if (p[0] == 's' &&
+                p[1] == 'e' &&
+                p[2] == 'm' &&
+                p[3] == 't' &&
+                p[4] == 'l' &&
+                is_whitespace(p[5]) &&
+                !(data->skip & FAST_OBJ_SKIP_MATERIALS))
+                p = parse_usemtl(data, p + 5, end);
+            break;
+
+        case '#':
+            break;
+        }
+
+        p = skip_line(p, end);
+
+        data->line++;
+    }
+    if (array_size(data->mesh->colors) > 0)
+    {
+        /* Fill the remaining slots in the colors array */
+        unsigned int ii;
+        for (ii = array_size(data->mesh->colors); ii < array_size(data->mesh->positions); ++ii)
+        {
+            array_push(data->mesh->colors, 1.0f);
+        }
+    }
+}
+
+
+static
+int progress_step(fastObjData* data, size_t bytes)
+{
+    fastObjProgress*   progress = data->progress;
+    unsigned long long done;
+    int                cancelled;
+
+
+    if (!progress)
+        return 1;
+
+    mutex_lock(&progress->mutex);
+    progress->done += bytes;
+    done      = progress->done;
+    cancelled = progress->cancelled;
+    mutex_unlock(&progress->mutex);
+
+    if (!data->report || cancelled)
+        return !cancelled;
+
+
+    /* Callbacks only run on the reporting thread, other threads see the flag */
+    if (progress->progress)
+        progress->progress(done, progress->total, progress->user_data);
+
+    if (progress->cancel && progress->cancel(progress->user_data))
+    {
+        mutex_lock(&progress->mutex);
+        progress->cancelled = 1;
+        mutex_unlock(&progress->mutex);
+        return 0;
+    }
+
+    return 1;
+}
+
+
+static
+int parse_blocks(fastObjData* data, const char* ptr, const char* end, const fastObjCallbacks* callbacks, void* user_data)
+{
+    const char* last;
+
+
+    if (!data->progress)
+    {
+        parse_buffer(data, ptr, end, callbacks, user_data);
+        return 1;
+    }
+
+
+    /* Blocks end on new lines, any padding after end also follows them */
+    while (ptr < end)
+    {
+        last = (end - ptr > BUFFER_SIZE) ? find_newline(ptr + BUFFER_SIZE, end) : end;
+        last = (last < end) ? last + 1 : end;
+
+        parse_buffer(data, ptr, last, callbacks, user_data);
+
+        if (!progress_step(data, (size_t)(last - ptr)))
+            return 0;
+
+        ptr = last;
+    }
+
+    return 1;
+}
+
+
+void fast_obj_destroy(fastObjMesh* m)
+{
+    fastObjMapping mapping;
+    unsigned int   ii;
+
+
+    /* Everything in an arena mesh, including m, is freed with the arena,
+       and a mesh loaded from a cache file lives in its mapping */
+    if (m->arena)
+    {
+        mapping = m->arena->mapping;
+        arena_destroy(m->arena);
+
+        if (mapping.data)
+            file_unmap(&mapping);
+
+        return;
+    }
+
+    for (ii = 0; ii < array_size(m->objects); ii++)
+        object_clean(&m->objects[ii]);
+
+    for (ii = 0; ii < array_size(m->groups); ii++)
+        group_clean(&m->groups[ii]);
+
+    for (ii = 0; ii < array_size(m->materials); ii++)
+        mtl_clean(&m->materials[ii]);
+
+    for (ii = 0; ii < array_size(m->textures); ii++)
+        map_clean(&m->textures[ii]);
+
+    array_clean(m->positions);
+    array_clean(m->texcoords);
+    array_clean(m->normals);
+    array_clean(m->colors);
+    array_clean(m->face_vertices);
+    array_clean(m->face_materials);
+    array_clean(m->face_lines);
+    array_clean(m->indices);
+    array_clean(m->objects);
+    array_clean(m->groups);
+    array_clean(m->materials);
+    array_clean(m->textures);
+
+    memory_dealloc(m);
+}
+
+
+fastObjMesh* fast_obj_read(const char* path)
+{
+    fastObjCallbacks callbacks;
+    callbacks.file_open = file_open;
+    callbacks.file_close = file_close;
+    callbacks.file_read = file_read;
+    callbacks.file_size = file_size;
+
+    return fast_obj_read_with_callbacks(path, &callbacks, 0);
+}
+
+
+static
+fastObjMesh* mesh_create(void)
+{
+    fastObjMesh* m;
+
+
+    /* Empty mesh */
+    m = (fastObjMesh*)(memory_realloc(0, sizeof(fastObjMesh)));
+    if (!m)
+        return 0;
+
+    m->positions      = 0;
+    m->texcoords      = 0;
+    m->normals        = 0;
+    m->colors         = 0;
+    m->face_vertices  = 0;
+    m->face_materials = 0;
+    m->face_lines     = 0;
+    m->indices        = 0;
+    m->materials      = 0;
+    m->textures       = 0;
+    m->objects        = 0;
+    m->groups         = 0;
+    m->arena          = 0;
+
+    memset(m->bounds_min, 0, sizeof(m->bounds_min));
+    memset(m->bounds_max, 0, sizeof(m->bounds_max));
+
+
+    /* Add dummy position/texcoord/normal/texture */
+    array_push(m->positions, 0.0f);
+    array_push(m->positions, 0.0f);
+    array_push(m->positions, 0.0f);
+
+    array_push(m->texcoords, 0.0f);
+    array_push(m->texcoords, 0.0f);
+
+    array_push(m->normals, 0.0f);
+    array_push(m->normals, 0.0f);
+    array_push(m->normals, 1.0f);
+
+    array_push(m->textures, map_default());
+
+    return m;
+}
+
+
+static
+void data_init(fastObjData* data, fastObjMesh* m, const char* path)
+{
+    /* Data needed during parsing */
+    data->mesh           = m;
+    data->object         = object_default();
+    data->group          = group_default();
+    data->material       = 0;
+    data->line           = 1;
+    data->base           = 0;
+    data->position_base  = 0;
+    data->texcoord_base  = 0;
+    data->normal_base    = 0;
+    data->chunked        = 0;
+    data->presize        = 0;
+    data->skip           = 0;
+    data->statements     = 0;
+    data->handlers       = 0;
+    data->handler_data   = 0;
+    data->mtl_cache      = 0;
+    data->group_bounds   = 0;
+    data->bounds_pending = 0;
+    data->progress       = 0;
+    data->report         = 0;
+
+    bounds_reset(data->bounds_min, data->bounds_max);
+
+    memset(&data->material_names, 0, sizeof(fastObjNames));
+    memset(&data->texture_names, 0, sizeof(fastObjNames));
+
+
+    /* Find base path for materials/textures */
+    if (path)
+    {
+        const char* sep1 = strrchr(path, FAST_OBJ_SEPARATOR);
+        const char* sep2 = strrchr(path, FAST_OBJ_OTHER_SEP);
+
+        /* Use the last separator in the path */
+        const char* sep = sep2 && (!sep1 || sep1 < sep2) ? sep2 : sep1;
+
+        if (sep)
+            data->base = string_substr(path, 0, sep - path + 1);
+    }
+}
+
+
+static
+void groups_bounds(fastObjGroup* groups, unsigned int count, const fastObjMesh* m, int pending)
+{
+    fastObjGroup* group;
+    fastObjUInt   p;
+    unsigned int  ii;
+    unsigned int  jj;
+
+
+    for (ii = 0; ii < count; ii++)
+    {
+        group = &groups[ii];
+
+        /* Faces using positions from later lines or other chunks */
+        if (pending)
+        {
+            bounds_reset(group->bounds_min, group->bounds_max);
+
+            for (jj = 0; jj < group->index_count; jj++)
+            {
+                p = m->indices[group->index_offset + jj].p;
+                if (p > 0 && p < m->position_count)
+                    bounds_add(group->bounds_min, group->bounds_max, m->positions + 3 * p);
+            }
+        }
+
+        if (group->bounds_min[0] > group->bounds_max[0])
+        {
+            memset(group->bounds_min, 0, 3 * sizeof(float));
+            memset(group->bounds_max, 0, 3 * sizeof(float));
+        }
+    }
+}
+
+
+static
+void mesh_finish(fastObjData* data)
+{
+    fastObjMesh* m = data->mesh;
+
+
+    /* Flush final object/group */
+    flush_object(data);
+    object_clean(&data->object);
+
+    flush_group(data);
+    group_clean(&data->group);
+
+    m->position_count = array_size(m->positions) / 3;
+    m->texcoord_count = array_size(m->texcoords) / 2;
+    m->normal_count   = array_size(m->normals) / 3;
+    m->color_count    = array_size(m->colors) / 3;
+    m->face_count     = array_size(m->face_vertices);
+    m->index_count    = array_size(m->indices);
+    m->material_count = array_size(m->materials);
+    m->texture_count  = array_size(m->textures);
+    m->object_count   = array_size(m->objects);
+    m->group_count    = array_size(m->groups);
+
+    /* Kept up to date while parsing, boxes are only missing without positions */
+    if (data->bounds_min[0] <= data->bounds_max[0])
+    {
+        memcpy(m->bounds_min, data->bounds_min, 3 * sizeof(float));
+        memcpy(m->bounds_max, data->bounds_max, 3 * sizeof(float));
+    }
+
+    groups_bounds(m->objects, m->object_count, m, data->bounds_pending);
+    groups_bounds(m->groups, m->group_count, m, data->bounds_pending);
+
+    memory_dealloc(data->base);
+    data->base = 0;
+
+    names_clean(&data->material_names);
+    names_clean(&data->texture_names);
+}
+
+
+static
+void count_lines(fastObjCounts* counts, const char* ptr, const char* end, int faces, unsigned int skip)
+{
+    const char* p;
+    const char* line;
+
+
+    /* Count lines the same way parse_buffer dispatches them */
+    p = ptr;
+    while (p != end)
+    {
+        p = skip_whitespace(p);
+
+        switch (*p)
+        {
+        case 'v':
+            switch (p[1])
+            {
+            case ' ':
+            case '\t':
+                counts->position_count++;
+                break;
+
+            case 't':
+                if (!(skip & FAST_OBJ_SKIP_TEXCOORDS))
+                    counts->texcoord_count++;
+                break;
+
+            case 'n':
+                if (!(skip & FAST_OBJ_SKIP_NORMALS))
+                    counts->normal_count++;
+                break;
+            }
+            break;
+
+        case 'f':
+        case 'l':
+            if (faces && (p[1] == ' ' || p[1] == '\t') && !(*p == 'l' && (skip & FAST_OBJ_SKIP_LINES)))
+            {
+                /* Each face vertex is one whitespace separated token */
+                line = find_newline(p, end);
+
+                counts->face_count++;
+                counts->index_count += count_tokens(p + 2, line);
+
+                p = line;
+            }
+            break;
+        }
+
+        p = skip_line(p, end);
+    }
+}
+
+
+static
+int mesh_reserve(fastObjMesh* m, const fastObjCounts* counts)
+{
+    return array_reserve(m->positions, 3 * counts->position_count) &&
+           array_reserve(m->texcoords, 2 * counts->texcoord_count) &&
+           array_reserve(m->normals, 3 * counts->normal_count) &&
+           array_reserve(m->face_vertices, counts->face_count) &&
+           array_reserve(m->face_materials, counts->face_count) &&
+           array_reserve(m->indices, counts->index_count);
+}
+
+
+static
+int parse_stream(fastObjData* data, void* file, const fastObjCallbacks* callbacks, void* user_data, fastObjCounts* counts)
+{
+    char*        buffer;
+    char*        start;
+    char*        end;
+    char*        last;
+    fastObjUInt  read;
+    fastObjUInt  bytes;
+    size_t       total;
+
+
+    /* Create buffer for reading file */
+    buffer = (char*)(scratch_realloc(0, (2 * BUFFER_SIZE + BUFFER_PADDING) * sizeof(char)));
+    if (!buffer)
+        return 0;
+
+    memset(buffer, 0, (2 * BUFFER_SIZE + BUFFER_PADDING) * sizeof(char));
+
+    start = buffer;
+    for (;;)
+    {
+        /* Read another buffer's worth from file */
+        read  = (fastObjUInt)(callbacks->file_read(file, start, BUFFER_SIZE, user_data));
+        total = read;
+        if (read == 0 && start == buffer)
+            break;
+
+
+        /* Ensure buffer ends in a newline */
+        if (read < BUFFER_SIZE)
+        {
+            if (read == 0 || start[read - 1] != '\n')
+                start[read++] = '\n';
+        }
+
+        end = start + read;
+        if (end == buffer)
+            break;
+
+
+        /* Find last new line, and check there actually is one */
+        last = (char*)(find_last_newline(buffer, end));
+        if (!last)
+            break;
+
+        last++;
+
+
+        /* Process buffer, or only count its lines */
+        if (counts)
+            count_lines(counts, buffer, last, 1, data->skip);
+        else
+            parse_buffer(data, buffer, last, callbacks, user_data);
+
+        if (!progress_step(data, total))
+        {
+            scratch_dealloc(buffer);
+            return 0;
+        }
+
+
+        /* Copy overflow for next buffer */
+        bytes = (fastObjUInt)(end - last);
+        memmove(buffer, last, bytes);
+        start = buffer + bytes;
+    }
+
+    scratch_dealloc(buffer);
+
+    return 1;
+}
+
+
+static
+void count_chunk(void* arg)
+{
+    fastObjChunk* chunk = (fastObjChunk*)(arg);
+
+    count_lines(&chunk->counts, chunk->start, chunk->end, chunk->data.presize, chunk->data.skip);
+}
+
+
+static
+void parse_chunk(void* arg)
+{
+    fastObjChunk*    chunk    = (fastObjChunk*)(arg);
+    fastObjData*     data     = &chunk->data;
+    int              presize  = data->presize;
+    unsigned int     skip     = data->skip;
+    fastObjProgress* progress = data->progress;
+    int              report   = data->report;
+
+
+    memset(&chunk->mesh, 0, sizeof(fastObjMesh));
+
+    data_init(data, &chunk->mesh, 0);
+    data->chunked       = 1;
+    data->presize       = presize;
+    data->skip          = skip;
+    data->progress      = progress;
+    data->report        = report;
+    data->position_base = chunk->position_offset;
+    data->texcoord_base = chunk->texcoord_offset;
+    data->normal_base   = chunk->normal_offset;
+
+    /* Failing to reserve only means the arrays grow as they are filled */
+    if (data->presize)
+        mesh_reserve(&chunk->mesh, &chunk->counts);
+
+    /* Material statements are deferred so callbacks are not needed */
+    parse_blocks(data, chunk->start, chunk->end, 0, 0);
+
+    /* Keep the trailing object/group, the next chunk may continue it */
+    flush_object(data);
+    flush_group(data);
+}
+
+
+static
+void merge_groups(fastObjGroup* current, fastObjGroup** groups, fastObjGroup* chunk_groups, fastObjUInt face_offset, fastObjUInt index_offset)
+{
+    fastObjUInt  ii;
+    fastObjGroup group;
+
+
+    for (ii = 0; ii < array_size(chunk_groups); ii++)
+    {
+        group = chunk_groups[ii];
+
+        /* First group continues the one open at the end of the previous chunk */
+        if (ii == 0)
+        {
+            current->face_count  += group.face_count;
+            current->index_count += group.index_count;
+            continue;
+        }
+
+        if (current->face_count > 0)
+            array_push(*groups, *current);
+        else
+            group_clean(current);
+
+        /* Names from worker threads are on the heap, move them into the arena */
+        if (current_arena && group.name)
+        {
+            current->name = string_copy(group.name, group.name + strlen(group.name));
+            memory_dealloc(group.name);
+            group.name = current->name;
+        }
+
+        *current = group;
+        current->face_offset  += face_offset;
+        current->index_offset += index_offset;
+    }
+
+    array_clean(chunk_groups);
+}
+
+
+static
+void chunk_clean(fastObjChunk* chunk)
+{
+    fastObjMesh* m = &chunk->mesh;
+    fastObjUInt  ii;
+
+
+    for (ii = 0; ii < array_size(m->objects); ii++)
+        object_clean(&m->objects[ii]);
+
+    for (ii = 0; ii < array_size(m->groups); ii++)
+        group_clean(&m->groups[ii]);
+
+    for (ii = 0; ii < array_size(chunk->data.statements); ii++)
+        memory_dealloc(chunk->data.statements[ii].name);
+
+    array_clean(m->positions);
+    array_clean(m->texcoords);
+    array_clean(m->normals);
+    array_clean(m->colors);
+    array_clean(m->face_vertices);
+    array_clean(m->face_materials);
+    array_clean(m->face_lines);
+    array_clean(m->indices);
+    array_clean(m->objects);
+    array_clean(m->groups);
+    array_clean(chunk->data.statements);
+    scratch_dealloc(chunk->materials);
+
+    memset(m, 0, sizeof(fastObjMesh));
+    chunk->data.statements = 0;
+    chunk->materials       = 0;
+}
+
+
+static
+void merge_chunk(void* arg)
+{
+    fastObjChunk* chunk = (fastObjChunk*)(arg);
+    fastObjMesh*  src   = &chunk->mesh;
+    fastObjMesh*  dst   = chunk->target;
+    fastObjUInt   faces;
+    fastObjUInt   ii;
+
+
+    faces = array_size(src->face_vertices);
+
+    if (src->positions)
+        memcpy(dst->positions + 3 * chunk->position_offset, src->positions, array_size(src->positions) * sizeof(float));
+
+    if (src->texcoords)
+        memcpy(dst->texcoords + 2 * chunk->texcoord_offset, src->texcoords, array_size(src->texcoords) * sizeof(float));
+
+    if (src->normals)
+        memcpy(dst->normals + 3 * chunk->normal_offset, src->normals, array_size(src->normals) * sizeof(float));
+
+    if (dst->colors)
+    {
+        if (src->colors)
+            memcpy(dst->colors + 3 * chunk->position_offset, src->colors, array_size(src->colors) * sizeof(float));
+        else
+            for (ii = 0; ii < 3 * chunk->counts.position_count; ii++)
+                dst->colors[3 * chunk->position_offset + ii] = 1.0f;
+    }
+
+    if (src->indices)
+        memcpy(dst->indices + chunk->index_offset, src->indices, array_size(src->indices) * sizeof(fastObjIndex));
+
+    if (src->face_vertices)
+        memcpy(dst->face_vertices + chunk->face_offset, src->face_vertices, faces * sizeof(unsigned int));
+
+    for (ii = 0; ii < faces; ii++)
+        dst->face_materials[chunk->face_offset + ii] = chunk->materials[src->face_materials[ii]];
+
+    if (dst->face_lines)
+    {
+        if (src->face_lines)
+            memcpy(dst->face_lines + chunk->face_offset, src->face_lines, faces);
+        else
+            memset(dst->face_lines + chunk->face_offset, 0, faces);
+    }
+
+    chunk_clean(chunk);
+}
+
+
+static
+int parse_chunks(fastObjData* data, const char* ptr, const char* end, unsigned int count, const fastObjCallbacks* callbacks, void* user_data)
+{
+    fastObjMesh*      m = data->mesh;
+    fastObjChunk*     chunks;
+    fastObjChunk*     chunk;
+    fastObjStatement* statement;
+    fastObjArena*     arena;
+    const char*       p;
+    fastObjUInt       positions;
+    fastObjUInt       texcoords;
+    fastObjUInt       normals;
+    fastObjUInt       faces;
+    fastObjUInt       indices;
+    int               colors;
+    int               lines;
+    int               ok;
+    unsigned int      ii;
+    fastObjUInt       jj;
+
+
+    chunks = (fastObjChunk*)(scratch_realloc(0, count * sizeof(fastObjChunk)));
+    if (!chunks)
+        return 0;
+
+
+    /* Split into chunks ending on new lines */
+    p = ptr;
+    for (ii = 0; ii < count; ii++)
+    {
+        chunk = &chunks[ii];
+        memset(chunk, 0, sizeof(fastObjChunk));
+
+        chunk->start = p;
+        if (ii + 1 < count)
+        {
+            p = ptr + (size_t)(end - ptr) * (ii + 1) / count;
+            if (p < chunk->start)
+                p = chunk->start;
+            while (p < end && !is_newline(*p))
+                p++;
+            if (p < end)
+                p++;
+        }
+        else
+        {
+            p = end;
+        }
+        chunk->end           = p;
+        chunk->target        = m;
+        chunk->data.presize  = data->presize;
+        chunk->data.skip     = data->skip;
+        chunk->data.progress = data->progress;
+        chunk->data.report   = data->report && ii == 0;
+    }
+
+
+    /* Chunk faces use positions from other chunks, so boxes are found after merging */
+    data->bounds_pending |= data->group_bounds;
+
+
+    /* Vertex counts give each chunk the base for its relative indices */
+    run_tasks(count_chunk, chunks, sizeof(fastObjChunk), count);
+
+    positions = array_size(m->positions) / 3;
+    texcoords = array_size(m->texcoords) / 2;
+    normals   = array_size(m->normals) / 3;
+    for (ii = 0; ii < count; ii++)
+    {
+        chunk = &chunks[ii];
+        chunk->position_offset = positions;
+        chunk->texcoord_offset = texcoords;
+        chunk->normal_offset   = normals;
+        positions += chunk->counts.position_count;
+        texcoords += chunk->counts.texcoord_count;
+        normals   += chunk->counts.normal_count;
+    }
+
+    /* Chunk output is temporary, keep it out of the arena when parsed on this thread */
+    arena = current_arena;
+    current_arena = 0;
+
+    run_tasks(parse_chunk, chunks, sizeof(fastObjChunk), count);
+
+    current_arena = arena;
+
+
+    /* Resolve materials and objects/groups in file order */
+    ok      = !data->progress || !data->progress->cancelled;
+    faces   = 0;
+    indices = 0;
+    colors  = 0;
+    lines   = 0;
+    for (ii = 0; ok && ii < count; ii++)
+    {
+        chunk = &chunks[ii];
+
+        chunk->face_offset  = faces;
+        chunk->index_offset = indices;
+
+        if (!array_empty(chunk->mesh.positions))
+        {
+            bounds_add(data->bounds_min, data->bounds_max, chunk->data.bounds_min);
+            bounds_add(data->bounds_min, data->bounds_max, chunk->data.bounds_max);
+        }
+        faces   += array_size(chunk->mesh.face_vertices);
+        indices += array_size(chunk->mesh.indices);
+        colors  |= !array_empty(chunk->mesh.colors);
+        lines   |= !array_empty(chunk->mesh.face_lines);
+
+        chunk->materials = (fastObjUInt*)(scratch_realloc(0, (array_size(chunk->data.statements) + 1) * sizeof(fastObjUInt)));
+        if (!chunk->materials)
+        {
+            ok = 0;
+            break;
+        }
+
+        chunk->materials[0] = data->material;
+        for (jj = 0; jj < array_size(chunk->data.statements); jj++)
+        {
+            statement = &chunk->data.statements[jj];
+            if (statement->library)
+                load_mtllib(data, statement->name, statement->name + strlen(statement->name), callbacks, user_data);
+            else
+                use_material(data, statement->name, statement->name + strlen(statement->name));
+
+            chunk->materials[jj + 1] = data->material;
+        }
+
+        merge_groups(&data->object, &m->objects, chunk->mesh.objects, chunk->face_offset, chunk->index_offset);
+        merge_groups(&data->group, &m->groups, chunk->mesh.groups, chunk->face_offset, chunk->index_offset);
+        chunk->mesh.objects = 0;
+        chunk->mesh.groups  = 0;
+    }
+
+
+    /* Size merged arrays once, then copy chunk output in parallel */
+    if (ok)
+    {
+        if (colors)
+            ok = ok && array_reserve(m->colors, 3 * positions);
+        if (lines)
+            ok = ok && array_reserve(m->face_lines, faces);
+
+        ok = ok &&
+             array_reserve(m->positions, 3 * positions - array_size(m->positions)) &&
+             array_reserve(m->texcoords, 2 * texcoords - array_size(m->texcoords)) &&
+             array_reserve(m->normals, 3 * normals - array_size(m->normals)) &&
+             array_reserve(m->face_vertices, faces) &&
+             array_reserve(m->face_materials, faces) &&
+             array_reserve(m->indices, indices);
+    }
+
+    if (ok)
+    {
+        /* Colors of vertices before the first chunk (the dummy) default to white */
+        if (colors)
+            for (jj = 0; jj < array_size(m->positions); jj++)
+                m->colors[jj] = 1.0f;
+
+        run_tasks(merge_chunk, chunks, sizeof(fastObjChunk), count);
+
+        if (colors)
+            _array_size(m->colors) = 3 * positions;
+        if (lines)
+            _array_size(m->face_lines) = faces;
+
+        _array_size(m->positions)      = 3 * positions;
+        _array_size(m->texcoords)      = 2 * texcoords;
+        _array_size(m->normals)        = 3 * normals;
+        _array_size(m->face_vertices)  = faces;
+        _array_size(m->face_materials) = faces;
+        _array_size(m->indices)        = indices;
+    }
+
+
+    /* Clean up (merged chunks are already empty) */
+    for (ii = 0; ii < count; ii++)
+        chunk_clean(&chunks[ii]);
+
+    scratch_dealloc(chunks);
+
+    return ok;
+}
+
+
+static
+unsigned int chunk_count(unsigned int threads, size_t size)
+{
+    /* Only split files big enough to give each thread a useful amount of work */
+    if (threads > size / MIN_CHUNK_SIZE)
+        threads = (unsigned int)(size / MIN_CHUNK_SIZE);
+
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+
+    return threads;
+}
+
+
+static
+int parse_memory(fastObjData* data, const char* ptr, size_t size, unsigned int threads, const fastObjCallbacks* callbacks, void* user_data)
+{
+    const char*   end;
+    const char*   last;
+    char*         tail;
+    size_t        bytes;
+    fastObjCounts counts;
+    int           ok;
+
+
+    /* Parse in place up to the last new line followed by enough padding */
+    end  = ptr + size;
+    last = (size > BUFFER_PADDING) ? find_last_newline(ptr, end - BUFFER_PADDING) : 0;
+    last = last ? last + 1 : ptr;
+
+    ok = 1;
+    if (last > ptr)
+    {
+        threads = chunk_count(threads, (size_t)(last - ptr));
+        if (threads > 1)
+        {
+            ok = parse_chunks(data, ptr, last, threads, callbacks, user_data);
+        }
+        else
+        {
+            if (data->presize)
+            {
+                memset(&counts, 0, sizeof(counts));
+                count_lines(&counts, ptr, last, 1, data->skip);
+                ok = mesh_reserve(data->mesh, &counts);
+            }
+
+            ok = ok && parse_blocks(data, ptr, last, callbacks, user_data);
+        }
+    }
+
+
+    /* Final lines are copied to add a new line and padding */
+    bytes = (size_t)(end - last);
+    if (ok && bytes > 0)
+    {
+        tail = (char*)(scratch_realloc(0, bytes + 1 + BUFFER_PADDING));
+        if (!tail)
+            return 0;
+
+        memcpy(tail, last, bytes);
+        tail[bytes] = '\n';
+        memset(tail + bytes + 1, 0, BUFFER_PADDING);
+
+        parse_buffer(data, tail, tail + bytes + 1, callbacks, user_data);
+
+        scratch_dealloc(tail);
+    }
+
+    /* The tail, and the last report when other threads parsed chunks */
+    return ok && progress_step(data, bytes);
+}
+
+
+fastObjReadOptions fast_obj_read_options_default(void)
+{
+    fastObjReadOptions options;
+
+    options.thread_count  = 1;
+    options.presize       = 0;
+    options.arena         = 0;
+    options.mtl_cache     = 0;
+    options.group_bounds  = 0;
+    options.skip          = 0;
+    options.progress      = 0;
+    options.cancel        = 0;
+    options.progress_data = 0;
+
+    return options;
+}
+
+
+fastObjMesh* fast_obj_read_with_callbacks(const char* path, const fastObjCallbacks* callbacks, void* user_data)
+{
+    fastObjReadOptions options = fast_obj_read_options_default();
+
+    /* Check if callbacks are valid */
+    if (!callbacks)
+        return 0;
+
+    return fast_obj_read_with_options(path, callbacks, user_data, &options);
+}
+
+
+static
+fastObjMesh* read_mesh(const char* path, const fastObjCallbacks* callbacks, void* user_data, const fastObjReadOptions* options, fastObjProgress* progress)
+{
+    fastObjCallbacks default_callbacks;
+    fastObjCallbacks gzip_callbacks;
+    fastObjMapping   map;
+    fastObjData      data;
+    fastObjCounts    counts;
+    fastObjMesh*     m;
+    void*            file;
+    unsigned int     threads;
+    char*            contents;
+    size_t           size;
+    int              mapped;
+    int              ok;
+
+
+    default_callbacks.file_open  = file_open;
+    default_callbacks.file_close = file_close;
+    default_callbacks.file_read  = file_read;
+    default_callbacks.file_size  = file_size;
+
+    threads = options ? options->thread_count : 1;
+    if (threads == 0)
+        threads = thread_count_default();
+
+
+    /* Without callbacks, parse files straight out of the page cache */
+    mapped = !callbacks && file_map(&map, path, 0);
+
+    /* Except gzip files, which are inflated on a second thread a block at a
+       time as the parser reads them */
+    if (mapped && gzip_magic(map.data, map.size))
+    {
+        file_unmap(&map);
+
+        gzip_callbacks = fast_obj_gzip_callbacks();
+        callbacks      = &gzip_callbacks;
+        threads        = 1;
+        mapped         = 0;
+    }
+
+    if (mapped)
+    {
+        m = mesh_create();
+        if (!m)
+        {
+            file_unmap(&map);
+            return 0;
+        }
+
+        data_init(&data, m, path);
+        data.presize      = options ? options->presize || options->arena : 0;
+        data.mtl_cache    = options ? options->mtl_cache : 0;
+        data.group_bounds = options ? options->group_bounds : 0;
+        data.skip         = options ? options->skip : 0;
+        data.progress     = progress;
+        data.report       = 1;
+
+        if (progress)
+            progress->total = map.size;
+
+        ok = parse_memory(&data, map.data, map.size, threads, &default_callbacks, 0);
+        mesh_finish(&data);
+
+        file_unmap(&map);
+    }
+    else
+    {
+        /* Files that can't be mapped are read from disk */
+        if (!callbacks)
+            callbacks = &default_callbacks;
+
+        /* Open file */
+        file = callbacks->file_open(path, user_data);
+        if (!file)
+            return 0;
+
+        m = mesh_create();
+        if (!m)
+        {
+            callbacks->file_close(file, user_data);
+            return 0;
+        }
+
+        data_init(&data, m, path);
+        data.presize      = options ? options->presize || options->arena : 0;
+        data.mtl_cache    = options ? options->mtl_cache : 0;
+        data.group_bounds = options ? options->group_bounds : 0;
+        data.skip         = options ? options->skip : 0;
+        data.progress     = progress;
+        data.report       = 1;
+
+        if (threads > 1 && chunk_count(threads, callbacks->file_size(file, user_data)) > 1)
+        {
+            contents = read_file(file, callbacks, user_data, &size);
+
+            if (progress && contents)
+                progress->total = size;
+
+            ok = contents && parse_memory(&data, contents, size, threads, callbacks, user_data);
+            scratch_dealloc(contents);
+        }
+        else
+        {
+            ok = 1;
+
+            /* A counting pass reads the file twice */
+            if (progress)
+                progress->total = (unsigned long long)(callbacks->file_size(file, user_data)) * (data.presize ? 2 : 1);
+
+            /* Count the file, then reopen it to parse into the reserved arrays */
+            if (data.presize)
+            {
+                memset(&counts, 0, sizeof(counts));
+                ok = parse_stream(&data, file, callbacks, user_data, &counts) &&
+                     mesh_reserve(m, &counts);
+
+                callbacks->file_close(file, user_data);
+                file = callbacks->file_open(path, user_data);
+                if (!file)
+                {
+                    mesh_finish(&data);
+                    fast_obj_destroy(m);
+                    return 0;
+                }
+            }
+
+            ok = ok && parse_stream(&data, file, callbacks, user_data, 0);
+
+            /* The parser also stops at the short read a damaged gzip file ends with */
+            ok = ok && !(callbacks->file_read == gzip_read && gzip_failed(file));
+        }
+
+        mesh_finish(&data);
+
+        callbacks->file_close(file, user_data);
+    }
+
+    if (!ok)
+    {
+        fast_obj_destroy(m);
+        return 0;
+    }
+
+    return m;
+}
+
+
+static
+fastObjMesh* read_progress(const char* path, const fastObjCallbacks* callbacks, void* user_data, const fastObjReadOptions* options)
+{
+    fastObjProgress progress;
+    fastObjMesh*    m;
+
+
+    if (!options || (!options->progress && !options->cancel))
+        return read_mesh(path, callbacks, user_data, options, 0);
+
+    progress.progress  = options->progress;
+    progress.cancel    = options->cancel;
+    progress.user_data = options->progress_data;
+    progress.done      = 0;
+    progress.total     = 0;
+    progress.cancelled = 0;
+
+    mutex_init(&progress.mutex);
+
+    m = read_mesh(path, callbacks, user_data, options, &progress);
+
+    mutex_destroy(&progress.mutex);
+
+    return m;
+}
+
+
+fastObjMesh* fast_obj_read_with_options(const char* path, const fastObjCallbacks* callbacks, void* user_data, const fastObjReadOptions* options)
+{
+    fastObjArena* arena;
+    fastObjArena* previous;
+    fastObjMesh*  m;
+
+
+    if (!options || !options->arena)
+        return read_progress(path, callbacks, user_data, options);
+
+
+    /* Route every allocation made on this thread during the read to a new arena */
+    arena = arena_create();
+    if (!arena)
+        return 0;
+
+    previous = current_arena;
+    current_arena = arena;
+
+    m = read_progress(path, callbacks, user_data, options);
+
+    current_arena = previous;
+
+    if (!m)
+    {
+        arena_destroy(arena);
+        return 0;
+    }
+
+    m->arena = arena;
+
+    return m;
+}
+
+
+fastObjMesh* fast_obj_read_mapped(const char* path)
+{
+    fastObjReadOptions options = fast_obj_read_options_default();
+
+    return fast_obj_read_with_options(path, 0, 0, &options);
+}
+
+
+fastObjMesh* fast_obj_read_with_flags(const char* path, unsigned int flags)
+{
+    fastObjReadOptions options = fast_obj_read_options_default();
+
+    options.skip = flags;
+
+    return fast_obj_read_with_options(path, 0, 0, &options);
+}
+
+
+struct fastObjParser
+{
+    /* Parse state and the vertex data/materials parsed so far */
+    fastObjData                 data;
+
+    /* Used for mtllib files */
+    fastObjCallbacks            file_callbacks;
+
+    /* Start of a line split between calls to feed, with padding */
+    char*                       carry;
+    size_t                      carry_size;
+    size_t                      carry_capacity;
+
+    int                         finished;
+};
+
+
+static
+int parser_carry(fastObjParser* parser, const char* ptr, size_t bytes)
+{
+    size_t capacity;
+    char*  carry;
+
+
+    /* Keep padding zeroed past the end for parse_buffer */
+    if (parser->carry_size + bytes + 1 + BUFFER_PADDING > parser->carry_capacity)
+    {
+        capacity = 2 * parser->carry_capacity;
+        if (capacity < parser->carry_size + bytes + 1 + BUFFER_PADDING)
+            capacity = parser->carry_size + bytes + 1 + BUFFER_PADDING;
+
+        carry = (char*)(scratch_realloc(parser->carry, capacity));
+        if (!carry)
+            return 0;
+
+        parser->carry          = carry;
+        parser->carry_capacity = capacity;
+    }
+
+    memcpy(parser->carry + parser->carry_size, ptr, bytes);
+    parser->carry_size += bytes;
+
+    memset(parser->carry + parser->carry_size, 0, 1 + BUFFER_PADDING);
+
+    return 1;
+}
+
+
+static
+void parser_flush(fastObjParser* parser)
+{
+    parse_buffer(&parser->data, parser->carry, parser->carry + parser->carry_size, &parser->file_callbacks, 0);
+    parser->carry_size = 0;
+}
+
+
+fastObjParser* fast_obj_parser_create(const char* path, const fastObjParserCallbacks* callbacks, void* user_data)
+{
+    fastObjParser* parser;
+    fastObjMesh*   m;
+
+
+    parser = (fastObjParser*)(memory_realloc(0, sizeof(fastObjParser)));
+    if (!parser)
+        return 0;
+
+    m = mesh_create();
+    if (!m)
+    {
+        memory_dealloc(parser);
+        return 0;
+    }
+
+    /* Path is only used to find material libraries */
+    data_init(&parser->data, m, path);
+    parser->data.handlers     = callbacks;
+    parser->data.handler_data = user_data;
+
+    parser->file_callbacks.file_open  = file_open;
+    parser->file_callbacks.file_close = file_close;
+    parser->file_callbacks.file_read  = file_read;
+    parser->file_callbacks.file_size  = file_size;
+
+    parser->carry          = 0;
+    parser->carry_size     = 0;
+    parser->carry_capacity = 0;
+    parser->finished       = 0;
+
+    return parser;
+}
+
+
+int fast_obj_parser_feed(fastObjParser* parser, const void* data, size_t bytes)
+{
+    const char* ptr;
+    const char* end;
+    const char* last;
+
+
+    ptr = (const char*)(data);
+    end = ptr + bytes;
+
+    /* Complete a line left over from the previous call */
+    if (parser->carry_size > 0)
+    {
+        last = find_newline(ptr, end);
+        if (last == end)
+            return parser_carry(parser, ptr, bytes);
+
+        if (!parser_carry(parser, ptr, (size_t)(last + 1 - ptr)))
+            return 0;
+
+        parser_flush(parser);
+        ptr = last + 1;
+    }
+
+    /* Parse in place up to the last new line followed by enough padding */
+    last = (end - ptr > BUFFER_PADDING) ? find_last_newline(ptr, end - BUFFER_PADDING) : 0;
+    if (last)
+    {
+        parse_buffer(&parser->data, ptr, last + 1, &parser->file_callbacks, 0);
+        ptr = last + 1;
+    }
+
+    return parser_carry(parser, ptr, (size_t)(end - ptr));
+}
+
+
+int fast_obj_parser_finish(fastObjParser* parser)
+{
+    static const char newline = '\n';
+
+
+    if (parser->finished)
+        return 1;
+
+    /* Last line may not end in a new line */
+    if (parser->carry_size > 0)
+    {
+        if (!parser_carry(parser, &newline, 1))
+            return 0;
+
+        parser_flush(parser);
+    }
+
+    mesh_finish(&parser->data);
+    parser->finished = 1;
+
+    return 1;
+}
+
+
+const fastObjMesh* fast_obj_parser_mesh(const fastObjParser* parser)
+{
+    /* Face arrays are always empty, counts are set by fast_obj_parser_finish */
+    return parser->data.mesh;
+}
+
+
+void fast_obj_parser_destroy(fastObjParser* parser)
+{
+    if (!parser->finished)
+        mesh_finish(&parser->data);
+
+    fast_obj_destroy(parser->data.mesh);
+
+    scratch_dealloc(parser->carry);
+    memory_dealloc(parser);
+}
+
+
+typedef struct
+{
+    /* Corners of a polygon not yet cut off, and the triangles cut so far */
+    unsigned int*               ring;
+    const float**               points;
+    unsigned int*               triangles;
+    unsigned int                capacity;
+
+} fastObjPolygon;
+
+
+static
+void polygon_clean(fastObjPolygon* polygon)
+{
+    scratch_dealloc(polygon->ring);
+    scratch_dealloc((void*)(polygon->points));
+    scratch_dealloc(polygon->triangles);
+}
+
+
+static
+float polygon_turn(const float* a, const float* b, const float* c, const float* n)
+{
+    float u[3];
+    float v[3];
+
+
+    /* Positive when a, b, c go counter-clockwise around n */
+    u[0] = b[0] - a[0];
+    u[1] = b[1] - a[1];
+    u[2] = b[2] - a[2];
+
+    v[0] = c[0] - b[0];
+    v[1] = c[1] - b[1];
+    v[2] = c[2] - b[2];
+
+    return n[0] * (u[1] * v[2] - u[2] * v[1])
+         + n[1] * (u[2] * v[0] - u[0] * v[2])
+         + n[2] * (u[0] * v[1] - u[1] * v[0]);
+}
+
+
+static
+int polygon_ear(const fastObjPolygon* polygon, unsigned int size, unsigned int k, const float** points, const float* n)
+{
+    const float* a;
+    const float* b;
+    const float* c;
+    const float* p;
+    unsigned int ii;
+
+
+    a = points[polygon->ring[(k + size - 1) % size]];
+    b = points[polygon->ring[k]];
+    c = points[polygon->ring[(k + 1) % size]];
+
+    if (polygon_turn(a, b, c, n) <= 0.0f)
+        return 0;
+
+    /* No other corner may lie inside the triangle, corners repeated by a
+       bridge to a hole are allowed to touch it */
+    for (ii = 0; ii < size; ii++)
+    {
+        p = points[polygon->ring[ii]];
+
+        if (memcmp(p, a, 3 * sizeof(float)) == 0 ||
+            memcmp(p, b, 3 * sizeof(float)) == 0 ||
+            memcmp(p, c, 3 * sizeof(float)) == 0)
+            continue;
+
+        if (polygon_turn(a, b, p, n) >= 0.0f &&
+            polygon_turn(b, c, p, n) >= 0.0f &&
+            polygon_turn(c, a, p, n) >= 0.0f)
+            return 0;
+    }
+
+    return 1;
+}
+
+
+static
+const unsigned int* polygon_triangulate(fastObjPolygon* polygon, const fastObjMesh* mesh, const fastObjIndex* face, unsigned int fv)
+{
+    static const unsigned int triangle[3] = { 0, 1, 2 };
+    static const unsigned int quads[2][6] = { { 0, 1, 2, 0, 2, 3 }, { 1, 2, 3, 1, 3, 0 } };
+
+    const float** points;
+    const float*  a;
+    const float*  b;
+    float         n[3];
+    unsigned int* out;
+    unsigned int  size;
+    unsigned int  misses;
+    unsigned int  ii;
+    unsigned int  k;
+
+
+    /* Returns fv - 2 triangles as corner numbers of the face, or 0 when out of memory */
+    if (fv == 3)
+        return triangle;
+
+    if (fv == 4)
+    {
+        /* Normal of a quad is the cross product of its diagonals, and only a
+           reflex second or fourth corner puts the 0-2 diagonal outside it */
+        const float* p0 = mesh->positions + 3 * face[0].p;
+        const float* p1 = mesh->positions + 3 * face[1].p;
+        const float* p2 = mesh->positions + 3 * face[2].p;
+        const float* p3 = mesh->positions + 3 * face[3].p;
+
+        n[0] = (p2[1] - p0[1]) * (p3[2] - p1[2]) - (p2[2] - p0[2]) * (p3[1] - p1[1]);
+        n[1] = (p2[2] - p0[2]) * (p3[0] - p1[0]) - (p2[0] - p0[0]) * (p3[2] - p1[2]);
+        n[2] = (p2[0] - p0[0]) * (p3[1] - p1[1]) - (p2[1] - p0[1]) * (p3[0] - p1[0]);
+
+        if (polygon_turn(p0, p1, p2, n) < 0.0f || polygon_turn(p2, p3, p0, n) < 0.0f)
+            return quads[1];
+
+        return quads[0];
+    }
+
+
+    if (fv > polygon->capacity)
+    {
+        unsigned int* ring;
+        const float** positions;
+        unsigned int* triangles;
+
+        ring = (unsigned int*)(scratch_realloc(polygon->ring, fv * sizeof(unsigned int)));
+        if (ring)
+            polygon->ring = ring;
+
+        positions = (const float**)(scratch_realloc((void*)(polygon->points), fv * sizeof(const float*)));
+        if (positions)
+            polygon->points = positions;
+
+        triangles = (unsigned int*)(scratch_realloc(polygon->triangles, 3 * (fv - 2) * sizeof(unsigned int)));
+        if (triangles)
+            polygon->triangles = triangles;
+
+        if (!ring || !positions || !triangles)
+            return 0;
+
+        polygon->capacity = fv;
+    }
+
+    points = polygon->points;
+    out    = polygon->triangles;
+
+    for (ii = 0; ii < fv; ii++)
+        points[ii] = mesh->positions + 3 * face[ii].p;
+
+    /* Newell's method gives a normal for any simple polygon, planar or not */
+    n[0] = 0.0f;
+    n[1] = 0.0f;
+    n[2] = 0.0f;
+
+    for (ii = 0; ii < fv; ii++)
+    {
+        a = points[ii];
+        b = points[(ii + 1) % fv];
+
+        n[0] += (a[1] - b[1]) * (a[2] + b[2]);
+        n[1] += (a[2] - b[2]) * (a[0] + b[0]);
+        n[2] += (a[0] - b[0]) * (a[1] + b[1]);
+    }
+
+    for (ii = 0; ii < fv; ii++)
+        if (polygon_turn(points[(ii + fv - 1) % fv], points[ii], points[(ii + 1) % fv], n) < 0.0f)
+            break;
+
+    /* Convex faces are fans */
+    if (ii == fv)
+    {
+        for (ii = 2; ii < fv; ii++)
+        {
+            *out++ = 0;
+            *out++ = ii - 1;
+            *out++ = ii;
+        }
+
+        return polygon->triangles;
+    }
+
+
+    /* Concave faces lose one ear at a time, a face with no ear left
+       (self intersecting or degenerate) loses the next corner anyway */
+    for (ii = 0; ii < fv; ii++)
+        polygon->ring[ii] = ii;
+
+    size   = fv;
+    misses = 0;
+    k      = 0;
+
+    while (size > 3)
+    {
+        if (misses < size && !polygon_ear(polygon, size, k, points, n))
+        {
+            k = (k + 1) % size;
+            misses++;
+            continue;
+        }
+
+        *out++ = polygon->ring[(k + size - 1) % size];
+        *out++ = polygon->ring[k];
+        *out++ = polygon->ring[(k + 1) % size];
+
+        memmove(polygon->ring + k, polygon->ring + k + 1, (size - k - 1) * sizeof(unsigned int));
+        size--;
+
+        if (k == size)
+            k = 0;
+
+        misses = 0;
+    }
+
+    *out++ = polygon->ring[0];
+    *out++ = polygon->ring[1];
+    *out++ = polygon->ring[2];
+
+    return polygon->triangles;
+}
+
+
+typedef struct
+{
+    const fastObjMesh*          mesh;
+
+    /* Arrays replacing the mesh face and index arrays */
+    unsigned int*               face_vertices;
+    unsigned int*               face_materials;
+    unsigned char*              face_lines;
+    fastObjIndex*               indices;
+
+    /* Faces handled by this task, where their corners start, and where
+       their triangles go */
+    fastObjUInt                 face_begin;
+    fastObjUInt                 face_end;
+    fastObjUInt                 corner_offset;
+    fastObjUInt                 face_offset;
+    fastObjUInt                 index_offset;
+
+    fastObjPolygon              polygon;
+
+    int                         ok;
+
+} fastObjTriangulateTask;
+
+
+static
+void triangulate_faces(void* arg)
+{
+    fastObjTriangulateTask* task = (fastObjTriangulateTask*)(arg);
+    const fastObjMesh*      m    = task->mesh;
+    const fastObjIndex*     corners;
+    const unsigned int*     triangles;
+    fastObjUInt             face;
+    fastObjUInt             faces;
+    fastObjUInt             index;
+    unsigned int            material;
+    unsigned int            fv;
+    unsigned int            jj;
+    unsigned char           line;
+
+
+    corners = m->indices + task->corner_offset;
+    faces   = task->face_offset;
+    index   = task->index_offset;
+
+    for (face = task->face_begin; face < task->face_end; face++)
+    {
+        fv       = m->face_vertices[face];
+        material = m->face_materials[face];
+        line     = (face < array_size(m->face_lines)) ? m->face_lines[face] : 0;
+
+        /* Points and lines are kept as they are */
+        if (fv < 3)
+        {
+            task->face_vertices[faces]  = fv;
+            task->face_materials[faces] = material;
+            if (task->face_lines)
+                task->face_lines[faces] = line;
+
+            memcpy(task->indices + index, corners, fv * sizeof(fastObjIndex));
+
+            faces++;
+            index += fv;
+        }
+        else
+        {
+            triangles = polygon_triangulate(&task->polygon, m, corners, fv);
+            if (!triangles)
+                return;
+
+            for (jj = 0; jj < fv - 2; jj++)
+            {
+                task->face_vertices[faces]  = 3;
+                task->face_materials[faces] = material;
+                if (task->face_lines)
+                    task->face_lines[faces] = line;
+
+                task->indices[index + 0] = corners[triangles[3 * jj + 0]];
+                task->indices[index + 1] = corners[triangles[3 * jj + 1]];
+                task->indices[index + 2] = corners[triangles[3 * jj + 2]];
+
+                faces++;
+                index += 3;
+            }
+        }
+
+        corners += fv;
+    }
+
+    task->ok = 1;
+}
+
+
+static
+void triangulate_groups(fastObjGroup* groups, unsigned int count, const unsigned int* face_vertices)
+{
+    fastObjUInt  face;
+    fastObjUInt  faces;
+    fastObjUInt  index;
+    fastObjUInt  end;
+    unsigned int fv;
+    unsigned int ii;
+
+
+    /* Groups hold runs of faces in file order, so a single walk over the
+       faces finds where each one starts and ends after triangulation */
+    face  = 0;
+    faces = 0;
+    index = 0;
+
+    for (ii = 0; ii < count; ii++)
+    {
+        if (groups[ii].face_offset < face)
+        {
+            face  = 0;
+            faces = 0;
+            index = 0;
+        }
+
+        end = groups[ii].face_offset + groups[ii].face_count;
+
+        for (; face < groups[ii].face_offset; face++)
+        {
+            fv     = face_vertices[face];
+            faces += (fv < 3) ? 1 : fv - 2;
+            index += (fv < 3) ? fv : 3 * (fv - 2);
+        }
+
+        groups[ii].face_offset  = faces;
+        groups[ii].index_offset = index;
+
+        for (; face < end; face++)
+        {
+            fv     = face_vertices[face];
+            faces += (fv < 3) ? 1 : fv - 2;
+            index += (fv < 3) ? fv : 3 * (fv - 2);
+        }
+
+        groups[ii].face_count  = faces - groups[ii].face_offset;
+        groups[ii].index_count = index - groups[ii].index_offset;
+    }
+}
+
+
+int fast_obj_triangulate(fastObjMesh* mesh, unsigned int thread_count)
+{
+    fastObjTriangulateTask tasks[MAX_THREADS];
+    fastObjTriangulateTask result;
+    fastObjArena*          arena;
+    uint64_t               faces;
+    uint64_t               index;
+    fastObjUInt            corner;
+    fastObjUInt            face;
+    unsigned int           count;
+    unsigned int           fv;
+    unsigned int           ii;
+    int                    ok;
+
+
+    if (mesh->face_count == 0)
+        return 1;
+
+    /* Split big meshes between threads by face */
+    count = thread_count ? thread_count : thread_count_default();
+    if (count > mesh->face_count / MIN_TRIANGULATE_FACES)
+        count = mesh->face_count / MIN_TRIANGULATE_FACES;
+    if (count > MAX_THREADS)
+        count = MAX_THREADS;
+    if (count < 1)
+        count = 1;
+
+    memset(tasks, 0, sizeof(tasks));
+    for (ii = 0; ii < count; ii++)
+    {
+        tasks[ii].mesh       = mesh;
+        tasks[ii].face_begin = (fastObjUInt)((uint64_t)(mesh->face_count) * ii / count);
+        tasks[ii].face_end   = (fastObjUInt)((uint64_t)(mesh->face_count) * (ii + 1) / count);
+    }
+
+
+    /* Where each task's corners start, and where its triangles go */
+    faces  = 0;
+    index  = 0;
+    corner = 0;
+    ii     = 0;
+    for (face = 0; face < mesh->face_count; face++)
+    {
+        while (ii < count && tasks[ii].face_begin == face)
+        {
+            tasks[ii].corner_offset = corner;
+            tasks[ii].face_offset   = (fastObjUInt)(faces);
+            tasks[ii].index_offset  = (fastObjUInt)(index);
+            ii++;
+        }
+
+        fv      = mesh->face_vertices[face];
+        faces  += (fv < 3) ? 1 : fv - 2;
+        index  += (fv < 3) ? fv : 3 * (fv - 2);
+        corner += fv;
+    }
+
+    if (faces > (unsigned int)(-1) || index > (unsigned int)(-1))
+        return 0;
+
+
+    /* New arrays come from the same place as the ones they replace */
+    arena = current_arena;
+    current_arena = mesh->arena;
+
+    memset(&result, 0, sizeof(result));
+
+    ok = array_reserve(result.face_vertices, (fastObjUInt)(faces)) &&
+         array_reserve(result.face_materials, (fastObjUInt)(faces)) &&
+         array_reserve(result.indices, (fastObjUInt)(index));
+
+    if (ok && mesh->face_lines)
+        ok = array_reserve(result.face_lines, (fastObjUInt)(faces));
+
+    if (ok)
+    {
+        for (ii = 0; ii < count; ii++)
+        {
+            tasks[ii].face_vertices  = result.face_vertices;
+            tasks[ii].face_materials = result.face_materials;
+            tasks[ii].face_lines     = result.face_lines;
+            tasks[ii].indices        = result.indices;
+        }
+
+        current_arena = 0;
+        run_tasks(triangulate_faces, tasks, sizeof(fastObjTriangulateTask), count);
+        current_arena = mesh->arena;
+
+        for (ii = 0; ii < count; ii++)
+            ok = ok && tasks[ii].ok;
+    }
+
+    for (ii = 0; ii < count; ii++)
+        polygon_clean(&tasks[ii].polygon);
+
+    if (!ok)
+    {
+        array_clean(result.face_vertices);
+        array_clean(result.face_materials);
+        array_clean(result.face_lines);
+        array_clean(result.indices);
+
+        current_arena = arena;
+        return 0;
+    }
+
+
+    triangulate_groups(mesh->objects, mesh->object_count, mesh->face_vertices);
+    triangulate_groups(mesh->groups, mesh->group_count, mesh->face_vertices);
+
+    array_clean(mesh->face_vertices);
+    array_clean(mesh->face_materials);
+    array_clean(mesh->face_lines);
+    array_clean(mesh->indices);
+
+    _array_size(result.face_vertices)  = (fastObjUInt)(faces);
+    _array_size(result.face_materials) = (fastObjUInt)(faces);
+    _array_size(result.indices)        = (fastObjUInt)(index);
+    if (result.face_lines)
+        _array_size(result.face_lines) = (fastObjUInt)(faces);
+
+    mesh->face_vertices  = result.face_vertices;
+    mesh->face_materials = result.face_materials;
+    mesh->face_lines     = result.face_lines;
+    mesh->indices        = result.indices;
+    mesh->face_count     = (unsigned int)(faces);
+    mesh->index_count    = (unsigned int)(index);
+
+    current_arena = arena;
+
+    return 1;
+}
+
+
+typedef struct
+{
+    const fastObjMesh*          mesh;
+    fastObjBuffer*              buffer;
+
+    /* Hash partition handled by this task, unique vertices found in it and
+       where they go in the vertex buffer */
+    unsigned int                partition;
+    unsigned int                partitions;
+    fastObjIndex*               keys;
+    fastObjUInt*                table;
+    fastObjUInt                 table_size;
+    fastObjUInt                 vertex_offset;
+
+    /* Per face vertex: vertex number in its partition, then in the buffer */
+    fastObjUInt*                remap;
+    unsigned char*              parts;
+
+    /* Faces this task writes triangles for, and where they start */
+    fastObjUInt                 face_begin;
+    fastObjUInt                 face_end;
+    fastObjUInt                 corner_offset;
+    fastObjUInt                 triangle_offset;
+
+    /* Table of all tasks, for the vertex offsets of other partitions */
+    const void*                 tasks;
+
+    fastObjPolygon              polygon;
+
+    int                         ok;
+
+} fastObjBufferTask;
+
+
+static
+uint32_t hash_index(fastObjIndex i)
+{
+    uint32_t h;
+
+
+    h  = (uint32_t)(i.p) * 0x9E3779B1u;
+    h ^= (uint32_t)(i.t) * 0x85EBCA77u;
+    h ^= (uint32_t)(i.n) * 0xC2B2AE3Du;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+
+    return h;
+}
+
+
+static
+int buffer_rehash(fastObjBufferTask* task)
+{
+    fastObjUInt* table;
+    fastObjUInt  size;
+    fastObjUInt  slot;
+    fastObjUInt  ii;
+
+
+    size  = task->table_size * 2;
+    table = (fastObjUInt*)(memory_realloc(0, size * sizeof(fastObjUInt)));
+    if (!table)
+        return 0;
+
+    memset(table, 0, size * sizeof(fastObjUInt));
+
+    for (ii = 0; ii < array_size(task->keys); ii++)
+    {
+        slot = hash_index(task->keys[ii]) & (size - 1);
+        while (table[slot])
+            slot = (slot + 1) & (size - 1);
+
+        table[slot] = ii + 1;
+    }
+
+    memory_dealloc(task->table);
+    task->table      = table;
+    task->table_size = size;
+
+    return 1;
+}
+
+
+static
+void buffer_dedup(void* arg)
+{
+    fastObjBufferTask*  task    = (fastObjBufferTask*)(arg);
+    const fastObjIndex* indices = task->mesh->indices;
+    fastObjUInt         count   = task->mesh->index_count;
+    fastObjUInt         ii;
+    fastObjUInt         slot;
+    fastObjUInt         entry;
+    fastObjIndex        key;
+    uint32_t            h;
+
+
+    /* Open addressing with linear probing, entries are key numbers + 1 */
+    task->table = (fastObjUInt*)(memory_realloc(0, task->table_size * sizeof(fastObjUInt)));
+    if (!task->table)
+        return;
+
+    memset(task->table, 0, task->table_size * sizeof(fastObjUInt));
+
+    for (ii = 0; ii < count; ii++)
+    {
+        key = indices[ii];
+        h   = hash_index(key);
+
+        /* Every task sees every vertex, but only keeps its own partition */
+        if (task->partitions > 1)
+        {
+            if ((unsigned int)(((uint64_t)(h) * task->partitions) >> 32) != task->partition)
+                continue;
+
+            task->parts[ii] = (unsigned char)(task->partition);
+        }
+
+        slot = h & (task->table_size - 1);
+        for (;;)
+        {
+            entry = task->table[slot];
+            if (entry == 0)
+            {
+                entry = array_size(task->keys) + 1;
+
+                array_push(task->keys, key);
+                if (array_size(task->keys) != entry)
+                    return;
+
+                task->table[slot] = entry;
+
+                if (2 * entry > task->table_size && !buffer_rehash(task))
+                    return;
+
+                break;
+            }
+
+            if (task->keys[entry - 1].p == key.p &&
+                task->keys[entry - 1].t == key.t &&
+                task->keys[entry - 1].n == key.n)
+                break;
+
+            slot = (slot + 1) & (task->table_size - 1);
+        }
+
+        task->remap[ii] = entry - 1;
+    }
+
+    task->ok = 1;
+}
+
+
+static
+void buffer_emit(void* arg)
+{
+    fastObjBufferTask*       task   = (fastObjBufferTask*)(arg);
+    const fastObjBufferTask* tasks  = (const fastObjBufferTask*)(task->tasks);
+    const fastObjMesh*       m      = task->mesh;
+    fastObjBuffer*           buffer = task->buffer;
+    fastObjVertex*           vertex;
+    const fastObjIndex*      key;
+    fastObjUInt              face;
+    const unsigned int*      triangles;
+    fastObjUInt              corner;
+    fastObjUInt              first;
+    fastObjUInt              ii;
+    fastObjUInt              jj;
+    unsigned int             fv;
+
+
+    /* Vertices of this task's partition */
+    for (ii = 0; ii < array_size(task->keys); ii++)
+    {
+        key    = &task->keys[ii];
+        vertex = &buffer->vertices[task->vertex_offset + ii];
+
+        memcpy(vertex->position, m->positions + 3 * key->p, 3 * sizeof(float));
+        memcpy(vertex->texcoord, m->texcoords + 2 * key->t, 2 * sizeof(float));
+        memcpy(vertex->normal,   m->normals   + 3 * key->n, 3 * sizeof(float));
+    }
+
+
+    /* Triangles for this task's faces */
+    corner = task->corner_offset;
+    first  = 3 * task->triangle_offset;
+    for (face = task->face_begin; face < task->face_end; face++)
+    {
+        fv = m->face_vertices[face];
+
+        /* Vertex numbers are local to their partition until now */
+        if (task->partitions > 1)
+            for (jj = 0; jj < fv; jj++)
+                task->remap[corner + jj] += tasks[task->parts[corner + jj]].vertex_offset;
+
+        /* Points and lines have no triangles */
+        if (fv >= 3)
+        {
+            triangles = polygon_triangulate(&task->polygon, m, m->indices + corner, fv);
+            if (!triangles)
+            {
+                task->ok = 0;
+                return;
+            }
+
+            for (jj = 0; jj < 3 * (fv - 2); jj++)
+            {
+                if (buffer->index_size == 2)
+                    ((unsigned short*)(buffer->indices))[first + jj] = (unsigned short)(task->remap[corner + triangles[jj]]);
+                else
+                    ((unsigned int*)(buffer->indices))[first + jj] = (unsigned int)(task->remap[corner + triangles[jj]]);
+            }
+
+            first += 3 * (fv - 2);
+        }
+
+        corner += fv;
+    }
+}
+
+
+void fast_obj_buffer_destroy(fastObjBuffer* buffer)
+{
+    memory_dealloc(buffer->vertices);
+    memory_dealloc(buffer->indices);
+    memory_dealloc(buffer->ranges);
+    memory_dealloc(buffer);
+}
+
+
+fastObjBuffer* fast_obj_buffer_create(const fastObjMesh* mesh, unsigned int thread_count)
+{
+    fastObjBufferTask  tasks[MAX_THREADS];
+    fastObjBufferTask* task;
+    fastObjBuffer*     buffer;
+    fastObjRange*      ranges;
+    fastObjRange       range;
+    fastObjUInt*       remap;
+    unsigned char*     parts;
+    fastObjUInt        corners;
+    fastObjUInt        triangles;
+    fastObjUInt        vertices;
+    fastObjUInt        face;
+    fastObjUInt        size;
+    unsigned int       count;
+    unsigned int       fv;
+    unsigned int       ii;
+    int                ok;
+
+
+    buffer = (fastObjBuffer*)(memory_realloc(0, sizeof(fastObjBuffer)));
+    if (!buffer)
+        return 0;
+
+    memset(buffer, 0, sizeof(fastObjBuffer));
+    buffer->corner_count = mesh->index_count;
+
+
+    /* Split big meshes between threads, each owning a range of hash values */
+    count = thread_count ? thread_count : thread_count_default();
+    if (count > mesh->index_count / MIN_BUFFER_CORNERS)
+        count = mesh->index_count / MIN_BUFFER_CORNERS;
+    if (count > MAX_THREADS)
+        count = MAX_THREADS;
+    if (count < 1)
+        count = 1;
+
+    remap = (fastObjUInt*)(memory_realloc(0, (mesh->index_count + 1) * sizeof(fastObjUInt)));
+    parts = (count > 1) ? (unsigned char*)(memory_realloc(0, mesh->index_count + 1)) : 0;
+
+    /* Start with room for one unique vertex in two face vertices */
+    size = 64;
+    while (size < mesh->index_count / count)
+        size *= 2;
+
+    memset(tasks, 0, sizeof(tasks));
+    for (ii = 0; ii < count; ii++)
+    {
+        task = &tasks[ii];
+
+        task->mesh       = mesh;
+        task->buffer     = buffer;
+        task->partition  = ii;
+        task->partitions = count;
+        task->table_size = size;
+        task->remap      = remap;
+        task->parts      = parts;
+        task->tasks      = tasks;
+        task->face_begin = (fastObjUInt)((uint64_t)(mesh->face_count) * ii / count);
+        task->face_end   = (fastObjUInt)((uint64_t)(mesh->face_count) * (ii + 1) / count);
+    }
+
+    ok = remap && (parts || count == 1);
+    if (ok)
+    {
+        run_tasks(buffer_dedup, tasks, sizeof(fastObjBufferTask), count);
+
+        for (ii = 0; ii < count; ii++)
+            ok = ok && tasks[ii].ok;
+    }
+
+
+    /* Runs of faces with the same material, and where each task's faces start */
+    ranges    = 0;
+    corners   = 0;
+    triangles = 0;
+    ii        = 0;
+    for (face = 0; ok && face < mesh->face_count; face++)
+    {
+        while (ii < count && tasks[ii].face_begin == face)
+        {
+            tasks[ii].corner_offset   = corners;
+            tasks[ii].triangle_offset = triangles;
+            ii++;
+        }
+
+        fv = mesh->face_vertices[face];
+        if (fv >= 3)
+        {
+            if (array_empty(ranges) || ranges[array_size(ranges) - 1].material != mesh->face_materials[face])
+            {
+                range.material     = mesh->face_materials[face];
+                range.index_offset = 3 * triangles;
+                range.index_count  = 0;
+                array_push(ranges, range);
+            }
+
+            if (array_empty(ranges))
+                ok = 0;
+            else
+                ranges[array_size(ranges) - 1].index_count += 3 * (fv - 2);
+
+            triangles += fv - 2;
+        }
+
+        corners += fv;
+    }
+
+    for (; ii < count; ii++)
+    {
+        tasks[ii].corner_offset   = corners;
+        tasks[ii].triangle_offset = triangles;
+    }
+
+
+    /* Each partition's vertices follow the previous one's */
+    vertices = 0;
+    for (ii = 0; ii < count; ii++)
+    {
+        tasks[ii].vertex_offset = vertices;
+        vertices += array_size(tasks[ii].keys);
+    }
+
+    if (ok)
+    {
+        buffer->vertex_count = vertices;
+        buffer->index_count  = 3 * triangles;
+        buffer->index_size   = (vertices <= 65536) ? 2 : 4;
+        buffer->range_count  = array_size(ranges);
+
+        buffer->vertices = (fastObjVertex*)(memory_realloc(0, vertices * sizeof(fastObjVertex) + 1));
+        buffer->indices  = memory_realloc(0, (size_t)(buffer->index_count) * buffer->index_size + 1);
+        buffer->ranges   = (fastObjRange*)(memory_realloc(0, buffer->range_count * sizeof(fastObjRange) + 1));
+
+        ok = buffer->vertices && buffer->indices && buffer->ranges;
+    }
+
+    if (ok)
+    {
+        if (buffer->range_count)
+            memcpy(buffer->ranges, ranges, buffer->range_count * sizeof(fastObjRange));
+
+        run_tasks(buffer_emit, tasks, sizeof(fastObjBufferTask), count);
+
+        for (ii = 0; ii < count; ii++)
+            ok = ok && tasks[ii].ok;
+    }
+
+
+    for (ii = 0; ii < count; ii++)
+    {
+        array_clean(tasks[ii].keys);
+        memory_dealloc(tasks[ii].table);
+        polygon_clean(&tasks[ii].polygon);
+    }
+
+    array_clean(ranges);
+    memory_dealloc(remap);
+    memory_dealloc(parts);
+
+    if (!ok)
+    {
+        fast_obj_buffer_destroy(buffer);
+        return 0;
+    }
+
+    return buffer;
+}
+
+typedef struct
+{
+    char                        magic[8];
+    uint32_t                    version;
+
+    /* Sizes of pointers and mesh structures, and the byte order, of the writer */
+    uint32_t                    layout;
+
+    /* Source file the mesh was read from */
+    uint64_t                    source_size;
+    int64_t                     source_time;
+    uint64_t                    source_hash;
+
+    /* Size of the cache file, and where its fastObjMesh is */
+    uint64_t                    size;
+    uint64_t                    mesh;
+
+    /* Material libraries named by the source, library_count records
+       starting at libraries */
+    uint64_t                    libraries;
+    uint32_t                    library_count;
+
+    /* FAST_OBJ_SKIP_* flags the mesh was read with */
+    uint32_t                    skip;
+
+} fastObjCacheHeader;
+
+
+typedef struct
+{
+    /* Library file when the cache was written, a size of ~0 when it was
+       missing.  The path and its zero follow */
+    uint64_t                    size;
+    int64_t                     time;
+    uint64_t                    length;
+
+} fastObjCacheLibrary;
+
+
+/* The header is followed by an arena block holding the mesh, its arrays and
+   its strings, with pointers stored as offsets from the start of the file,
+   and then the library records */
+#define CACHE_BLOCK             ARENA_ROUND(sizeof(fastObjCacheHeader))
+
+
+typedef struct
+{
+    FILE*                       file;
+
+    /* Bytes written so far, and where the next string goes */
+    uint64_t                    offset;
+    uint64_t                    strings;
+
+    int                         ok;
+
+} fastObjCacheWriter;
+
+
+static
+uint32_t cache_layout(void)
+{
+    uint32_t      order = 1;
+    unsigned char first;
+
+
+    /* Caches are only read back by code built the same way */
+    memcpy(&first, &order, 1);
+
+    return (uint32_t)(sizeof(void*))
+         | (uint32_t)(sizeof(fastObjUInt)) << 4
+         | (uint32_t)(sizeof(fastObjMesh)) << 8
+         | (uint32_t)(sizeof(fastObjMaterial)) << 20
+         | (uint32_t)(first) << 31;
+}
+
+
+static
+uint64_t hash_bytes(const char* p, size_t n)
+{
+    uint64_t h[4];
+    uint64_t v;
+    size_t   ii;
+
+
+    /* Four independent lanes keep the multiplier busy */
+    h[0] = 0x9E3779B97F4A7C15ULL ^ n;
+    h[1] = 0xC2B2AE3D27D4EB4FULL;
+    h[2] = 0x165667B19E3779F9ULL;
+    h[3] = 0x85EBCA77C2B2AE63ULL;
+
+    while (n >= 32)
+    {
+        for (ii = 0; ii < 4; ii++)
+        {
+            memcpy(&v, p + 8 * ii, 8);
+            h[ii]  = (h[ii] ^ v) * 0xFF51AFD7ED558CCDULL;
+            h[ii] ^= h[ii] >> 32;
+        }
+
+        p += 32;
+        n -= 32;
+    }
+
+    for (ii = 0; ii < n; ii++)
+        h[ii & 3] = (h[ii & 3] ^ (unsigned char)(p[ii])) * 0xC4CEB9FE1A85EC53ULL;
+
+    v = h[0] ^ (h[1] * 0x9E3779B97F4A7C15ULL) ^ (h[2] * 0xC2B2AE3D27D4EB4FULL) ^ (h[3] * 0x165667B19E3779F9ULL);
+    v ^= v >> 33;
+    v *= 0xFF51AFD7ED558CCDULL;
+    v ^= v >> 33;
+
+    return v;
+}
+
+
+static
+int file_hash(const char* path, uint64_t* hash)
+{
+    fastObjMapping map;
+
+
+    if (!file_map(&map, path, 0))
+        return 0;
+
+    *hash = hash_bytes(map.data, map.size);
+
+    file_unmap(&map);
+
+    return 1;
+}
+
+
+static
+void library_stat(const char* path, fastObjCacheLibrary* library)
+{
+    const char* suffix = ".gz";
+    char*       name;
+
+
+    /* The gzip callbacks also open foo.mtl as foo.mtl.gz */
+    if (file_stat(path, &library->size, &library->time))
+        return;
+
+    name = string_concat(path, suffix, suffix + 3);
+    if (!name || !file_stat(name, &library->size, &library->time))
+    {
+        library->size = ~(uint64_t)(0);
+        library->time = 0;
+    }
+
+    memory_dealloc(name);
+}
+
+
+static
+int source_libraries(const char* path, char*** library_paths)
+{
+    fastObjCallbacks callbacks;
+    fastObjMapping   map;
+    void*            file;
+    char*            contents;
+    char*            base;
+    char*            lib;
+    const char*      sep1;
+    const char*      sep2;
+    const char*      p;
+    const char*      s;
+    const char*      e;
+    const char*      t;
+    const char*      end;
+    size_t           size;
+
+
+    /* Library paths are relative to the source, as in data_init */
+    sep1 = strrchr(path, FAST_OBJ_SEPARATOR);
+    sep2 = strrchr(path, FAST_OBJ_OTHER_SEP);
+    sep1 = sep2 && (!sep1 || sep1 < sep2) ? sep2 : sep1;
+
+    base = sep1 ? string_substr(path, 0, sep1 - path + 1) : 0;
+    if (sep1 && !base)
+        return 0;
+
+    if (!file_map(&map, path, 0))
+    {
+        memory_dealloc(base);
+        return 0;
+    }
+
+    contents = 0;
+    p        = map.data;
+    end      = p + map.size;
+
+    /* Compressed sources are scanned inflated */
+    if (gzip_magic(map.data, map.size))
+    {
+        file_unmap(&map);
+
+        callbacks = fast_obj_gzip_callbacks();
+        file      = callbacks.file_open(path, 0);
+        contents  = file ? read_file(file, &callbacks, 0, &size) : 0;
+
+        if (file)
+            callbacks.file_close(file, 0);
+
+        if (!contents)
+        {
+            memory_dealloc(base);
+            return 0;
+        }
+
+        p   = contents;
+        end = contents + size;
+    }
+
+
+    /* Same lines parse_buffer loads libraries for */
+    while (p < end)
+    {
+        e = find_newline(p, end);
+
+        s = p;
+        while (s < e && is_whitespace(*s))
+            s++;
+
+        if (e - s >= 7 && memcmp(s, "mtllib", 6) == 0 && is_whitespace(s[6]))
+        {
+            s   = part_name(s + 6, e, &t);
+            lib = string_concat(base, s, t);
+            if (lib)
+            {
+                string_fix_separators(lib);
+                array_push(*library_paths, lib);
+            }
+        }
+
+        p = (e < end) ? e + 1 : end;
+    }
+
+    if (contents)
+        scratch_dealloc(contents);
+    else
+        file_unmap(&map);
+
+    memory_dealloc(base);
+
+    return 1;
+}
+
+
+static
+void cache_put(fastObjCacheWriter* writer, const void* data, size_t bytes)
+{
+    if (writer->file && bytes > 0 && fwrite(data, 1, bytes, writer->file) != bytes)
+        writer->ok = 0;
+
+    writer->offset += bytes;
+}
+
+
+static
+void cache_pad(fastObjCacheWriter* writer)
+{
+    static const char zero[ARENA_ALIGN] = { 0 };
+
+
+    /* Allocations start on the alignment an arena would give them */
+    cache_put(writer, zero, (size_t)(ARENA_ROUND(writer->offset) - writer->offset));
+}
+
+
+static
+uint64_t cache_alloc(fastObjCacheWriter* writer, size_t bytes)
+{
+    size_t head[ARENA_ALIGN / sizeof(size_t)];
+
+
+    /* Same size prefix as arena_place, so arena_realloc can copy from the file */
+    memset(head, 0, sizeof(head));
+    head[0] = bytes;
+
+    cache_put(writer, head, sizeof(head));
+
+    return writer->offset;
+}
+
+
+static
+uint64_t cache_array(fastObjCacheWriter* writer, const void* data, size_t element)
+{
+    fastObjUInt head[2];
+    uint64_t    offset;
+
+
+    if (!data)
+        return 0;
+
+    head[0] = array_size(data);
+    head[1] = head[0];
+
+    offset = cache_alloc(writer, sizeof(head) + head[0] * element);
+    cache_put(writer, head, sizeof(head));
+    cache_put(writer, data, head[0] * element);
+    cache_pad(writer);
+
+    return offset + sizeof(head);
+}
+
+
+static
+void* cache_string(fastObjCacheWriter* writer, const char* s)
+{
+    uint64_t offset;
+
+
+    /* Strings are written first, in the order their owners are written later */
+    if (!s)
+        return 0;
+
+    offset = writer->strings + ARENA_ALIGN;
+    writer->strings = offset + ARENA_ROUND(strlen(s) + 1);
+
+    return (void*)(uintptr_t)(offset);
+}
+
+
+static
+void cache_string_data(fastObjCacheWriter* writer, const char* s)
+{
+    if (!s)
+        return;
+
+    cache_alloc(writer, strlen(s) + 1);
+    cache_put(writer, s, strlen(s) + 1);
+    cache_pad(writer);
+}
+
+
+static
+void cache_write_mesh(fastObjCacheWriter* writer, const fastObjMesh* mesh, char** library_paths, fastObjCacheHeader* header)
+{
+    static const char zero[ARENA_HEADER] = { 0 };
+
+    fastObjMesh         m;
+    fastObjMaterial     material;
+    fastObjTexture      texture;
+    fastObjGroup        group;
+    fastObjCacheLibrary library;
+    fastObjUInt         head[2];
+    uint64_t            offset;
+    unsigned int        ii;
+
+
+    /* Header is written again once the mesh offset is known */
+    cache_put(writer, header, sizeof(fastObjCacheHeader));
+    cache_pad(writer);
+    cache_put(writer, zero, ARENA_HEADER);
+
+
+    /* Strings */
+    writer->strings = writer->offset;
+
+    for (ii = 0; ii < array_size(mesh->materials); ii++)
+        cache_string_data(writer, mesh->materials[ii].name);
+
+    for (ii = 0; ii < array_size(mesh->textures); ii++)
+    {
+        cache_string_data(writer, mesh->textures[ii].name);
+        cache_string_data(writer, mesh->textures[ii].path);
+    }
+
+    for (ii = 0; ii < array_size(mesh->objects); ii++)
+        cache_string_data(writer, mesh->objects[ii].name);
+
+    for (ii = 0; ii < array_size(mesh->groups); ii++)
+        cache_string_data(writer, mesh->groups[ii].name);
+
+
+    /* Arrays, with their strings as offsets */
+    m = *mesh;
+
+    m.positions      = (float*)(uintptr_t)(cache_array(writer, mesh->positions, sizeof(float)));
+    m.texcoords      = (float*)(uintptr_t)(cache_array(writer, mesh->texcoords, sizeof(float)));
+    m.normals        = (float*)(uintptr_t)(cache_array(writer, mesh->normals, sizeof(float)));
+    m.colors         = (float*)(uintptr_t)(cache_array(writer, mesh->colors, sizeof(float)));
+    m.face_vertices  = (unsigned int*)(uintptr_t)(cache_array(writer, mesh->face_vertices, sizeof(unsigned int)));
+    m.face_materials = (unsigned int*)(uintptr_t)(cache_array(writer, mesh->face_materials, sizeof(unsigned int)));
+    m.face_lines     = (unsigned char*)(uintptr_t)(cache_array(writer, mesh->face_lines, sizeof(unsigned char)));
+    m.indices        = (fastObjIndex*)(uintptr_t)(cache_array(writer, mesh->indices, sizeof(fastObjIndex)));
+    m.arena          = 0;
+
+    head[0] = array_size(mesh->materials);
+    head[1] = head[0];
+    offset  = cache_alloc(writer, sizeof(head) + head[0] * sizeof(fastObjMaterial));
+    cache_put(writer, head, sizeof(head));
+    for (ii = 0; ii < head[0]; ii++)
+    {
+        material      = mesh->materials[ii];
+        material.name = (char*)(cache_string(writer, material.name));
+        cache_put(writer, &material, sizeof(fastObjMaterial));
+    }
+    cache_pad(writer);
+    m.materials = mesh->materials ? (fastObjMaterial*)(uintptr_t)(offset + sizeof(head)) : 0;
+
+    head[0] = array_size(mesh->textures);
+    head[1] = head[0];
+    offset  = cache_alloc(writer, sizeof(head) + head[0] * sizeof(fastObjTexture));
+    cache_put(writer, head, sizeof(head));
+    for (ii = 0; ii < head[0]; ii++)
+    {
+        texture      = mesh->textures[ii];
+        texture.name = (char*)(cache_string(writer, texture.name));
+        texture.path = (char*)(cache_string(writer, texture.path));
+        cache_put(writer, &texture, sizeof(fastObjTexture));
+    }
+    cache_pad(writer);
+    m.textures = mesh->textures ? (fastObjTexture*)(uintptr_t)(offset + sizeof(head)) : 0;
+
+    head[0] = array_size(mesh->objects);
+    head[1] = head[0];
+    offset  = cache_alloc(writer, sizeof(head) + head[0] * sizeof(fastObjGroup));
+    cache_put(writer, head, sizeof(head));
+    for (ii = 0; ii < head[0]; ii++)
+    {
+        group      = mesh->objects[ii];
+        group.name = (char*)(cache_string(writer, group.name));
+        cache_put(writer, &group, sizeof(fastObjGroup));
+    }
+    cache_pad(writer);
+    m.objects = mesh->objects ? (fastObjGroup*)(uintptr_t)(offset + sizeof(head)) : 0;
+
+    head[0] = array_size(mesh->groups);
+    head[1] = head[0];
+    offset  = cache_alloc(writer, sizeof(head) + head[0] * sizeof(fastObjGroup));
+    cache_put(writer, head, sizeof(head));
+    for (ii = 0; ii < head[0]; ii++)
+    {
+        group      = mesh->groups[ii];
+        group.name = (char*)(cache_string(writer, group.name));
+        cache_put(writer, &group, sizeof(fastObjGroup));
+    }
+    cache_pad(writer);
+    m.groups = mesh->groups ? (fastObjGroup*)(uintptr_t)(offset + sizeof(head)) : 0;
+
+
+    /* Mesh last */
+    header->mesh = cache_alloc(writer, sizeof(fastObjMesh));
+    cache_put(writer, &m, sizeof(fastObjMesh));
+    cache_pad(writer);
+
+
+    /* Libraries the materials came from, with what they were when read */
+    header->libraries     = writer->offset;
+    header->library_count = array_size(library_paths);
+
+    for (ii = 0; ii < array_size(library_paths); ii++)
+    {
+        library_stat(library_paths[ii], &library);
+        library.length = strlen(library_paths[ii]);
+
+        cache_put(writer, &library, sizeof(fastObjCacheLibrary));
+        cache_put(writer, library_paths[ii], (size_t)(library.length) + 1);
+        cache_pad(writer);
+    }
+
+    header->size = writer->offset;
+}
+
+
+static
+char* temp_path(const char* path, const void* owner)
+{
+    char          suffix[64];
+    unsigned long process;
+
+
+    /* Unique per process and writer, next to the file it replaces */
+#ifdef _WIN32
+    process = (unsigned long)(GetCurrentProcessId());
+#else
+    process = (unsigned long)(getpid());
+#endif
+
+    sprintf(suffix, ".%lx.%lx.tmp", process, (unsigned long)((uintptr_t)(owner)));
+
+    return string_concat(path, suffix, suffix + strlen(suffix));
+}
+
+
+static
+int temp_commit(int ok, char* temp, const char* path)
+{
+    /* Renames a finished temporary file over path, or removes it */
+#ifdef _WIN32
+    if (ok)
+        remove(path);
+#endif
+
+    if (ok && rename(temp, path) != 0)
+        ok = 0;
+
+    if (!ok)
+        remove(temp);
+
+    memory_dealloc(temp);
+
+    return ok;
+}
+
+
+static
+int cache_write(const fastObjMesh* mesh, const char* path, const char* cache_path, unsigned int skip)
+{
+    fastObjCacheHeader header;
+    fastObjCacheWriter writer;
+    char**             library_paths;
+    char*              temp;
+    unsigned int       ii;
+
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "fast_obj", 8);
+    header.version = CACHE_VERSION;
+    header.layout  = cache_layout();
+    header.skip    = skip;
+
+    if (!file_stat(path, &header.source_size, &header.source_time) ||
+        !file_hash(path, &header.source_hash))
+        return 0;
+
+    /* Materials are cached too, so the cache also depends on their libraries */
+    library_paths = 0;
+    if (!(skip & FAST_OBJ_SKIP_MATERIALS) && !source_libraries(path, &library_paths))
+        return 0;
+
+
+    /* Written under a temporary name and renamed, so readers never see part of a file */
+    temp = temp_path(cache_path, mesh);
+
+    writer.file    = temp ? fopen(temp, "wb") : 0;
+    writer.offset  = 0;
+    writer.strings = 0;
+    writer.ok      = writer.file != 0;
+
+    if (writer.ok)
+    {
+        cache_write_mesh(&writer, mesh, library_paths, &header);
+
+        if (fseek(writer.file, 0, SEEK_SET) == 0)
+            cache_put(&writer, &header, sizeof(header));
+        else
+            writer.ok = 0;
+
+        if (fclose(writer.file) != 0)
+            writer.ok = 0;
+    }
+
+    for (ii = 0; ii < array_size(library_paths); ii++)
+        memory_dealloc(library_paths[ii]);
+
+    array_clean(library_paths);
+
+    return temp ? temp_commit(writer.ok, temp, cache_path) : 0;
+}
+
+
+int fast_obj_cache_write(const fastObjMesh* mesh, const char* path, const char* cache_path)
+{
+    /* For meshes read without skip flags */
+    return cache_write(mesh, path, cache_path, 0);
+}
+
+
+static
+int cache_libraries(const char* base, size_t size, const fastObjCacheHeader* header)
+{
+    fastObjCacheLibrary library;
+    fastObjCacheLibrary current;
+    uint64_t            offset;
+    uint32_t            ii;
+
+
+    /* Any library that changed, appeared or went away makes the cache stale */
+    offset = header->libraries;
+
+    for (ii = 0; ii < header->library_count; ii++)
+    {
+        if (offset > size || sizeof(fastObjCacheLibrary) > size - offset)
+            return 0;
+
+        memcpy(&library, base + offset, sizeof(fastObjCacheLibrary));
+        offset += sizeof(fastObjCacheLibrary);
+
+        if (library.length >= size - offset || base[offset + library.length] != 0)
+            return 0;
+
+        library_stat(base + offset, &current);
+        if (current.size != library.size || current.time != library.time)
+            return 0;
+
+        offset = ARENA_ROUND(offset + library.length + 1);
+    }
+
+    return 1;
+}
+
+
+static
+int cache_fix(void* ptr, const char* base, size_t size, size_t element)
+{
+    uint64_t offset;
+    uint64_t head;
+    char*    p;
+
+
+    /* Turns an offset back into a pointer, checking it stays in the file */
+    memcpy(&p, ptr, sizeof(char*));
+
+    offset = (uint64_t)(uintptr_t)(p);
+    if (offset == 0)
+        return 1;
+
+    if (offset < CACHE_BLOCK + ARENA_HEADER + ARENA_ALIGN || offset > size)
+        return 0;
+
+    /* Allocations sit where an arena would put them, arrays after their size */
+    head = element > 0 ? 2 * sizeof(fastObjUInt) : 0;
+    if ((offset - head) & (ARENA_ALIGN - 1))
+        return 0;
+
+    p = (char*)(base) + offset;
+
+    /* Arrays have their size in front, strings end in a zero */
+    if (element > 0)
+    {
+        if ((uint64_t)(_array_size(p)) * element > size - offset)
+            return 0;
+
+        /* Growing an array reads its capacity and arena size, they must match it */
+        if (_array_capacity(p) != _array_size(p) ||
+            _arena_size(p - head) != head + _array_size(p) * element)
+            return 0;
+    }
+    else
+    {
+        if (!memchr(p, 0, (size_t)(size - offset)))
+            return 0;
+    }
+
+    memcpy(ptr, &p, sizeof(char*));
+
+    return 1;
+}
+
+
+static
+int cache_groups(const fastObjGroup* groups, const fastObjMesh* m)
+{
+    unsigned int ii;
+
+
+    for (ii = 0; ii < array_size(groups); ii++)
+    {
+        if ((uint64_t)(groups[ii].face_offset) + groups[ii].face_count > m->face_count ||
+            (uint64_t)(groups[ii].index_offset) + groups[ii].index_count > m->index_count)
+            return 0;
+    }
+
+    return 1;
+}
+
+
+static
+int cache_counts(const fastObjMesh* m)
+{
+    const fastObjMaterial* mtl;
+    unsigned int           maps[9];
+    uint64_t               indices;
+    unsigned int           ii;
+    unsigned int           jj;
+
+
+    /* Counts come from the file as well, each must describe its array */
+    if ((uint64_t)(m->position_count) * 3 != array_size(m->positions) ||
+        (uint64_t)(m->texcoord_count) * 2 != array_size(m->texcoords) ||
+        (uint64_t)(m->normal_count) * 3 != array_size(m->normals) ||
+        (uint64_t)(m->color_count) * 3 != array_size(m->colors) ||
+        m->face_count != array_size(m->face_vertices) ||
+        (!array_empty(m->face_materials) && array_size(m->face_materials) != m->face_count) ||
+        (!array_empty(m->face_lines) && array_size(m->face_lines) != m->face_count) ||
+        m->index_count != array_size(m->indices) ||
+        m->material_count != array_size(m->materials) ||
+        m->texture_count != array_size(m->textures) ||
+        m->object_count != array_size(m->objects) ||
+        m->group_count != array_size(m->groups))
+        return 0;
+
+    /* Faces walk the indices by their vertex counts */
+    indices = 0;
+    for (ii = 0; ii < m->face_count; ii++)
+        indices += m->face_vertices[ii];
+
+    if (indices != m->index_count)
+        return 0;
+
+    /* Material 0 is used by faces of meshes without materials */
+    for (ii = 0; ii < array_size(m->face_materials); ii++)
+    {
+        if (m->face_materials[ii] >= m->material_count && m->face_materials[ii] != 0)
+            return 0;
+    }
+
+    for (ii = 0; ii < m->material_count; ii++)
+    {
+        mtl = &m->materials[ii];
+
+        /* Texture indices, 0 for none */
+        maps[0] = mtl->map_Ka;
+        maps[1] = mtl->map_Kd;
+        maps[2] = mtl->map_Ks;
+        maps[3] = mtl->map_Ke;
+        maps[4] = mtl->map_Kt;
+        maps[5] = mtl->map_Ns;
+        maps[6] = mtl->map_Ni;
+        maps[7] = mtl->map_d;
+        maps[8] = mtl->map_bump;
+
+        for (jj = 0; jj < 9; jj++)
+        {
+            if (maps[jj] >= m->texture_count && maps[jj] != 0)
+                return 0;
+        }
+    }
+
+    return cache_groups(m->objects, m) && cache_groups(m->groups, m);
+}
+
+
+static
+fastObjMesh* cache_read(const char* path, const char* cache_path, unsigned int skip)
+{
+    fastObjCacheHeader header;
+    fastObjArenaBlock* block;
+    fastObjMapping     map;
+    fastObjArena*      arena;
+    fastObjMesh*       m;
+    const char*        base;
+    uint64_t           size;
+    uint64_t           hash;
+    int64_t            time;
+    unsigned int       ii;
+    int                ok;
+
+
+    if (!file_stat(path, &size, &time))
+        return 0;
+
+    /* Pointers are fixed up in place, in pages private to this process */
+    if (!file_map(&map, cache_path, 1))
+        return 0;
+
+    base = map.data;
+
+    ok = map.size >= CACHE_BLOCK + ARENA_HEADER;
+    if (ok)
+    {
+        memcpy(&header, base, sizeof(header));
+
+        ok = memcmp(header.magic, "fast_obj", 8) == 0 &&
+             header.version == CACHE_VERSION &&
+             header.layout == cache_layout() &&
+             header.size == map.size &&
+             header.mesh >= CACHE_BLOCK + ARENA_HEADER + ARENA_ALIGN &&
+             (header.mesh & (ARENA_ALIGN - 1)) == 0 &&
+             header.mesh <= map.size &&
+             sizeof(fastObjMesh) <= map.size - header.mesh &&
+             header.skip == skip &&
+             header.source_size == size;
+    }
+
+    /* A source touched since the cache was written is hashed to see if it changed */
+    if (ok && header.source_time != time)
+        ok = file_hash(path, &hash) && hash == header.source_hash;
+
+    ok = ok && cache_libraries(base, map.size, &header);
+
+    if (!ok)
+    {
+        file_unmap(&map);
+        return 0;
+    }
+
+
+    m = (fastObjMesh*)(base + header.mesh);
+
+    ok = cache_fix(&m->positions, base, map.size, sizeof(float)) &&
+         cache_fix(&m->texcoords, base, map.size, sizeof(float)) &&
+         cache_fix(&m->normals, base, map.size, sizeof(float)) &&
+         cache_fix(&m->colors, base, map.size, sizeof(float)) &&
+         cache_fix(&m->face_vertices, base, map.size, sizeof(unsigned int)) &&
+         cache_fix(&m->face_materials, base, map.size, sizeof(unsigned int)) &&
+         cache_fix(&m->face_lines, base, map.size, sizeof(unsigned char)) &&
+         cache_fix(&m->indices, base, map.size, sizeof(fastObjIndex)) &&
+         cache_fix(&m->materials, base, map.size, sizeof(fastObjMaterial)) &&
+         cache_fix(&m->textures, base, map.size, sizeof(fastObjTexture)) &&
+         cache_fix(&m->objects, base, map.size, sizeof(fastObjGroup)) &&
+         cache_fix(&m->groups, base, map.size, sizeof(fastObjGroup));
+
+    for (ii = 0; ok && ii < array_size(m->materials); ii++)
+        ok = cache_fix(&m->materials[ii].name, base, map.size, 0);
+
+    for (ii = 0; ok && ii < array_size(m->textures); ii++)
+        ok = cache_fix(&m->textures[ii].name, base, map.size, 0) &&
+             cache_fix(&m->textures[ii].path, base, map.size, 0);
+
+    for (ii = 0; ok && ii < array_size(m->objects); ii++)
+        ok = cache_fix(&m->objects[ii].name, base, map.size, 0);
+
+    for (ii = 0; ok && ii < array_size(m->groups); ii++)
+        ok = cache_fix(&m->groups[ii].name, base, map.size, 0);
+
+    ok = ok && cache_counts(m);
+
+    arena = ok ? arena_create() : 0;
+    if (!arena)
+    {
+        file_unmap(&map);
+        return 0;
+    }
+
+
+    /* The rest of the file is a full arena block that nothing is placed in */
+    block = (fastObjArenaBlock*)(base + CACHE_BLOCK);
+
+    block->prev = 0;
+    block->next = 0;
+    block->size = map.size - CACHE_BLOCK - ARENA_HEADER;
+    block->used = block->size;
+    block->last = ARENA_NONE;
+
+    arena->blocks  = block;
+    arena->mapping = map;
+
+    m->arena = arena;
+
+    return m;
+}
+
+
+fastObjMesh* fast_obj_cache_read(const char* path, const char* cache_path)
+{
+    return cache_read(path, cache_path, 0);
+}
+
+
+fastObjMesh* fast_obj_read_cached(const char* path, const char* cache_dir, const fastObjReadOptions* options)
+{
+    fastObjReadOptions parse_options;
+    fastObjMesh*       m;
+    const char*        name;
+    char*              cache_path;
+    char               suffix[32];
+
+
+    /* Caches go next to the file, or in cache_dir under a name unique to the path */
+    if (cache_dir)
+    {
+        name = path + strlen(path);
+        while (name > path && name[-1] != FAST_OBJ_SEPARATOR && name[-1] != FAST_OBJ_OTHER_SEP)
+            name--;
+
+        sprintf(suffix, ".%016llx.cache", (unsigned long long)(hash_bytes(path, strlen(path))));
+
+        cache_path = (char*)(memory_realloc(0, strlen(cache_dir) + strlen(name) + strlen(suffix) + 2));
+        if (cache_path)
+            sprintf(cache_path, "%s%c%s%s", cache_dir, FAST_OBJ_SEPARATOR, name, suffix);
+    }
+    else
+    {
+        strcpy(suffix, ".cache");
+        cache_path = string_concat(path, suffix, suffix + strlen(suffix));
+    }
+
+    /* A cache written with other skip flags is a miss, and is replaced */
+    parse_options = options ? *options : fast_obj_read_options_default();
+
+    m = cache_path ? cache_read(path, cache_path, parse_options.skip) : 0;
+    if (!m)
+    {
+        /* Cached meshes have object/group boxes, whoever reads them next */
+        parse_options.group_bounds = 1;
+
+        m = fast_obj_read_with_options(path, 0, 0, &parse_options);
+
+        if (m && cache_path)
+            cache_write(m, path, cache_path, parse_options.skip);
+    }
+
+    memory_dealloc(cache_path);
+
+    return m;
+}
+
+
+typedef struct
+{
+    char                        magic[8];
+    uint32_t                    version;
+
+    /* Size of fastObjPart for the writer */
+    uint32_t                    part_size;
+
+    /* Source file the index was built from */
+    uint64_t                    source_size;
+    int64_t                     source_time;
+
+    /* Array sizes, the header is followed by the parts and then the names
+       and libraries as zero terminated strings */
+    uint32_t                    part_count;
+    uint32_t                    name_count;
+    uint32_t                    library_count;
+
+    /* Number of v/vt/vn lines in the file */
+    uint32_t                    position_count;
+    uint32_t                    texcoord_count;
+    uint32_t                    normal_count;
+
+} fastObjPartHeader;
+
+
+static
+void part_push(fastObjPartIndex* index, fastObjPart* part, unsigned long long offset)
+{
+    /* Ends the current part at offset, the next one starts there */
+    if (offset > part->offset)
+    {
+        part->size = offset - part->offset;
+        array_push(index->parts, *part);
+    }
+
+    part->offset        = offset;
+    part->size          = 0;
+    part->position_base = index->position_count;
+    part->texcoord_base = index->texcoord_count;
+    part->normal_base   = index->normal_count;
+    part->face_count    = 0;
+}
+
+
+fastObjPartIndex* fast_obj_part_index_create(const char* path)
+{
+    fastObjPartIndex* index;
+    fastObjMapping    map;
+    fastObjPart       part;
+    const char*       start;
+    const char*       end;
+    const char*       p;
+    const char*       e;
+    const char*       s;
+    const char*       t;
+    unsigned int*     statement;
+    uint64_t          size;
+    int64_t           time;
+
+
+    if (!file_stat(path, &size, &time) || !file_map(&map, path, 0))
+        return 0;
+
+    index = (fastObjPartIndex*)(memory_realloc(0, sizeof(fastObjPartIndex)));
+    if (!index)
+    {
+        file_unmap(&map);
+        return 0;
+    }
+
+    memset(index, 0, sizeof(fastObjPartIndex));
+    index->file_size = size;
+    index->file_time = time;
+
+    /* Parts use 0 for no name */
+    array_push(index->names, (char*)(0));
+
+
+    /* Classify lines the same way parse_buffer dispatches them */
+    memset(&part, 0, sizeof(part));
+
+    start = map.data;
+    end   = start + map.size;
+    p     = start;
+    while (p < end)
+    {
+        if ((unsigned long long)(p - start) - part.offset >= PART_BLOCK_SIZE)
+            part_push(index, &part, (unsigned long long)(p - start));
+
+        e = find_newline(p, end);
+
+        s = p;
+        while (s < e && is_whitespace(*s))
+            s++;
+
+        statement = 0;
+        if (e - s >= 2)
+        {
+            switch (*s)
             {
-                float Tr;
-                p = read_mtl_single(p + 2, &Tr);
-                if (!found_d)
+            case 'v':
+                if (s[1] == ' ' || s[1] == '\t')
+                    index->position_count++;
+                else if (s[1] == 't')
+                    index->texcoord_count++;
+                else if (s[1] == 'n')
+                    index->normal_count++;
+                break;
+
+            case 'f':
+            case 'l':
+                if (s[1] == ' ' || s[1] == '\t')
+                    part.face_count++;
+                break;
+
+            case 'o':
+                if (s[1] == ' ' || s[1] == '\t')
+                    statement = &part.object;
+                break;
+
+            case 'g':
+                if (s[1] == ' ' || s[1] == '\t')
+                    statement = &part.group;
+                break;
+
+            case 'u':
+                if (e - s >= 7 && memcmp(s, "usemtl", 6) == 0 && is_whitespace(s[6]))
+                    statement = &part.material;
+                break;
+
+            case 'm':
+                if (e - s >= 7 && memcmp(s, "mtllib", 6) == 0 && is_whitespace(s[6]))
                 {
-                    /* Ignore Tr if we've already read d */
-                    mtl.d = 1.0f - Tr;
+                    s = part_name(s + 6, e, &t);
+                    array_push(index->libraries, string_copy(s, t));
                 }
+                break;
             }
-            else if (p[1] == 'f')
-                p = read_mtl_triple(p + 2, mtl.Tf);
-            break;
+        }
 
-        case 'd':
-            if (is_whitespace(p[1]))
-            {
-                p = read_mtl_single(p + 1, &mtl.d);
-                found_d = 1;
-            }
+        /* Statement lines end a part, and are left out of the next one */
+        if (statement)
+        {
+            part_push(index, &part, (unsigned long long)(p - start));
+
+            s = part_name(s + ((*s == 'u') ? 6 : 1), e, &t);
+            *statement = array_push(index->names, string_copy(s, t));
+        }
+
+        p = (e < end) ? e + 1 : end;
+
+        if (statement)
+            part.offset = (unsigned long long)(p - start);
+    }
+
+    part_push(index, &part, (unsigned long long)(p - start));
+
+    file_unmap(&map);
+
+    index->part_count    = array_size(index->parts);
+    index->name_count    = array_size(index->names);
+    index->library_count = array_size(index->libraries);
+
+    return index;
+}
+
+
+void fast_obj_part_index_destroy(fastObjPartIndex* index)
+{
+    unsigned int ii;
+
+
+    for (ii = 0; ii < array_size(index->names); ii++)
+        memory_dealloc(index->names[ii]);
+
+    for (ii = 0; ii < array_size(index->libraries); ii++)
+        memory_dealloc(index->libraries[ii]);
+
+    array_clean(index->parts);
+    array_clean(index->names);
+    array_clean(index->libraries);
+
+    memory_dealloc(index);
+}
+
+
+int fast_obj_part_index_write(const fastObjPartIndex* index, const char* index_path)
+{
+    fastObjPartHeader  header;
+    fastObjCacheWriter writer;
+    const char*        name;
+    char*              temp;
+    unsigned int       ii;
+
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "obj_part", 8);
+    header.version        = PART_INDEX_VERSION;
+    header.part_size      = sizeof(fastObjPart);
+    header.source_size    = index->file_size;
+    header.source_time    = index->file_time;
+    header.part_count     = index->part_count;
+    header.name_count     = index->name_count;
+    header.library_count  = index->library_count;
+    header.position_count = index->position_count;
+    header.texcoord_count = index->texcoord_count;
+    header.normal_count   = index->normal_count;
+
+    /* Same as the cache, a crash while writing leaves the old index in place */
+    temp = temp_path(index_path, index);
+    if (!temp)
+        return 0;
+
+    writer.file    = fopen(temp, "wb");
+    writer.offset  = 0;
+    writer.strings = 0;
+    writer.ok      = writer.file != 0;
+
+    if (!writer.ok)
+        return temp_commit(0, temp, index_path);
+
+    cache_put(&writer, &header, sizeof(header));
+    cache_put(&writer, index->parts, index->part_count * sizeof(fastObjPart));
+
+    /* Names after the dummy, then libraries */
+    for (ii = 1; ii < index->name_count + index->library_count; ii++)
+    {
+        name = (ii < index->name_count) ? index->names[ii] : index->libraries[ii - index->name_count];
+        if (!name)
+            name = "";
+
+        cache_put(&writer, name, strlen(name) + 1);
+    }
+
+    if (fclose(writer.file) != 0)
+        writer.ok = 0;
+
+    return temp_commit(writer.ok, temp, index_path);
+}
+
+
+fastObjPartIndex* fast_obj_part_index_read(const char* path, const char* index_path)
+{
+    fastObjPartIndex* index;
+    fastObjPartHeader header;
+    fastObjMapping    map;
+    const char*       p;
+    const char*       end;
+    const char*       e;
+    uint64_t          size;
+    int64_t           time;
+    unsigned int      ii;
+    int               ok;
+
+
+    /* Stale indices are not used, the caller builds a new one */
+    if (!file_stat(path, &size, &time) || !file_map(&map, index_path, 0))
+        return 0;
+
+    ok = map.size >= sizeof(header);
+    if (ok)
+    {
+        memcpy(&header, map.data, sizeof(header));
+
+        ok = memcmp(header.magic, "obj_part", 8) == 0 &&
+             header.version == PART_INDEX_VERSION &&
+             header.part_size == sizeof(fastObjPart) &&
+             header.source_size == size &&
+             header.source_time == time &&
+             header.name_count > 0 &&
+             header.part_count <= (map.size - sizeof(header)) / sizeof(fastObjPart);
+    }
+
+    index = ok ? (fastObjPartIndex*)(memory_realloc(0, sizeof(fastObjPartIndex))) : 0;
+    if (!index)
+    {
+        file_unmap(&map);
+        return 0;
+    }
+
+    memset(index, 0, sizeof(fastObjPartIndex));
+    index->position_count = header.position_count;
+    index->texcoord_count = header.texcoord_count;
+    index->normal_count   = header.normal_count;
+    index->file_size      = header.source_size;
+    index->file_time      = header.source_time;
+
+    p   = map.data + sizeof(header);
+    end = map.data + map.size;
+
+    ok = array_reserve(index->parts, header.part_count) &&
+         array_reserve(index->names, header.name_count) &&
+         array_reserve(index->libraries, header.library_count);
+
+    if (ok)
+    {
+        if (header.part_count)
+            memcpy(index->parts, p, header.part_count * sizeof(fastObjPart));
+
+        _array_size(index->parts) = header.part_count;
+        p += header.part_count * sizeof(fastObjPart);
+
+        array_push(index->names, (char*)(0));
+    }
+
+    for (ii = 1; ok && ii < header.name_count + header.library_count; ii++)
+    {
+        e = (const char*)(memchr(p, '\0', (size_t)(end - p)));
+        if (!e)
+        {
+            ok = 0;
             break;
+        }
 
-        case 'i':
-            p++;
-            if (p[0] == 'l' &&
-                p[1] == 'l' &&
-                p[2] == 'u' &&
-                p[3] == 'm' &&
-                is_whitespace(p[4]))
+        if (ii < header.name_count)
+            array_push(index->names, string_copy(p, e));
+        else
+            array_push(index->libraries, string_copy(p, e));
+
+        p = e + 1;
+    }
+
+    for (ii = 0; ok && ii < header.part_count; ii++)
+    {
+        ok = index->parts[ii].object < header.name_count &&
+             index->parts[ii].group < header.name_count &&
+             index->parts[ii].material < header.name_count &&
+             index->parts[ii].offset + index->parts[ii].size <= size;
+    }
+
+    file_unmap(&map);
+
+    index->part_count    = array_size(index->parts);
+    index->name_count    = array_size(index->names);
+    index->library_count = array_size(index->libraries);
+
+    if (!ok)
+    {
+        fast_obj_part_index_destroy(index);
+        return 0;
+    }
+
+    return index;
+}
+
+
+static
+fastObjChunk* part_parse(const fastObjPartIndex* index, unsigned int part, const fastObjMapping* map)
+{
+    const fastObjPart* source = &index->parts[part];
+    fastObjChunk*      chunk;
+    char*              copy;
+    const char*        start;
+    size_t             size;
+
+
+    chunk = (fastObjChunk*)(scratch_realloc(0, sizeof(fastObjChunk)));
+    if (!chunk)
+        return 0;
+
+    memset(chunk, 0, sizeof(fastObjChunk));
+
+    /* Parsed in place unless the part is at the very end of the file */
+    start = map->data + source->offset;
+    size  = (size_t)(source->size);
+    copy  = 0;
+
+    if (source->offset + size + BUFFER_PADDING > map->size || !is_newline(start[size - 1]))
+    {
+        copy = (char*)(scratch_realloc(0, size + 1 + BUFFER_PADDING));
+        if (!copy)
+        {
+            scratch_dealloc(chunk);
+            return 0;
+        }
+
+        memcpy(copy, start, size);
+        copy[size++] = '\n';
+        memset(copy + size, 0, BUFFER_PADDING);
+        start = copy;
+    }
+
+    /* Materials come from the index, the part lines only have vertices and faces */
+    chunk->start           = start;
+    chunk->end             = start + size;
+    chunk->position_offset = source->position_base + 1;
+    chunk->texcoord_offset = source->texcoord_base + 1;
+    chunk->normal_offset   = source->normal_base + 1;
+    chunk->data.skip       = FAST_OBJ_SKIP_MATERIALS;
+
+    parse_chunk(chunk);
+
+    scratch_dealloc(copy);
+
+    return chunk;
+}
+
+
+static
+int compare_uint(const void* a, const void* b)
+{
+    fastObjUInt x = *(const fastObjUInt*)(a);
+    fastObjUInt y = *(const fastObjUInt*)(b);
+
+    return (x > y) - (x < y);
+}
+
+
+static
+fastObjUInt part_remap(const fastObjUInt* sources, fastObjUInt value)
+{
+    fastObjUInt lo;
+    fastObjUInt hi;
+    fastObjUInt mid;
+
+
+    /* Position in the sorted list + 1, 0 for unused values */
+    lo = 0;
+    hi = array_size(sources);
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (sources[mid] < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return (lo < array_size(sources) && sources[lo] == value) ? lo + 1 : 0;
+}
+
+
+static
+unsigned int part_base(const fastObjPart* part, unsigned int attribute)
+{
+    return (attribute == 0) ? part->position_base : (attribute == 1) ? part->texcoord_base : part->normal_base;
+}
+
+
+fastObjMesh* fast_obj_read_parts(const char* path, const fastObjPartIndex* index, const char* const* names, unsigned int name_count)
+{
+    fastObjCallbacks  callbacks;
+    fastObjMapping    map;
+    fastObjData       data;
+    fastObjMesh*      m;
+    fastObjMesh*      src;
+    fastObjChunk**    chunks;
+    unsigned char*    selected;
+    fastObjUInt*      sources[3];
+    float**           values[3];
+    const fastObjPart* part;
+    fastObjIndex      vn;
+    const char*       name;
+    unsigned int      counts[3];
+    unsigned int      widths[3];
+    unsigned int      object;
+    unsigned int      group;
+    unsigned int      attribute;
+    unsigned int      local;
+    unsigned int      colors;
+    unsigned int      ii;
+    fastObjUInt       jj;
+    fastObjUInt       kk;
+    fastObjUInt       index_offset;
+    fastObjUInt       fv;
+    uint64_t          size;
+    int64_t           time;
+    int               ok;
+
+
+    callbacks.file_open  = file_open;
+    callbacks.file_close = file_close;
+    callbacks.file_read  = file_read;
+    callbacks.file_size  = file_size;
+
+    /* Parts are byte ranges of the file the index was built from */
+    if (!file_stat(path, &size, &time) || size != index->file_size || time != index->file_time)
+        return 0;
+
+    if (!file_map(&map, path, 0))
+        return 0;
+
+    /* The file can still change after the stat, the ranges must fit the mapping */
+    for (ii = 0; ii < index->part_count; ii++)
+    {
+        part = &index->parts[ii];
+        if (part->size == 0 || part->offset > map.size || part->size > map.size - part->offset)
+        {
+            file_unmap(&map);
+            return 0;
+        }
+    }
+
+    m = mesh_create();
+    if (!m)
+    {
+        file_unmap(&map);
+        return 0;
+    }
+
+    chunks   = (fastObjChunk**)(scratch_realloc(0, (index->part_count + 1) * sizeof(fastObjChunk*)));
+    selected = (unsigned char*)(scratch_realloc(0, index->name_count + 1));
+
+    ok = chunks && selected;
+    if (ok)
+    {
+        memset(chunks, 0, (index->part_count + 1) * sizeof(fastObjChunk*));
+        memset(selected, 0, index->name_count + 1);
+    }
+
+    for (ii = 1; ok && ii < index->name_count; ii++)
+        for (jj = 0; jj < name_count && !selected[ii]; jj++)
+            selected[ii] = index->names[ii] && strcmp(index->names[ii], names[jj]) == 0;
+
+
+    /* Faces of the selected parts, in file indices */
+    for (ii = 0; ok && ii < index->part_count; ii++)
+    {
+        part = &index->parts[ii];
+        if (part->face_count > 0 && (selected[part->object] || selected[part->group]))
+        {
+            chunks[ii] = part_parse(index, ii, &map);
+            ok = chunks[ii] != 0;
+        }
+    }
+
+
+    /* Vertices they use, sorted so they are read part by part */
+    counts[0] = index->position_count;
+    counts[1] = index->texcoord_count;
+    counts[2] = index->normal_count;
+
+    widths[0] = 3;
+    widths[1] = 2;
+    widths[2] = 3;
+
+    memset(sources, 0, sizeof(sources));
+
+    for (ii = 0; ok && ii < index->part_count; ii++)
+    {
+        if (!chunks[ii])
+            continue;
+
+        src = &chunks[ii]->mesh;
+        for (jj = 0; jj < array_size(src->indices); jj++)
+        {
+            vn = src->indices[jj];
+
+            if (vn.p > 0 && vn.p <= counts[0])
+                array_push(sources[0], vn.p);
+            if (vn.t > 0 && vn.t <= counts[1])
+                array_push(sources[1], vn.t);
+            if (vn.n > 0 && vn.n <= counts[2])
+                array_push(sources[2], vn.n);
+        }
+    }
+
+    for (attribute = 0; attribute < 3; attribute++)
+    {
+        if (array_empty(sources[attribute]))
+            continue;
+
+        qsort(sources[attribute], array_size(sources[attribute]), sizeof(fastObjUInt), compare_uint);
+
+        kk = 1;
+        for (jj = 1; jj < array_size(sources[attribute]); jj++)
+            if (sources[attribute][jj] != sources[attribute][kk - 1])
+                sources[attribute][kk++] = sources[attribute][jj];
+
+        _array_size(sources[attribute]) = kk;
+    }
+
+
+    /* Parse the parts holding those vertices (usually the selected ones again) */
+    colors = 0;
+    for (attribute = 0; ok && attribute < 3; attribute++)
+    {
+        ii = 0;
+        for (jj = 0; ok && jj < array_size(sources[attribute]); jj++)
+        {
+            while (ii + 1 < index->part_count && part_base(&index->parts[ii + 1], attribute) < sources[attribute][jj])
+                ii++;
+
+            if (!chunks[ii])
             {
-                p = read_mtl_int(p + 4, &mtl.illum);
+                chunks[ii] = part_parse(index, ii, &map);
+                ok = chunks[ii] != 0;
             }
-            break;
 
-        case 'm':
-            p++;
-            if (p[0] == 'a' &&
-                p[1] == 'p' &&
-                p[2] == '_')
+            if (ok && attribute == 0 && !array_empty(chunks[ii]->mesh.colors))
+                colors = 1;
+        }
+    }
+
+
+    data_init(&data, m, path);
+    data.bounds_pending = 1;
+
+    for (ii = 0; ok && ii < index->library_count; ii++)
+        if (index->libraries[ii])
+            load_mtllib(&data, index->libraries[ii], index->libraries[ii] + strlen(index->libraries[ii]), &callbacks, 0);
+
+
+    /* Vertex data, the chunk of each vertex is found the same way */
+    if (ok && colors)
+        for (ii = 0; ii < 3; ii++)
+            array_push(m->colors, 1.0f);
+
+    values[0] = &m->positions;
+    values[1] = &m->texcoords;
+    values[2] = &m->normals;
+
+    for (attribute = 0; ok && attribute < 3; attribute++)
+    {
+        ok = array_reserve(*values[attribute], widths[attribute] * array_size(sources[attribute]));
+        if (ok && attribute == 0 && colors)
+            ok = array_reserve(m->colors, 3 * array_size(sources[0]));
+
+        ii = 0;
+        for (jj = 0; ok && jj < array_size(sources[attribute]); jj++)
+        {
+            while (ii + 1 < index->part_count && part_base(&index->parts[ii + 1], attribute) < sources[attribute][jj])
+                ii++;
+
+            src   = &chunks[ii]->mesh;
+            local = sources[attribute][jj] - part_base(&index->parts[ii], attribute) - 1;
+
+            if (attribute == 0)
             {
-                p += 3;
-                if (*p == 'K')
-                {
-                    p++;
-                    if (is_whitespace(p[1]))
-                    {
-                        if (*p == 'a')
-                            p = read_map(data, p + 1, &mtl.map_Ka);
-                        else if (*p == 'd')
-                            p = read_map(data, p + 1, &mtl.map_Kd);
-                        else if (*p == 's')
-                            p = read_map(data, p + 1, &mtl.map_Ks);
-                        else if (*p == 'e')
-                            p = read_map(data, p + 1, &mtl.map_Ke);
-                        else if (*p == 't')
-                            p = read_map(data, p + 1, &mtl.map_Kt);
-                    }
-                }
-                else if (*p == 'N')
-                {
-                    p++;
-                    if (is_whitespace(p[1]))
-                    {
-                        if (*p == 's')
-                            p = read_map(data, p + 1, &mtl.map_Ns);
-                        else if (*p == 'i')
-                            p = read_map(data, p + 1, &mtl.map_Ni);
-                    }
-                }
-                else if (*p == 'd')
+                if (local < array_size(src->positions) / 3)
                 {
-                    p++;
-                    if (is_whitespace(*p))
-                        p = read_map(data, p, &mtl.map_d);
+                    array_push(m->positions, src->positions[3 * local + 0]);
+                    array_push(m->positions, src->positions[3 * local + 1]);
+                    array_push(m->positions, src->positions[3 * local + 2]);
+                    bounds_add(data.bounds_min, data.bounds_max, src->positions + 3 * local);
                 }
-                else if ((p[0] == 'b' || p[0] == 'B') &&
-                         p[1] == 'u' &&
-                         p[2] == 'm' &&
-                         p[3] == 'p' &&
-                         is_whitespace(p[4]))
+                else
                 {
-                    p = read_map(data, p + 4, &mtl.map_bump);
+                    array_push(m->positions, 0.0f);
+                    array_push(m->positions, 0.0f);
+                    array_push(m->positions, 0.0f);
                 }
+
+                for (kk = 0; colors && kk < 3; kk++)
+                    array_push(m->colors, (local < array_size(src->colors) / 3) ? src->colors[3 * local + kk] : 1.0f);
             }
-            break;
+            else if (attribute == 1)
+            {
+                for (kk = 0; kk < 2; kk++)
+                    array_push(m->texcoords, (local < array_size(src->texcoords) / 2) ? src->texcoords[2 * local + kk] : 0.0f);
+            }
+            else
+            {
+                for (kk = 0; kk < 3; kk++)
+                    array_push(m->normals, (local < array_size(src->normals) / 3) ? src->normals[3 * local + kk] : 0.0f);
+            }
+        }
+    }
 
-        case '#':
-            break;
+
+    /* Faces in file order, with objects/groups and materials from the index */
+    object = 0;
+    group  = 0;
+    for (ii = 0; ok && ii < index->part_count; ii++)
+    {
+        part = &index->parts[ii];
+        if (!chunks[ii] || !(part->face_count > 0 && (selected[part->object] || selected[part->group])))
+            continue;
+
+        if (part->object != object)
+        {
+            object = part->object;
+            flush_object(&data);
+
+            name = index->names[object];
+            data.object.name = name ? string_copy(name, name + strlen(name)) : 0;
+        }
+
+        if (part->group != group)
+        {
+            group = part->group;
+            flush_group(&data);
+
+            name = index->names[group];
+            data.group.name = name ? string_copy(name, name + strlen(name)) : 0;
+        }
+
+        name = index->names[part->material];
+        if (name)
+            use_material(&data, name, name + strlen(name));
+        else
+            data.material = 0;
+
+        src = &chunks[ii]->mesh;
+        index_offset = 0;
+        for (jj = 0; jj < array_size(src->face_vertices); jj++)
+        {
+            fv = src->face_vertices[jj];
+
+            for (kk = 0; kk < fv; kk++)
+            {
+                vn = src->indices[index_offset + kk];
+                vn.p = part_remap(sources[0], vn.p);
+                vn.t = part_remap(sources[1], vn.t);
+                vn.n = part_remap(sources[2], vn.n);
+                array_push(m->indices, vn);
+            }
+
+            index_offset += fv;
+
+            array_push(m->face_vertices, fv);
+            array_push(m->face_materials, data.material);
+
+            if (src->face_lines || m->face_lines)
+            {
+                while (array_size(m->face_lines) + 1 < array_size(m->face_vertices))
+                    array_push(m->face_lines, 0);
+
+                array_push(m->face_lines, (unsigned char)((jj < array_size(src->face_lines)) ? src->face_lines[jj] : 0));
+            }
+
+            data.group.face_count++;
+            data.object.face_count++;
+            data.group.index_count  += fv;
+            data.object.index_count += fv;
         }
+    }
 
-        p = skip_line(p);
+    mesh_finish(&data);
+
+
+    for (ii = 0; chunks && ii < index->part_count; ii++)
+    {
+        if (chunks[ii])
+        {
+            chunk_clean(chunks[ii]);
+            scratch_dealloc(chunks[ii]);
+        }
     }
 
-    /* Push final material */
-    if (mtl.name)
-        array_push(data->mesh->materials, mtl);
+    for (attribute = 0; attribute < 3; attribute++)
+        array_clean(sources[attribute]);
 
-    memory_dealloc(contents);
+    scratch_dealloc(chunks);
+    scratch_dealloc(selected);
 
-    return 1;
+    file_unmap(&map);
+
+    if (!ok)
+    {
+        fast_obj_destroy(m);
+        return 0;
+    }
+
+    return m;
 }
 
 
+typedef struct
+{
+    const fastObjMesh*          mesh;
+    fastObjCompact*             compact;
+
+    /* Slice of every array encoded by the task */
+    unsigned int                task;
+    unsigned int                count;
+
+    /* Largest errors in the slice */
+    float                       position_error;
+    float                       texcoord_error;
+    float                       normal_error;
+    float                       color_error;
+
+} fastObjCompactTask;
+
+
 static
-const char* parse_mtllib(fastObjData* data, const char* ptr, const fastObjCallbacks* callbacks, void* user_data)
+unsigned int compact_size(uint64_t max)
 {
-    const char* s;
-    const char* e;
-    char*       lib;
-    void*       file;
+    return (max == 0) ? 0 : (max <= 0xff) ? 1 : (max <= 0xffff) ? 2 : (max <= 0xffffff) ? 3 : 4;
+}
 
 
-    ptr = skip_whitespace(ptr);
+static
+void compact_store(void* data, unsigned int size, size_t i, uint32_t value)
+{
+    unsigned char* p = (unsigned char*)(data) + i * size;
 
-    s = ptr;
-    ptr = skip_name(ptr);
-    e = ptr;
+    switch (size)
+    {
+    case 4: p[3] = (unsigned char)(value >> 24); /* fall through */
+    case 3: p[2] = (unsigned char)(value >> 16); /* fall through */
+    case 2: p[1] = (unsigned char)(value >> 8);  /* fall through */
+    case 1: p[0] = (unsigned char)(value);
+    }
+}
 
-    lib = string_concat(data->base, s, e);
-    if (lib)
+
+static
+uint32_t compact_load(const void* data, unsigned int size, size_t i)
+{
+    const unsigned char* p = (const unsigned char*)(data) + i * size;
+
+    switch (size)
     {
-        string_fix_separators(lib);
+    case 1: return p[0];
+    case 2: return p[0] | (uint32_t)(p[1]) << 8;
+    case 3: return p[0] | (uint32_t)(p[1]) << 8 | (uint32_t)(p[2]) << 16;
+    case 4: return p[0] | (uint32_t)(p[1]) << 8 | (uint32_t)(p[2]) << 16 | (uint32_t)(p[3]) << 24;
+    }
 
-        file = callbacks->file_open(lib, user_data);
-        if (file)
+    return 0;
+}
+
+
+static
+void* compact_alloc(fastObjCompact* compact, size_t count, size_t size, int* ok)
+{
+    void* p;
+
+
+    if (count == 0 || size == 0)
+        return 0;
+
+    p = memory_realloc(0, count * size);
+    if (!p)
+        *ok = 0;
+
+    compact->memory += count * size;
+
+    return p;
+}
+
+
+static
+float float_abs(float x)
+{
+    return (x < 0) ? -x : x;
+}
+
+
+static
+float float_sign(float x)
+{
+    return (x < 0) ? -1.0f : 1.0f;
+}
+
+
+static
+float float_rsqrt(float x)
+{
+    uint32_t i;
+    float    y;
+
+
+    /* Bit trick estimate refined to float precision */
+    memcpy(&i, &x, sizeof(float));
+    i = 0x5f3759df - (i >> 1);
+    memcpy(&y, &i, sizeof(float));
+
+    y = y * (1.5f - 0.5f * x * y * y);
+    y = y * (1.5f - 0.5f * x * y * y);
+    y = y * (1.5f - 0.5f * x * y * y);
+
+    return y;
+}
+
+
+static
+uint16_t half_from_float(float f)
+{
+    uint32_t x;
+    uint32_t sign;
+    float    v;
+
+
+    memcpy(&x, &f, sizeof(float));
+    sign = (x >> 16) & 0x8000;
+    x   &= 0x7fffffff;
+
+    /* Infinity/NaN, values rounding above 65504, subnormals */
+    if (x >= 0x7f800000)
+        return (uint16_t)(sign | 0x7c00 | ((x > 0x7f800000) ? 0x200 : 0));
+
+    if (x >= 0x477ff000)
+        return (uint16_t)(sign | 0x7c00);
+
+    if (x < 0x38800000)
+    {
+        memcpy(&v, &x, sizeof(float));
+        v = (v * 16777216.0f + 8388608.0f) - 8388608.0f;
+        return (uint16_t)(sign | (uint32_t)(v));
+    }
+
+    /* Rebias the exponent and round the mantissa to nearest even */
+    x += 0xc8000fff + ((x >> 13) & 1);
+
+    return (uint16_t)(sign | (x >> 13));
+}
+
+
+static
+float half_to_float(uint16_t h)
+{
+    uint32_t x;
+    uint32_t e;
+    float    f;
+
+
+    e = (h >> 10) & 0x1f;
+
+    if (e == 0)
+    {
+        f = (float)(h & 0x3ff) * (1.0f / 16777216.0f);
+        return (h & 0x8000) ? -f : f;
+    }
+
+    x = (uint32_t)(h & 0x8000) << 16;
+    if (e == 0x1f)
+        x |= 0x7f800000 | (uint32_t)(h & 0x3ff) << 13;
+    else
+        x |= (e + 112) << 23 | (uint32_t)(h & 0x3ff) << 13;
+
+    memcpy(&f, &x, sizeof(float));
+
+    return f;
+}
+
+
+static
+void octahedral_decode(float x, float y, float* n)
+{
+    float z;
+    float t;
+    float l;
+
+
+    z = 1.0f - float_abs(x) - float_abs(y);
+    if (z < 0)
+    {
+        t = (1.0f - float_abs(y)) * float_sign(x);
+        y = (1.0f - float_abs(x)) * float_sign(y);
+        x = t;
+    }
+
+    l = float_rsqrt(x * x + y * y + z * z);
+
+    n[0] = x * l;
+    n[1] = y * l;
+    n[2] = z * l;
+}
+
+
+static
+void octahedral_encode(const float* n, float range, int* q)
+{
+    float x;
+    float y;
+    float t;
+    float l;
+
+
+    /* Project on the octahedron, folding the lower half over the upper */
+    l = float_abs(n[0]) + float_abs(n[1]) + float_abs(n[2]);
+    if (!(l > 0))
+    {
+        q[0] = 0;
+        q[1] = 0;
+        return;
+    }
+
+    l = 1.0f / l;
+    x = n[0] * l;
+    y = n[1] * l;
+    if (n[2] < 0)
+    {
+        t = (1.0f - float_abs(y)) * float_sign(x);
+        y = (1.0f - float_abs(x)) * float_sign(y);
+        x = t;
+    }
+
+    q[0] = (int)(x * range + float_sign(x) * 0.5f);
+    q[1] = (int)(y * range + float_sign(y) * 0.5f);
+}
+
+
+static
+void compact_encode(void* arg)
+{
+    fastObjCompactTask* task    = (fastObjCompactTask*)(arg);
+    const fastObjMesh*  mesh    = task->mesh;
+    fastObjCompact*     compact = task->compact;
+    const float*        src;
+    unsigned short*     dst;
+    float               offset[3];
+    float               scale[3];
+    float               inverse[3];
+    float               decoded[3];
+    float               unit[3];
+    float               range;
+    float               maximum;
+    float               error;
+    float               l;
+    int                 q[2];
+    uint32_t            v;
+    size_t              begin;
+    size_t              end;
+    size_t              ii;
+    unsigned int        jj;
+
+
+    /* Positions relative to the box, in steps of position_scale; the box and
+       the running maximum live in locals so the stores cannot alias them */
+    for (jj = 0; jj < 3; jj++)
+    {
+        offset[jj]  = compact->position_offset[jj];
+        scale[jj]   = compact->position_scale[jj];
+        inverse[jj] = (scale[jj] > 0) ? 1.0f / scale[jj] : 0.0f;
+    }
+
+    begin   = (size_t)(compact->position_count) * task->task / task->count;
+    end     = (size_t)(compact->position_count) * (task->task + 1) / task->count;
+    src     = mesh->positions;
+    dst     = compact->positions;
+    maximum = 0;
+    for (ii = begin; ii < end; ii++)
+    {
+        for (jj = 0; jj < 3; jj++)
         {
-            read_mtllib(data, file, callbacks, user_data);
-            callbacks->file_close(file, user_data);
+            l = (src[3 * ii + jj] - offset[jj]) * inverse[jj] + 0.5f;
+            v = (l > 65535) ? 65535 : (l > 0) ? (uint32_t)(l) : 0;
+
+            dst[3 * ii + jj] = (unsigned short)(v);
+
+            error = float_abs(offset[jj] + (float)(v) * scale[jj] - src[3 * ii + jj]);
+            if (ii > 0 && error > maximum)
+                maximum = error;
         }
+    }
+    task->position_error = maximum;
 
-        memory_dealloc(lib);
+    begin = (size_t)(compact->texcoord_count) * task->task / task->count;
+    end   = (size_t)(compact->texcoord_count) * (task->task + 1) / task->count;
+    maximum = 0;
+    for (ii = 2 * begin; ii < 2 * end; ii++)
+    {
+        compact->texcoords[ii] = half_from_float(mesh->texcoords[ii]);
+
+        error = float_abs(half_to_float(compact->texcoords[ii]) - mesh->texcoords[ii]);
+        if (error > maximum)
+            maximum = error;
     }
 
-    return ptr;
+    task->texcoord_error = maximum;
+
+    /* Normals on the octahedron, error measured against the unit input */
+    range = (compact->normal_size == 1) ? 127.0f : 32767.0f;
+    begin = (size_t)(compact->normal_count) * task->task / task->count;
+    end   = (size_t)(compact->normal_count) * (task->task + 1) / task->count;
+    maximum = 0;
+    for (ii = begin; ii < end; ii++)
+    {
+        octahedral_encode(mesh->normals + 3 * ii, range, q);
+
+        compact_store(compact->normals, compact->normal_size, 2 * ii + 0, (uint32_t)(q[0]));
+        compact_store(compact->normals, compact->normal_size, 2 * ii + 1, (uint32_t)(q[1]));
+
+        l = mesh->normals[3 * ii + 0] * mesh->normals[3 * ii + 0] +
+            mesh->normals[3 * ii + 1] * mesh->normals[3 * ii + 1] +
+            mesh->normals[3 * ii + 2] * mesh->normals[3 * ii + 2];
+        if (l > 0)
+        {
+            octahedral_decode((float)(q[0]) / range, (float)(q[1]) / range, decoded);
+
+            l = float_rsqrt(l);
+            for (jj = 0; jj < 3; jj++)
+                unit[jj] = mesh->normals[3 * ii + jj] * l - decoded[jj];
+
+            error = unit[0] * unit[0] + unit[1] * unit[1] + unit[2] * unit[2];
+            error = (error > 0) ? error * float_rsqrt(error) : 0;
+            if (error > maximum)
+                maximum = error;
+        }
+    }
+
+    task->normal_error = maximum;
+
+    begin = (size_t)(compact->color_count) * task->task / task->count;
+    end   = (size_t)(compact->color_count) * (task->task + 1) / task->count;
+    maximum = 0;
+    for (ii = 3 * begin; ii < 3 * end; ii++)
+    {
+        l = mesh->colors[ii] * 255.0f + 0.5f;
+        v = (l > 255) ? 255 : (l > 0) ? (uint32_t)(l) : 0;
+
+        compact->colors[ii] = (unsigned char)(v);
+
+        error = float_abs((float)(v) / 255.0f - mesh->colors[ii]);
+        if (error > maximum)
+            maximum = error;
+    }
+
+    task->color_error = maximum;
+
+    begin = (size_t)(compact->face_count) * task->task / task->count;
+    end   = (size_t)(compact->face_count) * (task->task + 1) / task->count;
+    for (ii = begin; ii < end; ii++)
+    {
+        compact_store(compact->face_vertices, compact->face_vertex_size, ii, mesh->face_vertices[ii]);
+        compact_store(compact->face_materials, compact->face_material_size, ii, mesh->face_materials[ii]);
+    }
+
+    /* Shared index arrays are only written once */
+    begin = (size_t)(compact->index_count) * task->task / task->count;
+    end   = (size_t)(compact->index_count) * (task->task + 1) / task->count;
+    for (ii = begin; ii < end; ii++)
+        compact_store(compact->position_indices, compact->position_index_size, ii, (uint32_t)(mesh->indices[ii].p));
+
+    if (compact->texcoord_indices != compact->position_indices)
+        for (ii = begin; ii < end; ii++)
+            compact_store(compact->texcoord_indices, compact->texcoord_index_size, ii, (uint32_t)(mesh->indices[ii].t));
+
+    if (compact->normal_indices != compact->position_indices)
+        for (ii = begin; ii < end; ii++)
+            compact_store(compact->normal_indices, compact->normal_index_size, ii, (uint32_t)(mesh->indices[ii].n));
 }
 
 
 static
-void parse_buffer(fastObjData* data, const char* ptr, const char* end, const fastObjCallbacks* callbacks, void* user_data)
+fastObjGroup* compact_groups(const fastObjGroup* groups, unsigned int count, fastObjCompact* compact, int* ok)
 {
-    const char* p;
-    
-    
-    p = ptr;
-    while (p != end)
+    fastObjGroup* copy;
+    unsigned int  ii;
+
+
+    copy = (fastObjGroup*)(compact_alloc(compact, count, sizeof(fastObjGroup), ok));
+    if (!copy)
+        return 0;
+
+    for (ii = 0; ii < count; ii++)
     {
-        p = skip_whitespace(p);
+        copy[ii] = groups[ii];
+        copy[ii].name = groups[ii].name ? string_copy(groups[ii].name, groups[ii].name + strlen(groups[ii].name)) : 0;
+    }
 
-        switch (*p)
-        {
-        case 'v':
-            p++;
+    return copy;
+}
 
-            switch (*p++)
-            {
-            case ' ':
-            case '\t':
-                p = parse_vertex(data, p);
-                break;
 
-            case 't':
-                p = parse_texcoord(data, p);
-                break;
+void fast_obj_compact_destroy(fastObjCompact* compact)
+{
+    unsigned int ii;
 
-            case 'n':
-                p = parse_normal(data, p);
-                break;
 
-            default:
-                p--; /* roll p++ back in case *p was a newline */
-            }
-            break;
+    for (ii = 0; compact->materials && ii < compact->material_count; ii++)
+        memory_dealloc(compact->materials[ii].name);
 
-        case 'f':
-            p++;
+    for (ii = 0; compact->textures && ii < compact->texture_count; ii++)
+    {
+        memory_dealloc(compact->textures[ii].name);
+        memory_dealloc(compact->textures[ii].path);
+    }
 
-            switch (*p++)
-            {
-            case ' ':
-            case '\t':
-                p = parse_face(data, p, 0);
-                break;
+    for (ii = 0; compact->objects && ii < compact->object_count; ii++)
+        memory_dealloc(compact->objects[ii].name);
+
+    for (ii = 0; compact->groups && ii < compact->group_count; ii++)
+        memory_dealloc(compact->groups[ii].name);
+
+    if (compact->texcoord_indices != compact->position_indices)
+        memory_dealloc(compact->texcoord_indices);
+    if (compact->normal_indices != compact->position_indices)
+        memory_dealloc(compact->normal_indices);
+
+    memory_dealloc(compact->positions);
+    memory_dealloc(compact->texcoords);
+    memory_dealloc(compact->normals);
+    memory_dealloc(compact->colors);
+    memory_dealloc(compact->face_vertices);
+    memory_dealloc(compact->face_materials);
+    memory_dealloc(compact->face_lines);
+    memory_dealloc(compact->position_indices);
+    memory_dealloc(compact->materials);
+    memory_dealloc(compact->textures);
+    memory_dealloc(compact->objects);
+    memory_dealloc(compact->groups);
+    memory_dealloc(compact);
+}
+
+
+fastObjCompact* fast_obj_compact_create(const fastObjMesh* mesh, unsigned int flags, unsigned int thread_count)
+{
+    fastObjCompactTask tasks[MAX_THREADS];
+    fastObjCompact*    compact;
+    fastObjUInt        max_p;
+    fastObjUInt        max_t;
+    fastObjUInt        max_n;
+    fastObjUInt        max_fv;
+    fastObjIndex       vn;
+    int                shared_t;
+    int                shared_n;
+    unsigned int       count;
+    unsigned int       items;
+    unsigned int       ii;
+    int                ok;
+
+
+    compact = (fastObjCompact*)(memory_realloc(0, sizeof(fastObjCompact)));
+    if (!compact)
+        return 0;
+
+    memset(compact, 0, sizeof(fastObjCompact));
+    memcpy(compact->bounds_min, mesh->bounds_min, sizeof(compact->bounds_min));
+    memcpy(compact->bounds_max, mesh->bounds_max, sizeof(compact->bounds_max));
+
+    compact->position_count = mesh->position_count;
+    compact->texcoord_count = mesh->texcoord_count;
+    compact->normal_count   = mesh->normal_count;
+    compact->color_count    = mesh->color_count;
+    compact->face_count     = mesh->face_count;
+    compact->index_count    = mesh->index_count;
+    compact->material_count = mesh->material_count;
+    compact->texture_count  = mesh->texture_count;
+    compact->object_count   = mesh->object_count;
+    compact->group_count    = mesh->group_count;
+
+
+    /* Index widths come from the largest values, texcoord/normal indices
+       equal to the position ones (f v/v/v) share their array */
+    max_p    = 0;
+    max_t    = 0;
+    max_n    = 0;
+    shared_t = 1;
+    shared_n = 1;
+    for (ii = 0; ii < mesh->index_count; ii++)
+    {
+        vn = mesh->indices[ii];
+
+        max_p = (vn.p > max_p) ? vn.p : max_p;
+        max_t = (vn.t > max_t) ? vn.t : max_t;
+        max_n = (vn.n > max_n) ? vn.n : max_n;
 
-            default:
-                p--; /* roll p++ back in case *p was a newline */
-            }
-            break;
+        shared_t &= vn.t == vn.p;
+        shared_n &= vn.n == vn.p;
+    }
 
-        case 'l':
-            p++;
+    max_fv = 0;
+    for (ii = 0; ii < mesh->face_count; ii++)
+        max_fv = (mesh->face_vertices[ii] > max_fv) ? mesh->face_vertices[ii] : max_fv;
 
-            switch (*p++)
-            {
-            case ' ':
-            case '\t':
-                p = parse_face(data, p, 1);
-                break;
+    compact->position_index_size = compact_size(max_p);
+    compact->texcoord_index_size = compact_size(max_t);
+    compact->normal_index_size   = compact_size(max_n);
+    compact->face_vertex_size    = compact_size(max_fv);
+    compact->face_material_size  = compact_size(mesh->material_count ? mesh->material_count - 1 : 0);
+    compact->normal_size         = (flags & FAST_OBJ_COMPACT_NORMALS_8) ? 1 : 2;
 
-            default:
-                p--; /* roll p++ back in case *p was a newline */
-            }
-            break;
+    /* Wider FAST_OBJ_UINT_TYPE indices must still fit in 32 bits */
+    ok = ((max_p | max_t | max_n) >> 16 >> 16) == 0;
 
-        case 'o':
-            p++;
 
-            switch (*p++)
-            {
-            case ' ':
-            case '\t':
-                p = parse_object(data, p);
-                break;
+    /* Quantization steps over the mesh box */
+    for (ii = 0; ii < 3; ii++)
+    {
+        compact->position_offset[ii] = mesh->bounds_min[ii];
+        compact->position_scale[ii]  = (mesh->bounds_max[ii] - mesh->bounds_min[ii]) / 65535.0f;
+    }
 
-            default:
-                p--; /* roll p++ back in case *p was a newline */
-            }
-            break;
+    compact->positions        = (unsigned short*)(compact_alloc(compact, 3 * (size_t)(mesh->position_count), sizeof(unsigned short), &ok));
+    compact->texcoords        = (unsigned short*)(compact_alloc(compact, 2 * (size_t)(mesh->texcoord_count), sizeof(unsigned short), &ok));
+    compact->normals          = compact_alloc(compact, 2 * (size_t)(mesh->normal_count), compact->normal_size, &ok);
+    compact->colors           = (unsigned char*)(compact_alloc(compact, 3 * (size_t)(mesh->color_count), 1, &ok));
+    compact->face_vertices    = compact_alloc(compact, mesh->face_count, compact->face_vertex_size, &ok);
+    compact->face_materials   = compact_alloc(compact, mesh->face_count, compact->face_material_size, &ok);
+    compact->face_lines       = mesh->face_lines ? (unsigned char*)(compact_alloc(compact, mesh->face_count, 1, &ok)) : 0;
+    compact->position_indices = compact_alloc(compact, mesh->index_count, compact->position_index_size, &ok);
+
+    if (shared_t && compact->texcoord_index_size)
+        compact->texcoord_indices = compact->position_indices;
+    else
+        compact->texcoord_indices = compact_alloc(compact, mesh->index_count, compact->texcoord_index_size, &ok);
 
-        case 'g':
-            p++;
+    if (shared_n && compact->normal_index_size)
+        compact->normal_indices = compact->position_indices;
+    else
+        compact->normal_indices = compact_alloc(compact, mesh->index_count, compact->normal_index_size, &ok);
 
-            switch (*p++)
-            {
-            case ' ':
-            case '\t':
-                p = parse_group(data, p);
-                break;
+    if (compact->face_lines)
+        memcpy(compact->face_lines, mesh->face_lines, mesh->face_count);
 
-            default:
-                p--; /* roll p++ back in case *p was a newline */
-            }
-            break;
 
-        case 'm':
-            p++;
-            if (p[0] == 't' &&
-                p[1] == 'l' &&
-                p[2] == 'l' &&
-                p[3] == 'i' &&
-                p[4] == 'b' &&
-                is_whitespace(p[5]))
-                p = parse_mtllib(data, p + 5, callbacks, user_data);
-            break;
+    /* Materials, textures and groups are copied so the mesh can be destroyed */
+    compact->materials = (fastObjMaterial*)(compact_alloc(compact, mesh->material_count, sizeof(fastObjMaterial), &ok));
+    for (ii = 0; compact->materials && ii < mesh->material_count; ii++)
+    {
+        compact->materials[ii] = mesh->materials[ii];
+        compact->materials[ii].name = mesh->materials[ii].name ? string_copy(mesh->materials[ii].name, mesh->materials[ii].name + strlen(mesh->materials[ii].name)) : 0;
+    }
 
-        case 'u':
-            p++;
-            if (p[0] == 's' &&
-                p[1] == 'e' &&
-                p[2] == 'm' &&
-                p[3] == 't' &&
-                p[4] == 'l' &&
-                is_whitespace(p[5]))
-                p = parse_usemtl(data, p + 5);
-            break;
+    compact->textures = (fastObjTexture*)(compact_alloc(compact, mesh->texture_count, sizeof(fastObjTexture), &ok));
+    for (ii = 0; compact->textures && ii < mesh->texture_count; ii++)
+    {
+        compact->textures[ii].name = mesh->textures[ii].name ? string_copy(mesh->textures[ii].name, mesh->textures[ii].name + strlen(mesh->textures[ii].name)) : 0;
+        compact->textures[ii].path = mesh->textures[ii].path ? string_copy(mesh->textures[ii].path, mesh->textures[ii].path + strlen(mesh->textures[ii].path)) : 0;
+    }
 
-        case '#':
-            break;
-        }
+    compact->objects = compact_groups(mesh->objects, mesh->object_count, compact, &ok);
+    compact->groups  = compact_groups(mesh->groups, mesh->group_count, compact, &ok);
 
-        p = skip_line(p);
+    if (!ok)
+    {
+        fast_obj_compact_destroy(compact);
+        return 0;
+    }
 
-        data->line++;
+
+    /* Every thread encodes a slice of each array */
+    items = mesh->position_count > mesh->index_count ? mesh->position_count : mesh->index_count;
+
+    count = thread_count ? thread_count : thread_count_default();
+    if (count > items / MIN_COMPACT_ITEMS)
+        count = items / MIN_COMPACT_ITEMS;
+    if (count > MAX_THREADS)
+        count = MAX_THREADS;
+    if (count < 1)
+        count = 1;
+
+    memset(tasks, 0, sizeof(tasks));
+    for (ii = 0; ii < count; ii++)
+    {
+        tasks[ii].mesh    = mesh;
+        tasks[ii].compact = compact;
+        tasks[ii].task    = ii;
+        tasks[ii].count   = count;
     }
-    if (array_size(data->mesh->colors) > 0)
+
+    run_tasks(compact_encode, tasks, sizeof(fastObjCompactTask), count);
+
+    for (ii = 0; ii < count; ii++)
     {
-        /* Fill the remaining slots in the colors array */
-        unsigned int ii;
-        for (ii = array_size(data->mesh->colors); ii < array_size(data->mesh->positions); ++ii)
-        {
-            array_push(data->mesh->colors, 1.0f);
-        }
+        if (tasks[ii].position_error > compact->position_error)
+            compact->position_error = tasks[ii].position_error;
+        if (tasks[ii].texcoord_error > compact->texcoord_error)
+            compact->texcoord_error = tasks[ii].texcoord_error;
+        if (tasks[ii].normal_error > compact->normal_error)
+            compact->normal_error = tasks[ii].normal_error;
+        if (tasks[ii].color_error > compact->color_error)
+            compact->color_error = tasks[ii].color_error;
     }
+
+    return compact;
 }
 
 
-void fast_obj_destroy(fastObjMesh* m)
+void fast_obj_compact_position(const fastObjCompact* compact, unsigned int index, float* xyz)
 {
     unsigned int ii;
 
 
-    for (ii = 0; ii < array_size(m->objects); ii++)
-        object_clean(&m->objects[ii]);
+    /* The dummy position stays at the origin */
+    for (ii = 0; ii < 3; ii++)
+        xyz[ii] = index ? compact->position_offset[ii] + (float)(compact->positions[3 * index + ii]) * compact->position_scale[ii] : 0.0f;
+}
 
-    for (ii = 0; ii < array_size(m->groups); ii++)
-        group_clean(&m->groups[ii]);
 
-    for (ii = 0; ii < array_size(m->materials); ii++)
-        mtl_clean(&m->materials[ii]);
+void fast_obj_compact_texcoord(const fastObjCompact* compact, unsigned int index, float* uv)
+{
+    uv[0] = half_to_float(compact->texcoords[2 * index + 0]);
+    uv[1] = half_to_float(compact->texcoords[2 * index + 1]);
+}
 
-    for (ii = 0; ii < array_size(m->textures); ii++)
-        map_clean(&m->textures[ii]);
 
-    array_clean(m->positions);
-    array_clean(m->texcoords);
-    array_clean(m->normals);
-    array_clean(m->colors);
-    array_clean(m->face_vertices);
-    array_clean(m->face_materials);
-    array_clean(m->face_lines);
-    array_clean(m->indices);
-    array_clean(m->objects);
-    array_clean(m->groups);
-    array_clean(m->materials);
-    array_clean(m->textures);
+void fast_obj_compact_normal(const fastObjCompact* compact, unsigned int index, float* xyz)
+{
+    float    range;
+    int32_t  x;
+    int32_t  y;
+    uint32_t sign;
 
-    memory_dealloc(m);
+
+    /* Stored values are two's complement, sign extend them */
+    range = (compact->normal_size == 1) ? 127.0f : 32767.0f;
+    sign  = (compact->normal_size == 1) ? 0x80 : 0x8000;
+
+    x = (int32_t)((compact_load(compact->normals, compact->normal_size, 2 * (size_t)(index) + 0) ^ sign) - sign);
+    y = (int32_t)((compact_load(compact->normals, compact->normal_size, 2 * (size_t)(index) + 1) ^ sign) - sign);
+
+    octahedral_decode((float)(x) / range, (float)(y) / range, xyz);
 }
 
 
-fastObjMesh* fast_obj_read(const char* path)
+void fast_obj_compact_color(const fastObjCompact* compact, unsigned int index, float* rgb)
 {
-    fastObjCallbacks callbacks;
-    callbacks.file_open = file_open;
-    callbacks.file_close = file_close;
-    callbacks.file_read = file_read;
-    callbacks.file_size = file_size;
+    unsigned int ii;
 
-    return fast_obj_read_with_callbacks(path, &callbacks, 0);
+
+    for (ii = 0; ii < 3; ii++)
+        rgb[ii] = (float)(compact->colors[3 * index + ii]) / 255.0f;
 }
 
 
-fastObjMesh* fast_obj_read_with_callbacks(const char* path, const fastObjCallbacks* callbacks, void* user_data)
+fastObjIndex fast_obj_compact_index(const fastObjCompact* compact, unsigned int corner)
 {
-    fastObjData  data;
-    fastObjMesh* m;
-    void*        file;
-    char*        buffer;
-    char*        start;
-    char*        end;
-    char*        last;
-    fastObjUInt  read;
-    fastObjUInt  bytes;
+    fastObjIndex vn;
 
-    /* Check if callbacks are valid */
-    if(!callbacks)
-        return 0;
 
+    vn.p = compact_load(compact->position_indices, compact->position_index_size, corner);
+    vn.t = compact_load(compact->texcoord_indices, compact->texcoord_index_size, corner);
+    vn.n = compact_load(compact->normal_indices, compact->normal_index_size, corner);
 
-    /* Open file */
-    file = callbacks->file_open(path, user_data);
-    if (!file)
-        return 0;
+    return vn;
+}
 
 
-    /* Empty mesh */
-    m = (fastObjMesh*)(memory_realloc(0, sizeof(fastObjMesh)));
-    if (!m)
-        return 0;
+unsigned int fast_obj_compact_face_vertices(const fastObjCompact* compact, unsigned int face)
+{
+    return compact_load(compact->face_vertices, compact->face_vertex_size, face);
+}
 
-    m->positions      = 0;
-    m->texcoords      = 0;
-    m->normals        = 0;
-    m->colors         = 0;
-    m->face_vertices  = 0;
-    m->face_materials = 0;
-    m->face_lines     = 0;
-    m->indices        = 0;
-    m->materials      = 0;
-    m->textures       = 0;
-    m->objects        = 0;
-    m->groups         = 0;
 
+unsigned int fast_obj_compact_face_material(const fastObjCompact* compact, unsigned int face)
+{
+    return compact_load(compact->face_materials, compact->face_material_size, face);
+}
 
-    /* Add dummy position/texcoord/normal/texture */
-    array_push(m->positions, 0.0f);
-    array_push(m->positions, 0.0f);
-    array_push(m->positions, 0.0f);
 
-    array_push(m->texcoords, 0.0f);
-    array_push(m->texcoords, 0.0f);
+typedef struct
+{
+    uint64_t                    size;
+    unsigned int                index;
 
-    array_push(m->normals, 0.0f);
-    array_push(m->normals, 0.0f);
-    array_push(m->normals, 1.0f);
+} fastObjBatchFile;
 
-    array_push(m->textures, map_default());
+typedef struct
+{
+    const char* const*          paths;
+    const fastObjBatchOptions*  options;
+    fastObjReadOptions          read_options;
+    fastObjBatchResult*         results;
 
+    /* Files in the order they are handed out, and the next one to hand out */
+    fastObjBatchFile*           files;
+    unsigned int                count;
+    unsigned int                next;
+    fastObjMutex*               mutex;
 
-    /* Data needed during parsing */
-    data.mesh     = m;
-    data.object   = object_default();
-    data.group    = group_default();
-    data.material = 0;
-    data.line     = 1;
-    data.base     = 0;
+    double                      start;
 
+} fastObjBatch;
 
-    /* Find base path for materials/textures */
-    {
-        const char* sep1 = strrchr(path, FAST_OBJ_SEPARATOR);
-        const char* sep2 = strrchr(path, FAST_OBJ_OTHER_SEP);
 
-        /* Use the last separator in the path */
-        const char* sep = sep2 && (!sep1 || sep1 < sep2) ? sep2 : sep1;
+static
+double time_seconds(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)(counter.QuadPart) / (double)(frequency.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)(t.tv_sec) + (double)(t.tv_nsec) * 1e-9;
+#else
+    struct timeval t;
+    gettimeofday(&t, 0);
+    return (double)(t.tv_sec) + (double)(t.tv_usec) * 1e-6;
+#endif
+}
 
-        if (sep)
-            data.base = string_substr(path, 0, sep - path + 1);
-    }
 
+static
+int compare_batch_file(const void* a, const void* b)
+{
+    const fastObjBatchFile* fa = (const fastObjBatchFile*)(a);
+    const fastObjBatchFile* fb = (const fastObjBatchFile*)(b);
 
-    /* Create buffer for reading file */
-    buffer = (char*)(memory_realloc(0, 2 * BUFFER_SIZE * sizeof(char)));
-    if (!buffer)
-        return 0;
+    if (fa->size != fb->size)
+        return (fa->size > fb->size) ? -1 : 1;
 
-    start = buffer;
+    return (fa->index > fb->index) - (fa->index < fb->index);
+}
+
+
+static
+void batch_read(void* arg)
+{
+    fastObjBatch*       batch = (fastObjBatch*)(arg);
+    fastObjBatchResult* result;
+    const char*         path;
+    unsigned int        ii;
+
+
+    /* Every worker takes the next file until there are none left */
     for (;;)
     {
-        /* Read another buffer's worth from file */
-        read = (fastObjUInt)(callbacks->file_read(file, start, BUFFER_SIZE, user_data));
-        if (read == 0 && start == buffer)
+        mutex_lock(batch->mutex);
+        ii = (batch->next < batch->count) ? batch->files[batch->next++].index : batch->count;
+        mutex_unlock(batch->mutex);
+
+        if (ii == batch->count)
             break;
 
+        path   = batch->paths[ii];
+        result = &batch->results[ii];
 
-        /* Ensure buffer ends in a newline */
-        if (read < BUFFER_SIZE)
-        {
-            if (read == 0 || start[read - 1] != '\n')
-                start[read++] = '\n';
-        }
+        result->start = time_seconds() - batch->start;
 
-        end = start + read;
-        if (end == buffer)
-            break;
+        if (batch->options->cached)
+            result->mesh = fast_obj_read_cached(path, batch->options->cache_dir, &batch->read_options);
+        else
+            result->mesh = fast_obj_read_with_options(path, 0, 0, &batch->read_options);
 
+        result->seconds = time_seconds() - batch->start - result->start;
+    }
+}
 
-        /* Find last new line */
-        last = end;
-        while (last > buffer)
-        {
-            last--;
-            if (*last == '\n')
-                break;
-        }
 
+fastObjBatchOptions fast_obj_batch_options_default(void)
+{
+    fastObjBatchOptions options;
 
-        /* Check there actually is a new line */
-        if (*last != '\n')
-            break;
+    options.thread_count = 0;
+    options.options      = fast_obj_read_options_default();
+    options.cached       = 0;
+    options.cache_dir    = 0;
 
-        last++;
+    return options;
+}
 
 
-        /* Process buffer */
-        parse_buffer(&data, buffer, last, callbacks, user_data);
+unsigned int fast_obj_read_batch(const char* const* paths, unsigned int count, const fastObjBatchOptions* options, fastObjBatchResult* results)
+{
+    fastObjBatchOptions default_options;
+    fastObjBatch        batch;
+    fastObjMutex        mutex = FAST_OBJ_MUTEX_INIT;
+    unsigned int        processors;
+    unsigned int        workers;
+    unsigned int        loaded;
+    unsigned int        ii;
+    int64_t             modified;
 
 
-        /* Copy overflow for next buffer */
-        bytes = (fastObjUInt)(end - last);
-        memmove(buffer, last, bytes);
-        start = buffer + bytes;
+    if (!paths || !results)
+        return 0;
+
+    if (!options)
+    {
+        default_options = fast_obj_batch_options_default();
+        options = &default_options;
     }
 
+    for (ii = 0; ii < count; ii++)
+    {
+        results[ii].mesh    = 0;
+        results[ii].start   = 0;
+        results[ii].seconds = 0;
+    }
 
-    /* Flush final object/group */
-    flush_object(&data);
-    object_clean(&data.object);
+    if (count == 0)
+        return 0;
 
-    flush_group(&data);
-    group_clean(&data.group);
+    batch.files = (fastObjBatchFile*)(scratch_realloc(0, count * sizeof(fastObjBatchFile)));
+    if (!batch.files)
+        return 0;
 
-    m->position_count = array_size(m->positions) / 3;
-    m->texcoord_count = array_size(m->texcoords) / 2;
-    m->normal_count   = array_size(m->normals) / 3;
-    m->color_count    = array_size(m->colors) / 3;
-    m->face_count     = array_size(m->face_vertices);
-    m->index_count    = array_size(m->indices);
-    m->material_count = array_size(m->materials);
-    m->texture_count  = array_size(m->textures);
-    m->object_count   = array_size(m->objects);
-    m->group_count    = array_size(m->groups);
 
+    /* Largest files first, so a big file is not left running alone at the end */
+    for (ii = 0; ii < count; ii++)
+    {
+        batch.files[ii].index = ii;
+        if (!file_stat(paths[ii], &batch.files[ii].size, &modified))
+            batch.files[ii].size = 0;
+    }
 
-    /* Clean up */
-    memory_dealloc(buffer);
-    memory_dealloc(data.base);
+    qsort(batch.files, count, sizeof(fastObjBatchFile), compare_batch_file);
 
-    callbacks->file_close(file, user_data);
+    processors = thread_count_default();
 
-    return m;
+    workers = options->thread_count ? options->thread_count : processors;
+    if (workers > count)
+        workers = count;
+    if (workers > MAX_THREADS)
+        workers = MAX_THREADS;
+
+    batch.paths        = paths;
+    batch.options      = options;
+    batch.read_options = options->options;
+    batch.results      = results;
+    batch.count        = count;
+    batch.next         = 0;
+    batch.mutex        = &mutex;
+    batch.start        = time_seconds();
+
+    if (batch.read_options.thread_count == 0)
+        batch.read_options.thread_count = (processors > workers) ? processors / workers : 1;
+
+    /* Every worker shares the one batch */
+    run_tasks(batch_read, &batch, 0, workers);
+
+    scratch_dealloc(batch.files);
+
+    loaded = 0;
+    for (ii = 0; ii < count; ii++)
+        loaded += results[ii].mesh != 0;
+
+    return loaded;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -190,6 +190,20 @@ RECENT REVISION HISTORY:
 //   // returns ok=1 and sets x, y, n if image is a supported format,
 //   // 0 otherwise.
 //
+// Together with stbi_info, the stbi_load_into family decodes into memory you
+// provide (a reused staging buffer, a mapped pixel buffer, ...) instead of
+// returning a new allocation:
+//
+//   ok = stbi_load_into(filename, buffer, buffer_size, &x, &y, &n, 0);
+//   // returns ok=1 with the image in buffer, laid out as above
+//
+// JPEG images, and 8-bit non-interlaced PNG images that need no palette or
+// channel conversion, are decoded straight into the buffer (JPEG needs one
+// spare byte past the image for that); other images are decoded as usual
+// and copied. If the image does not fit, it returns 0 with
+// stbi_failure_reason() "buffer too small", and sets *x, *y and
+// *channels_in_file. The other loaders never touch the buffer.
+//
 // Note that stb_image pervasively uses ints in its public API for sizes,
 // including sizes of memory buffers. This is now part of the API and thus
 // hard to change without causing breakage. As a result, the various image
@@ -270,6 +284,18 @@ RECENT REVISION HISTORY:
 // (at least this is true for iOS and Android). Therefore, the NEON support is
 // toggled by a build flag: define STBI_NEON to get NEON loops.
 //
+// When SSE2 is in use, the JPEG decoder additionally has AVX2 versions of
+// the IDCT, YCbCr-to-RGB and 2x2 upsampling kernels. They are compiled with
+// a per-function target attribute (no -mavx2 needed) and only chosen when a
+// run-time check finds AVX2 support in both the CPU and the OS. They produce
+// the same output as the SSE2 and generic C kernels. Define STBI_NO_AVX2 to
+// leave them out.
+//
+// On 64-bit little-endian targets the zlib decoder (PNG, and the
+// stbi_zlib_decode_* functions) uses a faster loop with a 64-bit bit buffer
+// and chunked match copies. It is plain C, not SIMD; define
+// STBI_NO_ZFAST_LOOP to use only the byte-at-a-time decoder.
+//
 // If for some reason you do not want to use any of SIMD code, or if
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
@@ -429,6 +455,15 @@ STBIDEF stbi_uc *stbi_load_from_file  (FILE *f, int *x, int *y, int *channels_in
 // for stbi_load_from_file, file pointer is left pointing immediately after image
 #endif
 
+// decode into a caller buffer of buffer_size bytes; returns 1 on success
+STBIDEF int stbi_load_into_from_memory   (stbi_uc           const *buffer, int len   , stbi_uc *out, size_t out_size, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_into_from_callbacks(stbi_io_callbacks const *clbk  , void *user, stbi_uc *out, size_t out_size, int *x, int *y, int *channels_in_file, int desired_channels);
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_into          (char const *filename, stbi_uc *out, size_t out_size, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_into_from_file(FILE *f, stbi_uc *out, size_t out_size, int *x, int *y, int *channels_in_file, int desired_channels);
+#endif
+
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp);
 #endif
@@ -750,7 +785,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    int info3 = stbi__cpuid3();
@@ -761,7 +796,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    // If we're even attempting to compile this on GCC/Clang, that means
@@ -774,6 +809,54 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 JPEG kernels, on top of SSE2. Only the kernel functions are compiled
+// for AVX2 (via the target attribute on GCC/Clang), and they are only called
+// after stbi__avx2_available() says the CPU and OS support it.
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && !defined(STBI_NO_JPEG)
+#if defined(_MSC_VER) && !defined(__clang__)
+#if _MSC_VER >= 1800 // VS2013: AVX2 intrinsics and _xgetbv
+#define STBI_AVX2
+#define STBI__AVX2_TARGET
+#endif
+#elif defined(__clang__) && defined(__has_attribute)
+#if __has_attribute(target) && ((__clang_major__ > 3) || (__clang_major__ == 3 && __clang_minor__ >= 8))
+#define STBI_AVX2
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#elif defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+// gcc 4.9 is the first to allow AVX2 intrinsics in target("avx2") functions
+// without -mavx2 on the command line
+#define STBI_AVX2
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+#ifdef STBI_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+static int stbi__avx2_available(void)
+{
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < 7)
+      return 0;
+   // the OS has to save the YMM registers (OSXSAVE, AVX, XCR0 bits 1 and 2)
+   __cpuid(info, 1);
+   if ((info[2] & 0x18000000) != 0x18000000 || (_xgetbv(0) & 6) != 6)
+      return 0;
+   __cpuidex(info, 7, 0);
+   return (info[1] >> 5) & 1;
+}
+#else
+static int stbi__avx2_available(void)
+{
+   // this also checks that the OS saves the YMM registers
+   return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -817,6 +900,10 @@ typedef struct
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
+
+   // caller memory for the decoded image, from stbi_load_into; see stbi__malloc_image
+   stbi_uc *out_buffer;
+   size_t out_buffer_size;
 } stbi__context;
 
 
@@ -830,6 +917,8 @@ static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
    s->callback_already_read = 0;
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
    s->img_buffer_end = s->img_buffer_original_end = (stbi_uc *) buffer+len;
+   s->out_buffer = NULL;
+   s->out_buffer_size = 0;
 }
 
 // initialize a callback-based context
@@ -843,6 +932,8 @@ static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *
    s->img_buffer = s->img_buffer_original = s->buffer_start;
    stbi__refill_buffer(s);
    s->img_buffer_original_end = s->img_buffer_end;
+   s->out_buffer = NULL;
+   s->out_buffer_size = 0;
 }
 
 #ifndef STBI_NO_STDIO
@@ -1058,6 +1149,26 @@ static void *stbi__malloc_mad3(int a, int b, int c, int add)
    return stbi__malloc(a*b*c + add);
 }
 
+#if !defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)
+// allocates the final image like stbi__malloc_mad3, but hands out the
+// stbi_load_into buffer instead when the image fits in it. only call it for
+// the buffer the loader returns as is, and free that with stbi__free_image.
+static void *stbi__malloc_image(stbi__context *s, int a, int b, int c, int add)
+{
+   if (s->out_buffer && stbi__mad3sizes_valid(a, b, c, add) && (size_t) (a*b*c + add) <= s->out_buffer_size)
+      return s->out_buffer;
+   return stbi__malloc_mad3(a, b, c, add);
+}
+#endif
+
+#ifndef STBI_NO_PNG
+static void stbi__free_image(stbi__context *s, void *p)
+{
+   if (p != s->out_buffer)
+      STBI_FREE(p);
+}
+#endif
+
 #if !defined(STBI_NO_LINEAR) || !defined(STBI_NO_HDR) || !defined(STBI_NO_PNM)
 static void *stbi__malloc_mad4(int a, int b, int c, int d, int add)
 {
@@ -1310,6 +1421,30 @@ static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x,
    return (stbi__uint16 *) result;
 }
 
+static int stbi__load_into(stbi__context *s, stbi_uc *out, size_t out_size, int *x, int *y, int *comp, int req_comp)
+{
+   unsigned char *result;
+   size_t size;
+
+   s->out_buffer = out;
+   s->out_buffer_size = out_size;
+   result = stbi__load_and_postprocess_8bit(s, x, y, comp, req_comp);
+   if (result == NULL)
+      return 0;
+   if (result == out)
+      return 1;
+
+   // the loader made its own copy
+   size = (size_t) *x * *y * (req_comp ? req_comp : *comp);
+   if (size > out_size) {
+      STBI_FREE(result);
+      return stbi__err("buffer too small", "Image does not fit in the buffer");
+   }
+   memcpy(out, result, size);
+   STBI_FREE(result);
+   return 1;
+}
+
 #if !defined(STBI_NO_HDR) && !defined(STBI_NO_LINEAR)
 static void stbi__float_postprocess(float *result, int *x, int *y, int *comp, int req_comp)
 {
@@ -1386,6 +1521,29 @@ STBIDEF stbi_uc *stbi_load_from_file(FILE *f, int *x, int *y, int *comp, int req
    return result;
 }
 
+STBIDEF int stbi_load_into(char const *filename, stbi_uc *out, size_t out_size, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   int result;
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   result = stbi_load_into_from_file(f,out,out_size,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+
+STBIDEF int stbi_load_into_from_file(FILE *f, stbi_uc *out, size_t out_size, int *x, int *y, int *comp, int req_comp)
+{
+   int result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = stbi__load_into(&s,out,out_size,x,y,comp,req_comp);
+   if (result) {
+      // need to 'unget' all the characters in the IO buffer
+      fseek(f, - (int) (s.img_buffer_end - s.img_buffer), SEEK_CUR);
+   }
+   return result;
+}
+
 STBIDEF stbi__uint16 *stbi_load_from_file_16(FILE *f, int *x, int *y, int *comp, int req_comp)
 {
    stbi__uint16 *result;
@@ -1440,6 +1598,20 @@ STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *u
    return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
 }
 
+STBIDEF int stbi_load_into_from_memory(stbi_uc const *buffer, int len, stbi_uc *out, size_t out_size, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_into(&s,out,out_size,x,y,comp,req_comp);
+}
+
+STBIDEF int stbi_load_into_from_callbacks(stbi_io_callbacks const *clbk, void *user, stbi_uc *out, size_t out_size, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return stbi__load_into(&s,out,out_size,x,y,comp,req_comp);
+}
+
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp)
 {
@@ -2704,6 +2876,188 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// avx2 integer IDCT. the same computation as the sse2 one, but every 32-bit
+// intermediate row lives in one 256-bit register instead of a lo/hi pair,
+// which halves the multiply-adds and the wide adds. the transposes stay
+// 128-bit. output is bit-identical to the sse2 and generic C versions.
+STBI__AVX2_TARGET static void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+   __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+   __m128i tmp;
+
+   // dot product constant: even elems=x, odd elems=y
+   #define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
+
+   // interleave rows x and y into (x,y) pairs, columns 0-3 in the low half
+   // and columns 4-7 in the high half
+   #define dct_pair(x,y) \
+      _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16((x),(y))), _mm_unpackhi_epi16((x),(y)), 1)
+
+   // out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+   // out(1) = c1[even]*x + c1[odd]*y
+   #define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##xy = dct_pair(x,y); \
+      __m256i out0 = _mm256_madd_epi16(c0##xy, c0); \
+      __m256i out1 = _mm256_madd_epi16(c0##xy, c1)
+
+   // out = in << 12  (in 16-bit, out 32-bit)
+   #define dct_widen(out, in) \
+      __m256i out = _mm256_slli_epi32(_mm256_cvtepi16_epi32(in), 12)
+
+   // wide add
+   #define dct_wadd(out, a, b) \
+      __m256i out = _mm256_add_epi32(a, b)
+
+   // wide sub
+   #define dct_wsub(out, a, b) \
+      __m256i out = _mm256_sub_epi32(a, b)
+
+   // butterfly a/b, add bias, then shift by "s" and pack. packs works within
+   // 128-bit lanes, so the permute puts all of out0 in the low half.
+   #define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased = _mm256_add_epi32(a, bias); \
+         __m256i sum = _mm256_srai_epi32(_mm256_add_epi32(abiased, b), s); \
+         __m256i dif = _mm256_srai_epi32(_mm256_sub_epi32(abiased, b), s); \
+         __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum, dif), 0xd8); \
+         out0 = _mm256_castsi256_si128(packed); \
+         out1 = _mm256_extracti128_si256(packed, 1); \
+      }
+
+   // 8-bit interleave step (for transposes)
+   #define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
+
+   // 16-bit interleave step (for transposes)
+   #define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+   #define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m128i sum04 = _mm_add_epi16(row0, row4); \
+         __m128i dif04 = _mm_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m128i sum17 = _mm_add_epi16(row1, row7); \
+         __m128i sum35 = _mm_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+   __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+   __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f( 0.765366865f), stbi__f2f(0.5411961f));
+   __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+   __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+   __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f( 0.298631336f), stbi__f2f(-1.961570560f));
+   __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f( 3.072711026f));
+   __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f( 2.053119869f), stbi__f2f(-0.390180644f));
+   __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f( 1.501321110f));
+
+   // rounding biases in column/row passes, see stbi__idct_block for explanation.
+   __m256i bias_0 = _mm256_set1_epi32(512);
+   __m256i bias_1 = _mm256_set1_epi32(65536 + (128<<17));
+
+   // load
+   row0 = _mm_load_si128((const __m128i *) (data + 0*8));
+   row1 = _mm_load_si128((const __m128i *) (data + 1*8));
+   row2 = _mm_load_si128((const __m128i *) (data + 2*8));
+   row3 = _mm_load_si128((const __m128i *) (data + 3*8));
+   row4 = _mm_load_si128((const __m128i *) (data + 4*8));
+   row5 = _mm_load_si128((const __m128i *) (data + 5*8));
+   row6 = _mm_load_si128((const __m128i *) (data + 6*8));
+   row7 = _mm_load_si128((const __m128i *) (data + 7*8));
+
+   // column pass
+   dct_pass(bias_0, 10);
+
+   {
+      // 16bit 8x8 transpose pass 1
+      dct_interleave16(row0, row4);
+      dct_interleave16(row1, row5);
+      dct_interleave16(row2, row6);
+      dct_interleave16(row3, row7);
+
+      // transpose pass 2
+      dct_interleave16(row0, row2);
+      dct_interleave16(row1, row3);
+      dct_interleave16(row4, row6);
+      dct_interleave16(row5, row7);
+
+      // transpose pass 3
+      dct_interleave16(row0, row1);
+      dct_interleave16(row2, row3);
+      dct_interleave16(row4, row5);
+      dct_interleave16(row6, row7);
+   }
+
+   // row pass
+   dct_pass(bias_1, 17);
+
+   {
+      // pack
+      __m128i p0 = _mm_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+      __m128i p1 = _mm_packus_epi16(row2, row3);
+      __m128i p2 = _mm_packus_epi16(row4, row5);
+      __m128i p3 = _mm_packus_epi16(row6, row7);
+
+      // 8bit 8x8 transpose pass 1
+      dct_interleave8(p0, p2); // a0e0a1e1...
+      dct_interleave8(p1, p3); // c0g0c1g1...
+
+      // transpose pass 2
+      dct_interleave8(p0, p1); // a0c0e0g0...
+      dct_interleave8(p2, p3); // b0d0f0h0...
+
+      // transpose pass 3
+      dct_interleave8(p0, p2); // a0b0c0d0...
+      dct_interleave8(p1, p3); // a4b4c4d4...
+
+      // store
+      _mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
+   }
+
+#undef dct_const
+#undef dct_pair
+#undef dct_rot
+#undef dct_widen
+#undef dct_wadd
+#undef dct_wsub
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -3643,6 +3997,84 @@ static stbi_uc *stbi__resample_row_hv_2_simd(stbi_uc *out, stbi_uc *in_near, stb
 }
 #endif
 
+#ifdef STBI_AVX2
+STBI__AVX2_TARGET static stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   // same filter as stbi__resample_row_hv_2_simd, 16 pixels at a time
+   int i=0,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   for (; i < ((w-1) & ~15); i += 16) {
+      // vertical pass: 3*x + y = 4*x + (y - x)
+      __m256i farw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+      __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+      __m256i diff  = _mm256_sub_epi16(farw, nearw);
+      __m256i nears = _mm256_slli_epi16(nearw, 2);
+      __m256i curr  = _mm256_add_epi16(nears, diff); // current row
+
+      // "prev" is curr shifted right by one pixel with t1 in front, "next"
+      // is curr shifted left by one pixel with the first pixel of the next
+      // block at the end. alignr shifts within 128-bit lanes, so each one is
+      // paired with the neighbouring lane (or zero) from permute2x128.
+      __m256i lo0  = _mm256_permute2x128_si256(curr, curr, 0x08); // 0, curr.lo
+      __m256i hi0  = _mm256_permute2x128_si256(curr, curr, 0x81); // curr.hi, 0
+      __m256i prv0 = _mm256_alignr_epi8(curr, lo0, 14);
+      __m256i nxt0 = _mm256_alignr_epi8(hi0, curr, 2);
+      __m128i pfix = _mm_cvtsi32_si128(t1);
+      __m128i nfix = _mm_slli_si128(_mm_cvtsi32_si128(3*in_near[i+16] + in_far[i+16]), 14);
+      __m256i prev = _mm256_or_si256(prv0, _mm256_inserti128_si256(_mm256_setzero_si256(), pfix, 0));
+      __m256i next = _mm256_or_si256(nxt0, _mm256_inserti128_si256(_mm256_setzero_si256(), nfix, 1));
+
+      // horizontal filter, polyphase implementation since it's convenient:
+      // even pixels = 3*cur + prev = cur*4 + (prev - cur)
+      // odd  pixels = 3*cur + next = cur*4 + (next - cur)
+      // note the shared term.
+      __m256i bias = _mm256_set1_epi16(8);
+      __m256i curs = _mm256_slli_epi16(curr, 2);
+      __m256i prvd = _mm256_sub_epi16(prev, curr);
+      __m256i nxtd = _mm256_sub_epi16(next, curr);
+      __m256i curb = _mm256_add_epi16(curs, bias);
+      __m256i even = _mm256_add_epi16(prvd, curb);
+      __m256i odd  = _mm256_add_epi16(nxtd, curb);
+
+      // interleave even and odd pixels, then undo scaling. the in-lane
+      // unpack and pack cancel out, leaving the 32 outputs in order.
+      __m256i int0 = _mm256_unpacklo_epi16(even, odd);
+      __m256i int1 = _mm256_unpackhi_epi16(even, odd);
+      __m256i de0  = _mm256_srli_epi16(int0, 4);
+      __m256i de1  = _mm256_srli_epi16(int1, 4);
+
+      // pack and write output
+      __m256i outv = _mm256_packus_epi16(de0, de1);
+      _mm256_storeu_si256((__m256i *) (out + i*2), outv);
+
+      // "previous" value for next iter
+      t1 = 3*in_near[i+15] + in_far[i+15];
+   }
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = stbi__div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+#endif
+
 static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
 {
    // resample with nearest-neighbor
@@ -3817,6 +4249,124 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+STBI__AVX2_TARGET static void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   // same arithmetic as the sse2 path of stbi__YCbCr_to_RGB_simd, 16 pixels
+   // at a time. step == 3 is handled too, since that is what textures
+   // loaded with req_comp 0 or 3 use.
+   int i = 0;
+
+   if (step == 4 || step == 3) {
+      __m128i signflip  = _mm_set1_epi8(-0x80);
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i y_bias = _mm256_set1_epi16(128);
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+
+      // pshufb masks gathering 16 bytes of interleaved rgb from the r, g and
+      // b vectors (-1 leaves a zero to be filled by another vector)
+      __m128i r0 = _mm_setr_epi8( 0,-1,-1, 1,-1,-1, 2,-1,-1, 3,-1,-1, 4,-1,-1, 5);
+      __m128i g0 = _mm_setr_epi8(-1, 0,-1,-1, 1,-1,-1, 2,-1,-1, 3,-1,-1, 4,-1,-1);
+      __m128i b0 = _mm_setr_epi8(-1,-1, 0,-1,-1, 1,-1,-1, 2,-1,-1, 3,-1,-1, 4,-1);
+      __m128i r1 = _mm_setr_epi8(-1,-1, 6,-1,-1, 7,-1,-1, 8,-1,-1, 9,-1,-1,10,-1);
+      __m128i g1 = _mm_setr_epi8( 5,-1,-1, 6,-1,-1, 7,-1,-1, 8,-1,-1, 9,-1,-1,10);
+      __m128i b1 = _mm_setr_epi8(-1, 5,-1,-1, 6,-1,-1, 7,-1,-1, 8,-1,-1, 9,-1,-1);
+      __m128i r2 = _mm_setr_epi8(-1,11,-1,-1,12,-1,-1,13,-1,-1,14,-1,-1,15,-1,-1);
+      __m128i g2 = _mm_setr_epi8(-1,-1,11,-1,-1,12,-1,-1,13,-1,-1,14,-1,-1,15,-1);
+      __m128i b2 = _mm_setr_epi8(10,-1,-1,11,-1,-1,12,-1,-1,13,-1,-1,14,-1,-1,15);
+
+      for (; i+15 < count; i += 16) {
+         // load
+         __m128i y_bytes = _mm_loadu_si128((__m128i *) (y+i));
+         __m128i cr_bytes = _mm_loadu_si128((__m128i *) (pcr+i));
+         __m128i cb_bytes = _mm_loadu_si128((__m128i *) (pcb+i));
+         __m128i cr_biased = _mm_xor_si128(cr_bytes, signflip); // -128
+         __m128i cb_biased = _mm_xor_si128(cb_bytes, signflip); // -128
+
+         // widen to short (and left-shift cr, cb by 8)
+         __m256i yw  = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(y_bytes), 8), y_bias);
+         __m256i crw = _mm256_slli_epi16(_mm256_cvtepi8_epi16(cr_biased), 8);
+         __m256i cbw = _mm256_slli_epi16(_mm256_cvtepi8_epi16(cb_biased), 8);
+
+         // color transform
+         __m256i yws = _mm256_srli_epi16(yw, 4);
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rws = _mm256_add_epi16(cr0, yws);
+         __m256i gwt = _mm256_add_epi16(cb0, yws);
+         __m256i bws = _mm256_add_epi16(yws, cb1);
+         __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+         // descale
+         __m256i rw = _mm256_srai_epi16(rws, 4);
+         __m256i bw = _mm256_srai_epi16(bws, 4);
+         __m256i gw = _mm256_srai_epi16(gws, 4);
+
+         if (step == 4) {
+            // back to byte, then transpose to interleave channels. both
+            // work within 128-bit lanes, so the low lane ends up holding
+            // pixels 0-3 and 8-11 and the high lane 4-7 and 12-15.
+            __m256i brb = _mm256_packus_epi16(rw, bw);
+            __m256i gxb = _mm256_packus_epi16(gw, xw);
+            __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+            __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+            __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+            __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+            // store
+            _mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+            _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+            out += 64;
+         } else {
+            // back to byte, one 16-byte vector per channel
+            __m256i rgb = _mm256_permute4x64_epi64(_mm256_packus_epi16(rw, gw), 0xd8);
+            __m256i bbb = _mm256_permute4x64_epi64(_mm256_packus_epi16(bw, bw), 0xd8);
+            __m128i r = _mm256_castsi256_si128(rgb);
+            __m128i g = _mm256_extracti128_si256(rgb, 1);
+            __m128i b = _mm256_castsi256_si128(bbb);
+
+            // interleave into 48 bytes of rgb
+            __m128i o0 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, r0), _mm_shuffle_epi8(g, g0)), _mm_shuffle_epi8(b, b0));
+            __m128i o1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, r1), _mm_shuffle_epi8(g, g1)), _mm_shuffle_epi8(b, b1));
+            __m128i o2 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, r2), _mm_shuffle_epi8(g, g2)), _mm_shuffle_epi8(b, b2));
+
+            // store
+            _mm_storeu_si128((__m128i *) (out + 0), o0);
+            _mm_storeu_si128((__m128i *) (out + 16), o1);
+            _mm_storeu_si128((__m128i *) (out + 32), o2);
+            out += 48;
+         }
+      }
+   }
+
+   for (; i < count; ++i) {
+      int y_fixed = (y[i] << 20) + (1<<19); // rounding
+      int r,g,b;
+      int cr = pcr[i] - 128;
+      int cb = pcb[i] - 128;
+      r = y_fixed + cr* stbi__float2fixed(1.40200f);
+      g = y_fixed + cr*-stbi__float2fixed(0.71414f) + ((cb*-stbi__float2fixed(0.34414f)) & 0xffff0000);
+      b = y_fixed                                   +   cb* stbi__float2fixed(1.77200f);
+      r >>= 20;
+      g >>= 20;
+      b >>= 20;
+      if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
+      if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
+      if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
+      out[0] = (stbi_uc)r;
+      out[1] = (stbi_uc)g;
+      out[2] = (stbi_uc)b;
+      out[3] = 255;
+      out += step;
+   }
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
@@ -3832,6 +4382,14 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    }
 #endif
 
+#ifdef STBI_AVX2
+   if (stbi__avx2_available()) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+   }
+#endif
+
 #ifdef STBI_NEON
    j->idct_block_kernel = stbi__idct_simd;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3919,7 +4477,7 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
       }
 
       // can't error after this so, this is safe
-      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
+      output = (stbi_uc *) stbi__malloc_image(z->s, n, z->s->img_x, z->s->img_y, 1);
       if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
       // now go ahead and resample
@@ -4092,6 +4650,31 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 #define STBI__ZNSYMS 288 // number of symbols in literal/length alphabet
 
+// on 64-bit little-endian targets, huffman blocks are mostly decoded by a
+// fast loop (stbi__parse_huffman_fast) that refills a 64-bit bit buffer 8
+// bytes at a time, decodes length codes together with their extra bits (and
+// pairs of short literals) in one table lookup, and copies matches in 8- or
+// 16-byte chunks. it stops wherever the input or output is close to its end,
+// or on anything unusual, and the byte-at-a-time code below takes over from
+// exactly the state it would have had, so corrupt or truncated streams fail
+// (or not) the same way as with STBI_NO_ZFAST_LOOP.
+#if !defined(STBI_NO_ZFAST_LOOP) && (defined(STBI__X64_TARGET) || defined(__aarch64__) || defined(_M_ARM64))
+#if !defined(__BYTE_ORDER__) || (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define STBI__ZFAST_LOOP
+#endif
+#endif
+
+#ifdef STBI__ZFAST_LOOP
+#ifdef _MSC_VER
+typedef unsigned __int64 stbi__zbits;
+#else
+typedef uint64_t stbi__zbits;
+#endif
+#define STBI__ZWIDE_BITS  10 // length/literal table of the fast loop
+#define STBI__ZWIDE_MASK  ((1 << STBI__ZWIDE_BITS) - 1)
+#define STBI__ZFAST_MARGIN (258 + 16) // longest match plus the chunked copy overrun
+#endif
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
@@ -4187,6 +4770,11 @@ typedef struct
    int   z_expandable;
 
    stbi__zhuffman z_length, z_distance;
+#ifdef STBI__ZFAST_LOOP
+   // fast loop tables, see stbi__zbuild_wide
+   stbi__uint32 wide_length[1 << STBI__ZWIDE_BITS];
+   stbi__uint32 wide_distance[1 << STBI__ZFAST_BITS];
+#endif
 } stbi__zbuf;
 
 stbi_inline static int stbi__zeof(stbi__zbuf *z)
@@ -4306,11 +4894,246 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+#ifdef STBI__ZFAST_LOOP
+// fast loop table entries. length/literal table:
+//    bits  0-3   code length (both codes, for a literal pair)
+//    bits  4-7   extra bits of a length code, or the length of the
+//                (first) literal's code
+//    bits  8-9   1 = literal, 2 = literal pair, 3 = length; 0 = end of
+//                block or invalid symbol, left to the slow path
+//    bits 16-31  the literal(s), or the base length
+// distance table:
+//    bits  0-7   code length
+//    bits  8-15  extra bits
+//    bits 16-31  base distance, 0 for an invalid symbol
+// an entry of 0 in either table means the code is longer than the table
+// index, see stbi__zwide_long.
+static stbi__uint32 stbi__zwide_entry(int sym, int s, int is_length)
+{
+   if (!is_length)
+      return sym < 30 ? ((stbi__uint32) stbi__zdist_base[sym] << 16) | (stbi__zdist_extra[sym] << 8) | s : (stbi__uint32) s;
+   if (sym < 256)
+      return ((stbi__uint32) sym << 16) | (1 << 8) | (s << 4) | s;
+   if (sym > 256 && sym < 286)
+      return ((stbi__uint32) stbi__zlength_base[sym-257] << 16) | (3 << 8) | (stbi__zlength_extra[sym-257] << 4) | s;
+   return s;
+}
+
+static void stbi__zbuild_wide_table(stbi__uint32 *table, int bits, stbi__zhuffman *z, int is_length)
+{
+   int i,s,c;
+   memset(table, 0, sizeof(*table) << bits);
+   for (s=1; s <= bits; ++s) {
+      for (c = z->firstsymbol[s]; c < z->firstsymbol[s+1]; ++c) {
+         int code = z->firstcode[s] + (c - z->firstsymbol[s]);
+         stbi__uint32 e = stbi__zwide_entry(z->value[c], s, is_length);
+         for (i = stbi__bit_reverse(code, s); i < (1 << bits); i += 1 << s)
+            table[i] = e;
+      }
+   }
+
+   if (!is_length)
+      return;
+
+   // a literal followed by a literal whose code fits in the remaining bits
+   // becomes a pair. going downwards, table[i >> s] is still a single entry.
+   for (i = (1 << bits) - 1; i >= 0; --i) {
+      stbi__uint32 e = table[i], e2;
+      if (((e >> 8) & 3) != 1) continue;
+      s = e & 15;
+      e2 = table[i >> s];
+      if (((e2 >> 8) & 3) != 1 || (int) (e2 & 15) > bits - s) continue;
+      table[i] = ((e >> 16) << 16) | ((e2 >> 16) << 24) | (2 << 8) | (s << 4) | (s + (e2 & 15));
+   }
+}
+
+// same as stbi__zhuffman_decode_slowpath, but on the 64-bit buffer and
+// returning a table entry; 0 if the code is invalid
+static stbi__uint32 stbi__zwide_long(stbi__zhuffman *z, stbi__zbits bits, int is_length)
+{
+   int b,s,k;
+   k = stbi__bit_reverse((int) (bits & 0xffff), 16);
+   for (s=STBI__ZFAST_BITS+1; ; ++s)
+      if (k < z->maxcode[s])
+         break;
+   if (s >= 16) return 0;
+   b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
+   if (b >= STBI__ZNSYMS || z->size[b] != s) return 0;
+   return stbi__zwide_entry(z->value[b], s, is_length);
+}
+
+static void stbi__zbuild_wide(stbi__zbuf *a)
+{
+   stbi__zbuild_wide_table(a->wide_length, STBI__ZWIDE_BITS, &a->z_length, 1);
+   stbi__zbuild_wide_table(a->wide_distance, STBI__ZFAST_BITS, &a->z_distance, 0);
+}
+
+// decodes symbols while at least 16 bytes of input and STBI__ZFAST_MARGIN
+// bytes of output room are left. returns at the first symbol it does not
+// handle, without consuming it.
+//
+// the regular decoder's handling of the end of the input (zero bytes from
+// stbi__zget8, hit_zeof_once) depends on how many bits it had buffered when
+// it got there, which depends on when it refilled. so this follows when it
+// would refill, and hands back exactly the state it would have. 16 bytes is
+// enough that the regular decoder would never have reached the end inside
+// this loop.
+//
+// the regular decoder makes sure of n bits by refilling to 25..32 bits when
+// it has fewer. its num_bits always has the same bits past a byte boundary
+// as ours and is num_bits + 16 - slow_at, so it refills before a symbol when
+// num_bits < slow_at, after which slow_at is (num_bits - 9) & ~7.
+static char *stbi__parse_huffman_fast(stbi__zbuf *a, char *zout)
+{
+   const stbi_uc *in = a->zbuffer;
+   const stbi_uc *in_end = a->zbuffer_end - 16;
+   char *out_end = a->zout_end - STBI__ZFAST_MARGIN;
+   stbi__zbits bits = a->code_buffer;
+   stbi__zbits next;
+   int num_bits = a->num_bits;
+   int slow_at = 16;
+   int n;
+
+   while (in <= in_end && zout <= out_end) {
+      stbi__zbits saved_bits;
+      stbi__uint32 e, d;
+      int saved_num_bits, saved_slow_at, t, len, dist;
+      char *src, *end;
+
+      // refill to 56..63 bits. the partial byte at the top is loaded again
+      // by the next refill, into the same bit positions.
+      memcpy(&next, in, 8);
+      bits |= next << num_bits;
+      in += (63 - num_bits) >> 3;
+      slow_at -= num_bits;
+      num_bits |= 56;
+      slow_at += num_bits;
+
+      e = a->wide_length[bits & STBI__ZWIDE_MASK];
+      if (e == 0)
+         e = stbi__zwide_long(&a->z_length, bits, 1);
+      n = e & 15;
+      t = (e >> 8) & 3;
+      if (t == 1 || t == 2) {
+         // one or two literals; the second byte is overwritten if unused.
+         // the regular decoder may refill before each of them. after a
+         // single literal the second check is where the next symbol
+         // starts, which only makes that refill early.
+         zout[0] = (char) (e >> 16);
+         zout[1] = (char) (e >> 24);
+         zout += t;
+         if (num_bits < slow_at) slow_at = (num_bits - 9) & ~7;
+         if (num_bits - (int) ((e >> 4) & 15) < slow_at)
+            slow_at = (num_bits - (int) ((e >> 4) & 15) - 9) & ~7;
+         bits >>= n;
+         num_bits -= n;
+         // a literal takes at most 15 bits, so a short code after it is
+         // still in the buffer without a refill
+         e = a->wide_length[bits & STBI__ZWIDE_MASK];
+         t = (e >> 8) & 3;
+         if (t == 1 || t == 2) {
+            n = e & 15;
+            zout[0] = (char) (e >> 16);
+            zout[1] = (char) (e >> 24);
+            zout += t;
+            if (num_bits < slow_at) slow_at = (num_bits - 9) & ~7;
+            if (num_bits - (int) ((e >> 4) & 15) < slow_at)
+               slow_at = (num_bits - (int) ((e >> 4) & 15) - 9) & ~7;
+            bits >>= n;
+            num_bits -= n;
+         }
+         continue;
+      }
+      if (t == 0)
+         goto done;
+
+      // length code and its extra bits, then the distance. at most
+      // 15+5+15+13 bits, so this never needs another refill.
+      saved_bits = bits;
+      saved_num_bits = num_bits;
+      saved_slow_at = slow_at;
+      // the regular decoder makes sure of 16 bits for each code and of the
+      // number of extra bits for each extra (so 0 extra bits never refill)
+      if (num_bits < slow_at) slow_at = (num_bits - 9) & ~7;
+      bits >>= n;
+      num_bits -= n;
+      if (num_bits < slow_at - 16 + (int) ((e >> 4) & 15)) slow_at = (num_bits - 9) & ~7;
+      len = (int) (e >> 16) + (int) (bits & ((1u << ((e >> 4) & 15)) - 1));
+      bits >>= (e >> 4) & 15;
+      num_bits -= (e >> 4) & 15;
+      d = a->wide_distance[bits & STBI__ZFAST_MASK];
+      if (d == 0)
+         d = stbi__zwide_long(&a->z_distance, bits, 0);
+      if (num_bits < slow_at) slow_at = (num_bits - 9) & ~7;
+      bits >>= d & 255;
+      num_bits -= d & 255;
+      if (num_bits < slow_at - 16 + (int) ((d >> 8) & 255)) slow_at = (num_bits - 9) & ~7;
+      dist = (int) (d >> 16) + (int) (bits & ((1u << ((d >> 8) & 255)) - 1));
+      bits >>= (d >> 8) & 255;
+      num_bits -= (d >> 8) & 255;
+      if ((d >> 16) == 0 || zout - a->zout_start < dist) {
+         // bad distance: let the slow path report it
+         bits = saved_bits;
+         num_bits = saved_num_bits;
+         slow_at = saved_slow_at;
+         break;
+      }
+
+      // copy in chunks; the last one may write up to 15 bytes past the match,
+      // which STBI__ZFAST_MARGIN leaves room for and later output overwrites
+      src = zout - dist;
+      end = zout + len;
+      if (dist >= 16) {
+         do { memcpy(zout, src, 16); zout += 16; src += 16; } while (zout < end);
+      } else if (dist >= 8) {
+         do { memcpy(zout, src, 8); zout += 8; src += 8; } while (zout < end);
+      } else if (dist == 1) { // run of one byte; common in images.
+         stbi__zbits v = (stbi_uc) *src;
+         v |= v << 8;
+         v |= v << 16;
+         v |= v << 32;
+         do { memcpy(zout, &v, 8); zout += 8; } while (zout < end);
+      } else {
+         // short period: copy one whole number of periods that is at least
+         // 8 bytes long a byte at a time, then copy 8-byte chunks from that
+         int step = dist, i;
+         while (step < 8) step += dist;
+         for (i=0; i < step; ++i)
+            zout[i] = src[i];
+         src = zout;
+         zout += step;
+         while (zout < end) { memcpy(zout, src, 8); zout += 8; src += 8; }
+      }
+      zout = end;
+   }
+
+done:
+   // give whole unused bytes back, then take as many whole bytes again as
+   // the regular decoder would have had in its buffer (at most 32 bits)
+   n = num_bits + 16 - slow_at;
+   in -= num_bits >> 3;
+   num_bits &= 7;
+   n -= num_bits;
+   memcpy(&next, in, 8);
+   bits &= ((stbi__zbits) 1 << num_bits) - 1;
+   bits |= (next & (((stbi__zbits) 1 << n) - 1)) << num_bits;
+   a->zbuffer = (stbi_uc *) in + (n >> 3);
+   a->code_buffer = (stbi__uint32) bits;
+   a->num_bits = num_bits + n;
+   return zout;
+}
+#endif
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
    for(;;) {
-      int z = stbi__zhuffman_decode(a, &a->z_length);
+      int z;
+#ifdef STBI__ZFAST_LOOP
+      if (a->zbuffer_end - a->zbuffer >= 16 && a->zout_end - zout >= STBI__ZFAST_MARGIN)
+         zout = stbi__parse_huffman_fast(a, zout);
+#endif
+      z = stbi__zhuffman_decode(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (zout >= a->zout_end) {
@@ -4501,6 +5324,9 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
          } else {
             if (!stbi__compute_huffman_codes(a)) return 0;
          }
+#ifdef STBI__ZFAST_LOOP
+         stbi__zbuild_wide(a);
+#endif
          if (!stbi__parse_huffman_block(a)) return 0;
       }
    } while (!final);
@@ -4692,6 +5518,107 @@ static void stbi__create_png_alpha_expand8(stbi_uc *dest, stbi_uc *src, stbi__ui
    }
 }
 
+#ifdef STBI_SSE2
+// sse2 Sub/Up/Average/Paeth for 8-bit images with 3 or 4 channels. Sub,
+// Average and Paeth depend on the pixel to the left, so those are done one
+// pixel per step, with all of its channels in one register (16-bit lanes for
+// Paeth). The scalar loops spend most of their time on exactly that
+// dependency. Output is bit-identical to the scalar filters.
+//
+// 3-channel pixels are still moved 4 bytes at a time: the extra byte read is
+// the next pixel's, and the extra byte written is overwritten by the next
+// pixel. only the last pixel of a 3-channel row is moved byte by byte, so
+// nothing outside the row is touched.
+static __m128i stbi__png_load_pixel(const stbi_uc *p, int n)
+{
+   stbi__uint32 v;
+   if (n == 4)
+      memcpy(&v, p, 4);
+   else
+      v = p[0] | (p[1] << 8) | (p[2] << 16);
+   return _mm_cvtsi32_si128((int) v);
+}
+
+static void stbi__png_store_pixel(stbi_uc *p, __m128i x, int n)
+{
+   stbi__uint32 v = (stbi__uint32) _mm_cvtsi128_si32(x);
+   if (n == 4) {
+      memcpy(p, &v, 4);
+   } else {
+      p[0] = STBI__BYTECAST(v);
+      p[1] = STBI__BYTECAST(v >> 8);
+      p[2] = STBI__BYTECAST(v >> 16);
+   }
+}
+
+static void stbi__png_unfilter_simd(stbi_uc *cur, stbi_uc *raw, stbi_uc *prior, int nk, int filter, int n)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i a = zero, b, c = zero, d;
+   int last = nk - n;
+   int k = 0, m;
+
+   switch (filter) {
+   case STBI__F_sub:
+      for (; k < nk; k += n) {
+         m = (k < last) ? 4 : n;
+         a = _mm_add_epi8(a, stbi__png_load_pixel(raw + k, m));
+         stbi__png_store_pixel(cur + k, a, m);
+      }
+      break;
+   case STBI__F_up:
+      for (; k+16 <= nk; k += 16) {
+         d = _mm_loadu_si128((__m128i *) (raw + k));
+         b = _mm_loadu_si128((__m128i *) (prior + k));
+         _mm_storeu_si128((__m128i *) (cur + k), _mm_add_epi8(d, b));
+      }
+      for (; k < nk; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+      break;
+   case STBI__F_avg:
+      for (; k < nk; k += n) {
+         // pavgb rounds up; subtracting the low bit of a^b makes it (a+b)>>1
+         __m128i avg;
+         m = (k < last) ? 4 : n;
+         b = stbi__png_load_pixel(prior + k, m);
+         d = stbi__png_load_pixel(raw + k, m);
+         avg = _mm_avg_epu8(a, b);
+         avg = _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+         a = _mm_add_epi8(d, avg);
+         stbi__png_store_pixel(cur + k, a, m);
+      }
+      break;
+   case STBI__F_paeth:
+      // same branch-free form as stbi__paeth, in 16-bit lanes. with a = c = 0
+      // for the first pixel this picks b, same as the scalar path. a is kept
+      // widened between pixels so it feeds straight into the next one.
+      for (; k < nk; k += n) {
+         __m128i thresh, lo, hi, t0, t1;
+         m = (k < last) ? 4 : n;
+         b = _mm_unpacklo_epi8(stbi__png_load_pixel(prior + k, m), zero);
+         d = _mm_unpacklo_epi8(stbi__png_load_pixel(raw + k, m), zero);
+
+         // thresh = c*3 - (a + b)
+         thresh = _mm_sub_epi16(_mm_add_epi16(c, _mm_add_epi16(c, c)), _mm_add_epi16(a, b));
+         lo = _mm_min_epi16(a, b);
+         hi = _mm_max_epi16(a, b);
+
+         // t0 = (hi <= thresh) ? lo : c,  t1 = (thresh <= lo) ? hi : t0
+         t0 = _mm_cmpgt_epi16(hi, thresh);
+         t0 = _mm_or_si128(_mm_and_si128(t0, c), _mm_andnot_si128(t0, lo));
+         t1 = _mm_cmpgt_epi16(thresh, lo);
+         t1 = _mm_or_si128(_mm_and_si128(t1, t0), _mm_andnot_si128(t1, hi));
+
+         // byte adds keep the high byte of each 16-bit lane at zero
+         a = _mm_add_epi8(d, t1);
+         c = b;
+         stbi__png_store_pixel(cur + k, _mm_packus_epi16(a, a), m);
+      }
+      break;
+   }
+}
+#endif
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
@@ -4707,9 +5634,12 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int output_bytes = out_n*bytes;
    int filter_bytes = img_n*bytes;
    int width = x;
+#ifdef STBI_SSE2
+   int simd = stbi__sse2_available();
+#endif
 
    STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
-   a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
+   a->out = (stbi_uc *) stbi__malloc_image(s, x, y, output_bytes, 0); // extra bytes to write off the end into
    if (!a->out) return stbi__err("outofmem", "Out of memory");
 
    // note: error exits here don't need to clean up a->out individually,
@@ -4752,6 +5682,11 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       if (j == 0) filter = first_row_filter[filter];
 
       // perform actual filtering
+#ifdef STBI_SSE2
+      if (simd && depth == 8 && (filter_bytes == 3 || filter_bytes == 4) && filter >= STBI__F_sub && filter <= STBI__F_paeth)
+         stbi__png_unfilter_simd(cur, raw, prior, nk, filter, filter_bytes);
+      else
+#endif
       switch (filter) {
       case STBI__F_none:
          memcpy(cur, raw, nk);
@@ -5198,6 +6133,8 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
 
          case STBI__PNG_TYPE('I','E','N','D'): {
             stbi__uint32 raw_len, bpl;
+            stbi_uc *out_buffer;
+            int ok;
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if (scan != STBI__SCAN_load) return 1;
             if (z->idata == NULL) return stbi__err("no IDAT","Corrupt PNG");
@@ -5211,7 +6148,13 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                s->img_out_n = s->img_n+1;
             else
                s->img_out_n = s->img_n;
-            if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, z->depth, color, interlace)) return 0;
+            // only decode into the stbi_load_into buffer if this is the image we return
+            out_buffer = s->out_buffer;
+            if (interlace || pal_img_n || z->depth != 8 || (req_comp && req_comp != s->img_out_n))
+               s->out_buffer = NULL;
+            ok = stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, z->depth, color, interlace);
+            s->out_buffer = out_buffer;
+            if (!ok) return 0;
             if (has_trans) {
                if (z->depth == 16) {
                   if (!stbi__compute_transparency16(z, tc16, s->img_out_n)) return 0;
@@ -5285,7 +6228,7 @@ static void *stbi__do_png(stbi__png *p, int *x, int *y, int *n, int req_comp, st
       *y = p->s->img_y;
       if (n) *n = p->s->img_n;
    }
-   STBI_FREE(p->out);      p->out      = NULL;
+   stbi__free_image(p->s, p->out); p->out = NULL;
    STBI_FREE(p->expanded); p->expanded = NULL;
    STBI_FREE(p->idata);    p->idata    = NULL;
 
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include <GL/freeglut.h>
 
 /* Implementação do carregamento de imagens via stb_image */
@@ -15,6 +16,7 @@
 /* Estrutura que representa cada modelo 3D carregado */
 typedef struct {
     fastObjMesh* mesh;               // Dados do modelo carregado
+    fastObjBuffer* buffer;           // Vértices únicos e triângulos prontos para desenhar
     GLuint* materialTextures;        // Array com as texturas carregadas
     int materialCount;               // Quantidade de materiais
     float escala;                    // Escala global do modelo
@@ -30,25 +32,134 @@ int modeloAtual = 0;        // Índice do modelo sendo exibido
 float anguloX = 0, anguloY = 0, distCamera = 5;
 int ultimoX = 0, ultimoY = 0, botaoPressionado = 0;
 
-/* Verifica se arquivo existe */
-static int file_exists(const char* path) {
-    FILE* f = fopen(path, "rb");
-    if (!f) return 0;
+/* Relógio monotônico em segundos, para medir o tempo de cada etapa */
+static double segundosAgora(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* Memória onde uma imagem é decodificada, reaproveitada entre as texturas */
+typedef struct {
+    unsigned char* dados;
+    size_t capacidade;
+} BufferTextura;
+
+/* Imagem decodificada por uma thread, esperando o envio para o OpenGL */
+typedef struct {
+    const char* arquivo;             // Caminho da textura
+    GLuint* destino;                 // Onde guardar o id da textura criada
+    BufferTextura buffer;            // Buffer pego do pool para esta imagem
+    unsigned char* pixels;           // Pixels decodificados (NULL se falhou)
+    int largura, altura, canais;
+    int pronta;                      // Decodificação terminada
+} ImagemTextura;
+
+/* Fila compartilhada entre as threads que decodificam as texturas */
+typedef struct {
+    ImagemTextura* imagens;
+    int quantidade;
+    int proxima;                     // Próxima imagem ainda não decodificada
+    BufferTextura* livres;           // Pool de buffers já enviados ao OpenGL
+    int quantidadeLivres;
+    int buffersCriados;
+    fastObjMutex mutex;
+    fastObjCondition pronta;         // Sinalizada a cada imagem decodificada
+} FilaTexturas;
+
+/* Pega do pool o menor buffer que comporta 'tamanho' bytes; se nenhum
+   comporta, aumenta o maior. Só aloca quando o pool está vazio ou a
+   imagem é maior que todos os buffers livres */
+static BufferTextura pegarBuffer(FilaTexturas* fila, size_t tamanho) {
+    BufferTextura b = { NULL, 0 };
+
+    mutex_lock(&fila->mutex);
+    int menorQueServe = -1, maior = -1;
+    for (int i = 0; i < fila->quantidadeLivres; i++) {
+        size_t c = fila->livres[i].capacidade;
+        if (c >= tamanho) {
+            if (menorQueServe < 0 || c < fila->livres[menorQueServe].capacidade) menorQueServe = i;
+        } else if (maior < 0 || c > fila->livres[maior].capacidade) {
+            maior = i;
+        }
+    }
+    int escolhido = (menorQueServe >= 0) ? menorQueServe : maior;
+    if (escolhido >= 0) {
+        b = fila->livres[escolhido];
+        fila->livres[escolhido] = fila->livres[--fila->quantidadeLivres];
+    } else {
+        fila->buffersCriados++;
+    }
+    mutex_unlock(&fila->mutex);
+
+    if (b.capacidade < tamanho) {
+        free(b.dados);                // O conteúdo antigo não interessa
+        b.dados = malloc(tamanho);
+        b.capacidade = b.dados ? tamanho : 0;
+    }
+    return b;
+}
+
+static void devolverBuffer(FilaTexturas* fila, BufferTextura* b) {
+    if (!b->dados) return;
+    mutex_lock(&fila->mutex);
+    fila->livres[fila->quantidadeLivres++] = *b;
+    mutex_unlock(&fila->mutex);
+    b->dados = NULL;
+    b->capacidade = 0;
+}
+
+/* Decodifica uma imagem com stb_image direto num buffer do pool, com o
+   tamanho lido antes por stbi_info; pode rodar em qualquer thread */
+static void decodificarTextura(FilaTexturas* fila, ImagemTextura* img) {
+    img->pixels = NULL;
+    FILE* f = fopen(img->arquivo, "rb");
+    if (!f) {
+        printf("[TEX] nao encontrado: %s\n", img->arquivo);
+        return;
+    }
+
+    int largura, altura, canais;
+    if (stbi_info_from_file(f, &largura, &altura, &canais)) {
+        /* +1: com um byte de folga o JPEG é decodificado direto no buffer */
+        size_t tamanho = (size_t)largura * altura * canais + 1;
+        img->buffer = pegarBuffer(fila, tamanho);
+        if (img->buffer.dados &&
+            stbi_load_into_from_file(f, img->buffer.dados, img->buffer.capacidade,
+                                     &img->largura, &img->altura, &img->canais, 0))
+            img->pixels = img->buffer.dados;
+    }
     fclose(f);
-    return 1;
 }
 
-/* Carrega textura a partir de arquivo usando stb_image */
-GLuint loadTexture(const char *filename) {
-    if (!filename) return 0;
-    if (!file_exists(filename)) {
-        printf("[TEX] nao encontrado: %s\n", filename);
-        return 0;
+/* Pega a próxima imagem da fila, ou -1 se todas já foram pegas */
+static int proximaTextura(FilaTexturas* fila) {
+    mutex_lock(&fila->mutex);
+    int i = (fila->proxima < fila->quantidade) ? fila->proxima++ : -1;
+    mutex_unlock(&fila->mutex);
+    return i;
+}
+
+static void terminarTextura(FilaTexturas* fila, int i) {
+    mutex_lock(&fila->mutex);
+    fila->imagens[i].pronta = 1;
+    condition_broadcast(&fila->pronta);
+    mutex_unlock(&fila->mutex);
+}
+
+/* Laço das threads auxiliares: decodifica até a fila acabar */
+static void decodificarTexturas(void* arg) {
+    FilaTexturas* fila = (FilaTexturas*)arg;
+    int i;
+    while ((i = proximaTextura(fila)) >= 0) {
+        decodificarTextura(fila, &fila->imagens[i]);
+        terminarTextura(fila, i);
     }
+}
 
-    int w,h,c;
-    unsigned char *data = stbi_load(filename, &w, &h, &c, 0);
-    if (!data) return 0;
+/* Cria a textura OpenGL a partir dos pixels já decodificados */
+static GLuint enviarTextura(const ImagemTextura* img) {
+    if (!img->pixels) return 0;
 
     GLuint id;
     glGenTextures(1, &id);
@@ -58,17 +169,96 @@ GLuint loadTexture(const char *filename) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-    int fmt = (c == 4) ? GL_RGBA : GL_RGB;
-    glTexImage2D(GL_TEXTURE_2D, 0, fmt, w, h, 0, fmt, GL_UNSIGNED_BYTE, data);
-
-    stbi_image_free(data);
+    int fmt = (img->canais == 4) ? GL_RGBA : GL_RGB;
+    glTexImage2D(GL_TEXTURE_2D, 0, fmt, img->largura, img->altura, 0, fmt, GL_UNSIGNED_BYTE, img->pixels);
     return id;
 }
 
+/* Número de threads para decodificar texturas: VISUALIZADOR_THREADS ou um por núcleo */
+static unsigned threadsTexturas(int quantidade) {
+    const char* env = getenv("VISUALIZADOR_THREADS");
+    unsigned n = (env && atoi(env) > 0) ? (unsigned)atoi(env) : thread_count_default();
+    if (n > MAX_THREADS) n = MAX_THREADS;
+    if (n > (unsigned)quantidade) n = (unsigned)quantidade;
+    return n;
+}
+
+/* Carrega as texturas de todas as imagens: as threads auxiliares decodificam
+   em paralelo e esta thread, dona do contexto OpenGL, só faz o envio com
+   glTexImage2D. Enquanto a próxima imagem não fica pronta, esta thread
+   também decodifica, então sem threads auxiliares tudo roda aqui */
+static void carregarTexturas(ImagemTextura* imagens, int quantidade) {
+    if (quantidade <= 0) return;
+
+    FilaTexturas fila;
+    fila.imagens = imagens;
+    fila.quantidade = quantidade;
+    fila.proxima = 0;
+    fila.livres = calloc(quantidade, sizeof(BufferTextura));
+    fila.quantidadeLivres = 0;
+    fila.buffersCriados = 0;
+    mutex_init(&fila.mutex);
+    condition_init(&fila.pronta);
+
+    unsigned auxiliares = threadsTexturas(quantidade);
+    fastObjThread threads[MAX_THREADS];
+    fastObjTask tarefas[MAX_THREADS];
+    int iniciada[MAX_THREADS];
+
+    double inicio = segundosAgora();
+
+    for (unsigned t = 0; t < auxiliares; t++) {
+        tarefas[t].func = decodificarTexturas;
+        tarefas[t].arg = &fila;
+        iniciada[t] = thread_start(&threads[t], &tarefas[t]);
+    }
+
+    /* Envia na ordem da lista, assim que cada imagem fica pronta */
+    for (int i = 0; i < quantidade; i++) {
+        mutex_lock(&fila.mutex);
+        while (!imagens[i].pronta) {
+            if (fila.proxima < fila.quantidade) {
+                int j = fila.proxima++;
+                mutex_unlock(&fila.mutex);
+                decodificarTextura(&fila, &imagens[j]);
+                mutex_lock(&fila.mutex);
+                imagens[j].pronta = 1;
+            } else {
+                condition_wait(&fila.pronta, &fila.mutex);
+            }
+        }
+        mutex_unlock(&fila.mutex);
+
+        *imagens[i].destino = enviarTextura(&imagens[i]);
+        devolverBuffer(&fila, &imagens[i].buffer);
+        imagens[i].pixels = NULL;
+    }
+
+    unsigned usadas = 0;
+    for (unsigned t = 0; t < auxiliares; t++) {
+        if (iniciada[t]) {
+            thread_join(&threads[t]);
+            usadas++;
+        }
+    }
+
+    printf("[TEX] %d texturas em %.2f ms (%u threads auxiliares, %d buffers)\n",
+           quantidade, (segundosAgora() - inicio) * 1000.0, usadas, fila.buffersCriados);
+
+    for (int i = 0; i < fila.quantidadeLivres; i++)
+        free(fila.livres[i].dados);
+    free(fila.livres);
+    condition_destroy(&fila.pronta);
+    mutex_destroy(&fila.mutex);
+}
+
 /* Libera memória associada a um objeto (mesh + texturas) */
 void liberarObjeto(Objeto3D* o) {
     if (!o) return;
 
+    if (o->buffer)
+        fast_obj_buffer_destroy(o->buffer);
+
     if (o->mesh)
         fast_obj_destroy(o->mesh);
 
@@ -80,48 +270,54 @@ void liberarObjeto(Objeto3D* o) {
     }
 
     o->mesh = NULL;
+    o->buffer = NULL;
     o->materialTextures = NULL;
     o->materialCount = 0;
     o->carregado = 0;
 }
 
-/* Carrega um OBJ usando fast_obj e processa materiais, texturas e bounding box */
-void carregarObjeto(int indice, const char* filename) {
+/* Processa materiais, texturas e bounding box de um OBJ já lido pelo fast_obj */
+void prepararObjeto(int indice, const char* filename, fastObjMesh* mesh, double segundosLeitura) {
     printf("\n[LOAD] %s\n", filename);
     Objeto3D* obj = &objetos[indice];
     liberarObjeto(obj); // limpa dados antigos
 
-    obj->mesh = fast_obj_read(filename);
+    obj->mesh = mesh;
     if (!obj->mesh) return;
 
+    printf("[OBJ] %u vertices, %u faces em %.2f ms\n",
+           obj->mesh->position_count - 1, obj->mesh->face_count,
+           segundosLeitura * 1000.0);
+
+    /* Junta as combinações p/t/n repetidas em um único vértice e
+       triangula as faces, agrupando os triângulos por material */
+    double inicio = segundosAgora();
+    obj->buffer = fast_obj_buffer_create(obj->mesh, 0);
+    if (!obj->buffer) {
+        fast_obj_destroy(obj->mesh);
+        obj->mesh = NULL;
+        return;
+    }
+
+    printf("[BUF] %u vertices unicos de %u (%.1f%%), %u triangulos em %.2f ms\n",
+           obj->buffer->vertex_count, obj->buffer->corner_count,
+           obj->buffer->corner_count ? 100.0 * obj->buffer->vertex_count / obj->buffer->corner_count : 0.0,
+           obj->buffer->index_count / 3, (segundosAgora() - inicio) * 1000.0);
+
+    /* As imagens são carregadas de cima para baixo, então inverte o v */
+    for (unsigned i = 0; i < obj->buffer->vertex_count; i++)
+        obj->buffer->vertices[i].texcoord[1] = 1 - obj->buffer->vertices[i].texcoord[1];
+
     strncpy(obj->nome, filename, 127);
     obj->carregado = 1;
 
-    /* Prepara texturas baseadas no MTL */
+    /* Uma textura por material; são carregadas depois, em carregarObjetos */
     obj->materialCount = obj->mesh->material_count;
     obj->materialTextures = calloc(obj->materialCount, sizeof(GLuint));
 
-    for (int m = 0; m < obj->materialCount; m++) {
-        unsigned int texIndex = obj->mesh->materials[m].map_Kd;
-        const char* texName = NULL;
-
-        if (texIndex > 0 && texIndex < obj->mesh->texture_count)
-            texName = obj->mesh->textures[texIndex].name;
-
-        obj->materialTextures[m] = texName ? loadTexture(texName) : 0;
-    }
-
-    /* Calcula bounding box para centralizar o modelo e ajustar escala */
-    float minv[3] = {1e9,1e9,1e9}, maxv[3]={-1e9,-1e9,-1e9};
-    for (unsigned i = 0; i < obj->mesh->position_count; i++) {
-        float x = obj->mesh->positions[3*i+0];
-        float y = obj->mesh->positions[3*i+1];
-        float z = obj->mesh->positions[3*i+2];
-
-        if (x<minv[0]) minv[0]=x; if (x>maxv[0]) maxv[0]=x;
-        if (y<minv[1]) minv[1]=y; if (y>maxv[1]) maxv[1]=y;
-        if (z<minv[2]) minv[2]=z; if (z>maxv[2]) maxv[2]=z;
-    }
+    /* Bounding box (calculada pelo fast_obj) para centralizar o modelo e ajustar escala */
+    const float* minv = obj->mesh->bounds_min;
+    const float* maxv = obj->mesh->bounds_max;
 
     obj->centro[0] = (minv[0] + maxv[0]) / 2;
     obj->centro[1] = (minv[1] + maxv[1]) / 2;
@@ -133,6 +329,67 @@ void carregarObjeto(int indice, const char* filename) {
     obj->escala = (md>0) ? 4.0f / md : 1.0f;
 }
 
+/* Lê todos os OBJ ao mesmo tempo e depois prepara cada um, na ordem da lista */
+void carregarObjetos(const char** arquivos, int quantidade) {
+    fastObjBatchOptions opcoes = fast_obj_batch_options_default();
+
+    /* Um arquivo por núcleo; os núcleos que sobram dividem o parse de cada
+       arquivo, e a malha fica em poucos blocos grandes que liberarObjeto
+       solta de uma vez */
+    opcoes.thread_count = 0;
+    opcoes.options.thread_count = 0;
+    opcoes.options.arena = 1;
+
+    /* Modelos que usam o mesmo .mtl reaproveitam os materiais já lidos */
+    opcoes.options.mtl_cache = 1;
+
+    /* O resultado do parse fica salvo em "<arquivo>.cache"; enquanto o OBJ
+       não mudar, as próximas execuções só mapeiam esse arquivo */
+    opcoes.cached = 1;
+
+    fastObjBatchResult* resultados = calloc(quantidade, sizeof(fastObjBatchResult));
+    if (!resultados) return;
+
+    double inicio = segundosAgora();
+    unsigned int lidos = fast_obj_read_batch(arquivos, quantidade, &opcoes, resultados);
+    printf("[BATCH] %u de %d arquivos lidos em %.2f ms\n",
+           lidos, quantidade, (segundosAgora() - inicio) * 1000.0);
+
+    /* Texturas usam o contexto OpenGL, então o resto é feito nesta thread */
+    for (int i = 0; i < quantidade; i++)
+        prepararObjeto(i, arquivos[i], resultados[i].mesh, resultados[i].seconds);
+
+    free(resultados);
+
+    /* Junta as texturas do MTL de todos os modelos numa lista só, para
+       decodificar todas de uma vez */
+    int total = 0;
+    for (int i = 0; i < quantidade; i++)
+        total += objetos[i].materialTextures ? objetos[i].materialCount : 0;
+
+    ImagemTextura* imagens = calloc(total > 0 ? total : 1, sizeof(ImagemTextura));
+    if (!imagens) return;
+
+    int n = 0;
+    for (int i = 0; i < quantidade; i++) {
+        Objeto3D* obj = &objetos[i];
+        if (!obj->materialTextures) continue;
+
+        for (int m = 0; m < obj->materialCount; m++) {
+            unsigned int texIndex = obj->mesh->materials[m].map_Kd;
+
+            if (texIndex > 0 && texIndex < obj->mesh->texture_count) {
+                imagens[n].arquivo = obj->mesh->textures[texIndex].name;
+                imagens[n].destino = &obj->materialTextures[m];
+                n++;
+            }
+        }
+    }
+
+    carregarTexturas(imagens, n);
+    free(imagens);
+}
+
 /* Define aparência do objeto, incluindo textura e materiais especiais */
 void aplicarEstiloVisual(Objeto3D* obj, int matIndex) {
     GLuint tex = 0;
@@ -192,28 +449,29 @@ void display() {
     glScalef(obj->escala, obj->escala, obj->escala);
     glTranslatef(-obj->centro[0], -obj->centro[1], -obj->centro[2]);
 
-    /* Renderização baseada nos índices do fast_obj */
-    unsigned idxOffset = 0;
-    for (unsigned f = 0; f < obj->mesh->face_count; f++) {
-        int fv = obj->mesh->face_vertices[f];
-        int mat = obj->mesh->face_materials ? obj->mesh->face_materials[f] : -1;
+    /* Renderização a partir do buffer intercalado: um glDrawElements por material */
+    fastObjBuffer* buf = obj->buffer;
+    GLenum tipoIndice = (buf->index_size == 2) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
-        aplicarEstiloVisual(obj, mat);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(fastObjVertex), buf->vertices[0].position);
+    glNormalPointer(GL_FLOAT, sizeof(fastObjVertex), buf->vertices[0].normal);
+    glTexCoordPointer(2, GL_FLOAT, sizeof(fastObjVertex), buf->vertices[0].texcoord);
 
-        glBegin(fv==3?GL_TRIANGLES:GL_POLYGON);
-        for (int v=0; v<fv; v++) {
-            fastObjIndex idx = obj->mesh->indices[idxOffset+v];
+    for (unsigned r = 0; r < buf->range_count; r++) {
+        const fastObjRange* range = &buf->ranges[r];
+        const char* inicio = (const char*)buf->indices + (size_t)range->index_offset * buf->index_size;
 
-            if (idx.n>=0)
-                glNormal3fv(&obj->mesh->normals[3*idx.n]);
-            if (idx.t>=0)
-                glTexCoord2f(obj->mesh->texcoords[2*idx.t], 1-obj->mesh->texcoords[2*idx.t+1]);
-            glVertex3fv(&obj->mesh->positions[3*idx.p]);
-        }
-        glEnd();
-        idxOffset += fv;
+        aplicarEstiloVisual(obj, (int)range->material);
+        glDrawElements(GL_TRIANGLES, range->index_count, tipoIndice, inicio);
     }
 
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
     glDisable(GL_TEXTURE_2D); 
     glPopMatrix();
     glutSwapBuffers();
@@ -275,6 +533,7 @@ void initGL(){
 int main(int argc,char** argv){
     for(int i=0;i<3;i++){
         objetos[i].mesh=NULL;
+        objetos[i].buffer=NULL;
         objetos[i].materialTextures=NULL;
         objetos[i].materialCount=0;
         objetos[i].carregado=0;
@@ -293,10 +552,8 @@ int main(int argc,char** argv){
 
     initGL();
 
-    if(argc>1) carregarObjeto(0,argv[1]);
-    else carregarObjeto(0,"teapot.obj");
-    carregarObjeto(1,"bunny.obj");
-    carregarObjeto(2,"dragon.obj");
+    const char* arquivos[3] = { argc>1 ? argv[1] : "teapot.obj", "bunny.obj", "dragon.obj" };
+    carregarObjetos(arquivos, 3);
 
     printf("\n=== CONTROLES ===\n");
     printf("Tecle [1]: Visualizar Modelo 1 (Padrao: Bule)\n");